@@ -17,12 +17,14 @@
 */
 
 #include <stdio.h>
+#include <string.h>
 #include <assert.h>
 #include <algorithm>
 #include "NDS.h"
 #include "DSi.h"
 #include "ARM.h"
 #include "ARMInterpreter.h"
+#include "ARM_InstrInfo.h"
 #include "AREngine.h"
 #include "ARMJIT.h"
 #include "Platform.h"
@@ -153,6 +155,10 @@ void ARM::Reset()
     Halted = 0;
 
     IRQ = 0;
+    IdleLoop = 0;
+    memset(IdleLoopCache, 0, sizeof(IdleLoopCache));
+    for (DecodedInstr& entry : DecodeCache)
+        DecodeARMInstr(entry, 0);
 
     for (int i = 0; i < 16; i++)
         R[i] = 0;
@@ -244,9 +250,10 @@ void ARM::DoSavestate(Savestate* file)
         R_IRQ[2] |= 0x00000010;
         R_UND[2] |= 0x00000010;
 
+        SetupCodeMem(R[15]); // should fix it
+
         if (!Num)
         {
-            SetupCodeMem(R[15]); // should fix it
             ((ARMv5*)this)->RegionCodeCycles = ((ARMv5*)this)->MemTimings[R[15] >> 12][0];
 
             if ((CPSR & 0x1F) == 0x10)
@@ -277,10 +284,9 @@ void ARM::SetupCodeMem(u32 addr)
     }
     else
     {
-        // not sure it's worth it for the ARM7
-        // esp. as everything there generally runs on WRAM
-        // and due to how it's mapped, we can't use this optimization
-        //NDS::ARM7GetMemRegion(addr, false, &CodeMem);
+        // the shared WRAM is only covered when none of it is mapped to the ARM7,
+        // the rest goes through the bus
+        NDS.ARM7GetMemRegion(addr, false, &CodeMem);
     }
 }
 
@@ -373,7 +379,7 @@ void ARMv4::JumpTo(u32 addr, bool restorecpsr)
         addr &= ~0x1;
         R[15] = addr+2;
 
-        //if (newregion != oldregion) SetupCodeMem(addr);
+        if (newregion != oldregion) SetupCodeMem(addr);
 
         NextInstr[0] = CodeRead16(addr);
         NextInstr[1] = CodeRead16(addr+2);
@@ -386,7 +392,7 @@ void ARMv4::JumpTo(u32 addr, bool restorecpsr)
         addr &= ~0x3;
         R[15] = addr+4;
 
-        //if (newregion != oldregion) SetupCodeMem(addr);
+        if (newregion != oldregion) SetupCodeMem(addr);
 
         NextInstr[0] = CodeRead32(addr);
         NextInstr[1] = CodeRead32(addr+4);
@@ -582,6 +588,115 @@ void ARM::CheckGdbIncoming()
     GdbCheckA();
 }
 
+u32 ARM::PeekCode(u32 addr, bool thumb)
+{
+    u32 val;
+    if (Num == 0)
+    {
+        // same as fetching it, minus the timing
+        s32 codeCycles = CodeCycles;
+        val = ((ARMv5*)this)->CodeRead32(addr & ~3, false);
+        CodeCycles = codeCycles;
+    }
+    else
+        val = ((ARMv4*)this)->CodeRead32(addr & ~3);
+
+    if (thumb)
+        val = (addr & 2) ? (val >> 16) : (val & 0xFFFF);
+    return val;
+}
+
+bool ARM::InSameCodeRegion(u32 addrA, u32 addrB)
+{
+    MemRegion regionA, regionB;
+    if (Num == 0)
+    {
+        u32 itcmSize = ((ARMv5*)this)->ITCMSize;
+        if ((addrA < itcmSize) != (addrB < itcmSize))
+            return false;
+
+        NDS.ARM9GetMemRegion(addrA, false, &regionA);
+        NDS.ARM9GetMemRegion(addrB, false, &regionB);
+    }
+    else
+    {
+        NDS.ARM7GetMemRegion(addrA, false, &regionA);
+        NDS.ARM7GetMemRegion(addrB, false, &regionB);
+    }
+
+    return regionA.Mem == regionB.Mem;
+}
+
+bool ARM::IsIdleLoop(u32 branchAddr, u32 target)
+{
+    bool thumb = branchAddr & 1;
+    u32 start = target & ~1;
+    u32 end = branchAddr & ~1;
+    u32 instrSize = thumb ? 2 : 4;
+
+    u32 count = (end - start) / instrSize + 1;
+    if (count > kMaxIdleLoopSize)
+        return false;
+
+    // the code is read through CodeMem, which is set up for the branch's region
+    if (!InSameCodeRegion(start, end))
+        return false;
+
+    u32 instrs[kMaxIdleLoopSize];
+    u32 hash = 0;
+    for (u32 i = 0; i < count; i++)
+    {
+        instrs[i] = PeekCode(start + i * instrSize, thumb);
+        hash = (hash * 31) + instrs[i];
+    }
+
+    IdleLoopEntry& entry = IdleLoopCache[(branchAddr >> 1) & (kIdleLoopCacheSize-1)];
+    if (entry.Branch == branchAddr && entry.Target == target && entry.Hash == hash)
+        return entry.Idle;
+
+    // same rules as the JIT's IsIdleLoop(): no writes, nothing but the final branch
+    // leaving the loop, and no register carrying a value from one iteration to the next
+    bool idle = true;
+    u16 regsWrittenTo = 0;
+    u16 regsDisallowedToWrite = 0;
+    for (u32 i = 0; i < count && idle; i++)
+    {
+        ARMInstrInfo::Info info = ARMInstrInfo::Decode(thumb, Num, instrs[i], false);
+
+        if (info.SpecialKind == ARMInstrInfo::special_WriteMem)
+            idle = false;
+        else if (!thumb && info.Kind >= ARMInstrInfo::ak_MSR_IMM && info.Kind <= ARMInstrInfo::ak_MRC)
+            idle = false;
+        else if (i < count - 1 && info.Branches())
+            idle = false;
+
+        u16 srcRegs = info.SrcRegs & ~(1 << 15);
+        u16 dstRegs = info.DstRegs & ~(1 << 15);
+
+        regsDisallowedToWrite |= srcRegs & ~regsWrittenTo;
+        if (dstRegs & regsDisallowedToWrite)
+            idle = false;
+        regsWrittenTo |= dstRegs;
+    }
+
+    entry = {branchAddr, target, hash, idle};
+    return idle;
+}
+
+void ARM::DecodeARMInstr(DecodedInstr& entry, u32 instr) const
+{
+    entry.Instr = instr;
+    entry.Cond = instr >> 28;
+    entry.Handler = ARMInterpreter::ARMInstrTable[((instr >> 4) & 0xF) | ((instr >> 16) & 0xFF0)];
+
+    // the ARM9's BLX with an immediate offset takes the place of the "never" condition
+    if (Num == 0 && (instr & 0xFE000000) == 0xFA000000)
+    {
+        entry.Cond = 0xE;
+        entry.Handler = ARMInterpreter::A_BLX_IMM;
+    }
+}
+
 void ARMv5::Execute()
 {
     GdbCheckB();
@@ -633,15 +748,12 @@ void ARMv5::Execute()
             NextInstr[1] = CodeRead32(R[15], false);
 
             // actually execute
-            if (CheckCondition(CurInstr >> 28))
-            {
-                u32 icode = ((CurInstr >> 4) & 0xF) | ((CurInstr >> 16) & 0xFF0);
-                ARMInterpreter::ARMInstrTable[icode](this);
-            }
-            else if ((CurInstr & 0xFE000000) == 0xFA000000)
-            {
-                ARMInterpreter::A_BLX_IMM(this);
-            }
+            DecodedInstr& decoded = DecodeCache[(R[15] >> 2) & (kDecodeCacheSize-1)];
+            if (decoded.Instr != CurInstr)
+                DecodeARMInstr(decoded, CurInstr);
+
+            if (CheckCondition(decoded.Cond))
+                decoded.Handler(this);
             else
                 AddCycles_C();
         }
@@ -664,6 +776,14 @@ void ARMv5::Execute()
 
         NDS.ARM9Timestamp += Cycles;
         Cycles = 0;
+
+        if (IdleLoop)
+        {
+            // it would keep looping until something happens, which can't be before the target
+            IdleLoop = 0;
+            if (!IRQ && NDS.ARM9Timestamp < NDS.ARM9Target)
+                NDS.ARM9Timestamp = NDS.ARM9Target;
+        }
     }
 
     if (Halted == 2)
@@ -692,6 +812,9 @@ void ARMv5::ExecuteJIT()
         }
     }
 
+    if (NDS.JIT.LinksOutdated)
+        NDS.JIT.RelinkBlocks();
+
     while (NDS.ARM9Timestamp < NDS.ARM9Target)
     {
         u32 instrAddr = R[15] - ((CPSR&0x20)?2:4);
@@ -788,11 +911,12 @@ void ARMv4::Execute()
             NextInstr[1] = CodeRead32(R[15]);
 
             // actually execute
-            if (CheckCondition(CurInstr >> 28))
-            {
-                u32 icode = ((CurInstr >> 4) & 0xF) | ((CurInstr >> 16) & 0xFF0);
-                ARMInterpreter::ARMInstrTable[icode](this);
-            }
+            DecodedInstr& decoded = DecodeCache[(R[15] >> 2) & (kDecodeCacheSize-1)];
+            if (decoded.Instr != CurInstr)
+                DecodeARMInstr(decoded, CurInstr);
+
+            if (CheckCondition(decoded.Cond))
+                decoded.Handler(this);
             else
                 AddCycles_C();
         }
@@ -815,6 +939,13 @@ void ARMv4::Execute()
 
         NDS.ARM7Timestamp += Cycles;
         Cycles = 0;
+
+        if (IdleLoop)
+        {
+            IdleLoop = 0;
+            if (!IRQ && NDS.ARM7Timestamp < NDS.ARM7Target)
+                NDS.ARM7Timestamp = NDS.ARM7Target;
+        }
     }
 
     if (Halted == 2)
@@ -851,6 +982,9 @@ void ARMv4::ExecuteJIT()
         }
     }
 
+    if (NDS.JIT.LinksOutdated)
+        NDS.JIT.RelinkBlocks();
+
     while (NDS.ARM7Timestamp < NDS.ARM7Target)
     {
         u32 instrAddr = R[15] - ((CPSR&0x20)?2:4);
@@ -1283,16 +1417,25 @@ void ARMv4::AddCycles_CD()
 
 u8 ARMv5::BusRead8(u32 addr)
 {
+    if (u8* page = NDS.GetARM9ReadPage(addr))
+        return *(u8*)&page[addr & 0x3FFF];
+
     return NDS.ARM9Read8(addr);
 }
 
 u16 ARMv5::BusRead16(u32 addr)
 {
+    if (u8* page = NDS.GetARM9ReadPage(addr))
+        return *(u16*)&page[addr & 0x3FFE];
+
     return NDS.ARM9Read16(addr);
 }
 
 u32 ARMv5::BusRead32(u32 addr)
 {
+    if (u8* page = NDS.GetARM9ReadPage(addr))
+        return *(u32*)&page[addr & 0x3FFC];
+
     return NDS.ARM9Read32(addr);
 }
 
@@ -1313,16 +1456,25 @@ void ARMv5::BusWrite32(u32 addr, u32 val)
 
 u8 ARMv4::BusRead8(u32 addr)
 {
+    if (u8* page = NDS.GetARM7ReadPage(addr))
+        return *(u8*)&page[addr & 0x3FFF];
+
     return NDS.ARM7Read8(addr);
 }
 
 u16 ARMv4::BusRead16(u32 addr)
 {
+    if (u8* page = NDS.GetARM7ReadPage(addr))
+        return *(u16*)&page[addr & 0x3FFE];
+
     return NDS.ARM7Read16(addr);
 }
 
 u32 ARMv4::BusRead32(u32 addr)
 {
+    if (u8* page = NDS.GetARM7ReadPage(addr))
+        return *(u32*)&page[addr & 0x3FFC];
+
     return NDS.ARM7Read32(addr);
 }
 
@@ -144,6 +144,30 @@ public:
 
     void CheckGdbIncoming();
 
+    /// Called by the interpreter when a branch is taken backwards.
+    /// If the loop it closes can't change anything by running again, sets
+    /// IdleLoop so the time until the next event is skipped, like the JIT does
+    /// for the idle loops it finds. Unlike the JIT, this also catches
+    /// unconditional ones (eg. waiting for an IRQ with "b .").
+    /// @param branchAddr Address of the branch, bit 0 set in THUMB mode.
+    void CheckIdleLoop(u32 branchAddr, u32 target)
+    {
+        if (!IdleLoopSkipping || branchAddr - target > kMaxIdleLoopBytes)
+            return;
+
+        // most backward branches close regular loops, those have to stay cheap
+        const IdleLoopEntry& entry = IdleLoopCache[(branchAddr >> 1) & (kIdleLoopCacheSize-1)];
+        if (entry.Branch == branchAddr && entry.Target == target && !entry.Idle)
+            return;
+
+        if (IsIdleLoop(branchAddr, target))
+            IdleLoop = 1;
+    }
+
+    /// Whether CheckIdleLoop() looks for idle loops at all. Without it
+    /// the interpreter runs them like any other code.
+    void SetIdleLoopSkipping(bool enable) noexcept { IdleLoopSkipping = enable; }
+
     u32 Num;
 
     s32 Cycles;
@@ -178,9 +202,22 @@ public:
 
     MemRegion CodeMem;
 
+    // what the ARM instructions fetched from an address were decoded to last.
+    // THUMB instructions aren't cached, looking up their handler is cheaper than this
+    struct DecodedInstr
+    {
+        u32 Instr; // the handler only depends on this, the entry is good as long as it matches
+        u32 Cond; // 0xE if the handler always runs
+        void (*Handler)(ARM* cpu);
+    };
+    static constexpr u32 kDecodeCacheSize = 1024; // in instructions, has to be a power of two
+    DecodedInstr DecodeCache[kDecodeCacheSize];
+
+    void DecodeARMInstr(DecodedInstr& entry, u32 instr) const;
+
 #ifdef JIT_ENABLED
     u32 FastBlockLookupStart, FastBlockLookupSize;
-    u64* FastBlockLookup;
+    u64** FastBlockLookup;
 #endif
 
     static const u32 ConditionTable[16];
@@ -220,6 +257,24 @@ protected:
     void GdbCheckA();
     void GdbCheckB();
     void GdbCheckC();
+
+private:
+    static constexpr u32 kMaxIdleLoopSize = 16; // in instructions
+    static constexpr u32 kMaxIdleLoopBytes = (kMaxIdleLoopSize - 1) * 4;
+    static constexpr u32 kIdleLoopCacheSize = 16;
+
+    struct IdleLoopEntry
+    {
+        u32 Branch, Target;
+        u32 Hash; // of the loop's instructions, in case the code was replaced
+        bool Idle;
+    };
+    IdleLoopEntry IdleLoopCache[kIdleLoopCacheSize];
+    bool IdleLoopSkipping = true;
+
+    bool IsIdleLoop(u32 branchAddr, u32 target);
+    bool InSameCodeRegion(u32 addrA, u32 addrB);
+    u32 PeekCode(u32 addr, bool thumb);
 };
 
 class ARMv5 : public ARM
@@ -248,6 +303,9 @@ public:
 
     // all code accesses are forced nonseq 32bit
     u32 CodeRead32(u32 addr, bool branch);
+    // the cycles CodeRead32 would take, without touching anything.
+    // regionCodeCycles are the code timings of the region addr is in
+    static u32 CodeFetchCycles(u32 addr, bool branch, u32 regionCodeCycles, u32 itcmSize);
 
     void DataRead8(u32 addr, u32* val) override;
     void DataRead16(u32 addr, u32* val) override;
@@ -390,11 +448,15 @@ public:
 
     u16 CodeRead16(u32 addr)
     {
+        if (CodeMem.Mem) return *(u16*)&CodeMem.Mem[addr & CodeMem.Mask];
+
         return BusRead16(addr);
     }
 
     u32 CodeRead32(u32 addr)
     {
+        if (CodeMem.Mem) return *(u32*)&CodeMem.Mem[addr & CodeMem.Mask];
+
         return BusRead32(addr);
     }
 
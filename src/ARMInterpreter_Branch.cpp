@@ -28,6 +28,8 @@ using Platform::LogLevel;
 void A_B(ARM* cpu)
 {
     s32 offset = (s32)(cpu->CurInstr << 8) >> 6;
+    if (offset < 0)
+        cpu->CheckIdleLoop(cpu->R[15] - 8, cpu->R[15] + offset);
     cpu->JumpTo(cpu->R[15] + offset);
 }
 
@@ -65,6 +67,8 @@ void T_BCOND(ARM* cpu)
     if (cpu->CheckCondition((cpu->CurInstr >> 8) & 0xF))
     {
         s32 offset = (s32)(cpu->CurInstr << 24) >> 23;
+        if (offset < 0)
+            cpu->CheckIdleLoop((cpu->R[15] - 4) | 1, cpu->R[15] + offset);
         cpu->JumpTo(cpu->R[15] + offset + 1);
     }
     else
@@ -92,6 +96,8 @@ void T_BLX_REG(ARM* cpu)
 void T_B(ARM* cpu)
 {
     s32 offset = (s32)((cpu->CurInstr & 0x7FF) << 21) >> 20;
+    if (offset < 0)
+        cpu->CheckIdleLoop((cpu->R[15] - 4) | 1, cpu->R[15] + offset);
     cpu->JumpTo(cpu->R[15] + offset + 1);
 }
 
@@ -21,6 +21,11 @@
 #include <string.h>
 #include <assert.h>
 #include <unordered_map>
+#ifdef JIT_PERF_MAP_ENABLED
+#include <mutex>
+#include <stdarg.h>
+#include <unistd.h>
+#endif
 
 #define XXH_STATIC_LINKING_ONLY
 #include "xxhash/xxhash.h"
@@ -58,27 +63,55 @@ static_assert(offsetof(ARM, StopExecution) == ARM_StopExecution_offset, "");
 #define JIT_DEBUGPRINT(msg, ...)
 //#define JIT_DEBUGPRINT(msg, ...) Platform::Log(Platform::LogLevel::Debug, msg, ## __VA_ARGS__)
 
-const u32 CodeRegionSizes[ARMJIT_Memory::memregions_Count] =
+static u64* GetEmptyLookupPage() noexcept
 {
-    0,
-    ITCMPhysicalSize,
-    0,
-    ARM9BIOSSize,
-    MainRAMMaxSize,
-    SharedWRAMSize,
-    0,
-    0x100000,
-    ARM7BIOSSize,
-    ARM7WRAMSize,
-    0,
-    0,
-    0x40000,
-    0x10000,
-    0x10000,
-    NWRAMSize,
-    NWRAMSize,
-    NWRAMSize,
-};
+    static u64* page = []()
+    {
+        u64* page = new u64[BlockLookupTable::PageSize / 2];
+        memset(page, 0xFF, BlockLookupTable::PageSize / 2 * sizeof(u64));
+        return page;
+    }();
+    return page;
+}
+
+BlockLookupTable::BlockLookupTable(u32 size) noexcept
+{
+    NumPages = (size + PageSize - 1) >> PageShift;
+    Pages = std::make_unique<u64*[]>(NumPages);
+    for (u32 i = 0; i < NumPages; i++)
+        Pages[i] = GetEmptyLookupPage();
+}
+
+BlockLookupTable::~BlockLookupTable() noexcept
+{
+    Reset();
+}
+
+void BlockLookupTable::Set(u32 offset, u64 entry) noexcept
+{
+    u64*& page = Pages[offset >> PageShift];
+    if (page == GetEmptyLookupPage())
+    {
+        page = new u64[PageSize / 2];
+        memset(page, 0xFF, PageSize / 2 * sizeof(u64));
+        NumAllocatedPages++;
+    }
+    page[(offset & (PageSize - 1)) / 2] = entry;
+}
+
+void BlockLookupTable::Reset() noexcept
+{
+    u64* empty = GetEmptyLookupPage();
+    for (u32 i = 0; i < NumPages; i++)
+    {
+        if (Pages[i] != empty)
+        {
+            delete[] Pages[i];
+            Pages[i] = empty;
+        }
+    }
+    NumAllocatedPages = 0;
+}
 
 u32 ARMJIT::LocaliseCodeAddress(u32 num, u32 addr) const noexcept
 {
@@ -233,6 +266,20 @@ ARMJIT::~ARMJIT() noexcept
 {
     JitEnableWrite();
     ResetBlockCache();
+
+    if (CompileThread)
+    {
+        Platform::Mutex_Lock(CompileQueueLock);
+        CompileThreadQuit = true;
+        Platform::Mutex_Unlock(CompileQueueLock);
+        Platform::Semaphore_Post(CompileStart);
+
+        Platform::Thread_Wait(CompileThread);
+        Platform::Thread_Free(CompileThread);
+        Platform::Semaphore_Free(CompileStart);
+        Platform::Semaphore_Free(CompileDone);
+        Platform::Mutex_Free(CompileQueueLock);
+    }
 }
 
 void ARMJIT::Reset() noexcept
@@ -243,21 +290,39 @@ void ARMJIT::Reset() noexcept
     Memory.Reset();
 }
 
-void FloodFillSetFlags(FetchedInstr instrs[], int start, u8 flags)
+// goes backwards over the block once to find out which flags each instruction
+// has to set and which registers still hold a value that might be read
+// before it's overwritten. Everything is live wherever the state could
+// leave the compiled code: at the end of the block, at the side exits of
+// followed conditional branches, in interpreted instructions and where
+// banked registers are involved
+void AnalyseLiveness(Compiler& compiler, bool thumb, FetchedInstr instrs[], int count)
 {
-    for (int j = start; j >= 0; j--)
+    u8 liveFlags = 0xF;
+    u16 liveRegs = 0xFFFF;
+    for (int i = count - 1; i >= 0; i--)
     {
-        u8 match = instrs[j].Info.WriteFlags & flags;
-        u8 matchMaybe = (instrs[j].Info.WriteFlags >> 4) & flags;
-        if (matchMaybe) // writes flags maybe
-            instrs[j].SetFlags |= matchMaybe;
-        if (match)
-        {
-            instrs[j].SetFlags |= match;
-            flags &= ~match;
-            if (!flags)
-                return;
-        }
+        FetchedInstr& instr = instrs[i];
+
+        bool barrier = !compiler.CanCompile(thumb, instr.Info.Kind)
+            || (instr.BranchFlags & (branch_FollowCondTaken | branch_FollowCondNotTaken))
+            || (!thumb && (instr.Info.Kind == ARMInstrInfo::ak_MSR_IMM
+                || instr.Info.Kind == ARMInstrInfo::ak_MSR_REG
+                || ((instr.Info.Kind == ARMInstrInfo::ak_LDM || instr.Info.Kind == ARMInstrInfo::ak_STM)
+                    && instr.Instr & (1 << 22))));
+
+        u8 match = instr.Info.WriteFlags & liveFlags;
+        u8 matchMaybe = (instr.Info.WriteFlags >> 4) & liveFlags;
+        instr.SetFlags = match | matchMaybe;
+        liveFlags &= ~match;
+        liveFlags |= barrier ? 0xF : instr.Info.ReadFlags;
+
+        // only an instruction which is always executed is guaranteed to overwrite
+        bool unconditional = thumb ? instr.Info.Kind != ARMInstrInfo::tk_BCOND : instr.Cond() == 0xE;
+        if (unconditional)
+            liveRegs &= ~(instr.Info.DstRegs & ~instr.Info.SrcRegs);
+        liveRegs |= barrier ? 0xFFFF : instr.Info.SrcRegs;
+        instr.LiveRegs = liveRegs;
     }
 }
 
@@ -349,6 +414,44 @@ bool DecodeBranch(bool thumb, const FetchedInstr& instr, u32& cond, bool hasLink
     return false;
 }
 
+// where a branch with an immediate target goes, only exact up to the halfword
+// since it's only used to look up the timings for Comp_JumpTo
+bool DecodeImmediateTarget(bool thumb, const FetchedInstr& instr, u32& targetAddr)
+{
+    if (thumb)
+    {
+        u32 r15 = instr.Addr + 4;
+        switch (instr.Info.Kind)
+        {
+        case ARMInstrInfo::tk_BL_LONG:
+            targetAddr = r15 + ((s32)((instr.Instr & 0x7FF) << 21) >> 9);
+            targetAddr += ((instr.Instr >> 16) & 0x7FF) << 1;
+            return true;
+        case ARMInstrInfo::tk_B:
+            targetAddr = r15 + ((s32)((instr.Instr & 0x7FF) << 21) >> 20);
+            return true;
+        case ARMInstrInfo::tk_BCOND:
+            targetAddr = r15 + ((s32)(instr.Instr << 24) >> 23);
+            return true;
+        default:
+            return false;
+        }
+    }
+    else
+    {
+        switch (instr.Info.Kind)
+        {
+        case ARMInstrInfo::ak_B:
+        case ARMInstrInfo::ak_BL:
+        case ARMInstrInfo::ak_BLX_IMM:
+            targetAddr = instr.Addr + 8 + ((s32)(instr.Instr << 8) >> 6);
+            return true;
+        default:
+            return false;
+        }
+    }
+}
+
 bool IsIdleLoop(bool thumb, FetchedInstr* instrs, int instrsCount)
 {
     // see https://github.com/dolphin-emu/dolphin/blob/master/Source/Core/Core/PowerPC/PPCAnalyst.cpp#L678
@@ -469,15 +572,15 @@ InterpreterFunc InterpretTHUMB[ARMInstrInfo::tk_Count] =
 
 void ARMJIT::RetireJitBlock(JitBlock* block) noexcept
 {
-    auto it = RestoreCandidates.find(block->InstrHash);
-    if (it != RestoreCandidates.end())
+    JitBlock** prev = RestoreCandidates.Find(block->InstrHash);
+    if (prev)
     {
-        delete it->second;
-        it->second = block;
+        BlockPool.Free(*prev);
+        *prev = block;
     }
     else
     {
-        RestoreCandidates[block->InstrHash] = block;
+        RestoreCandidates.Insert(block->InstrHash, block);
     }
 }
 
@@ -488,13 +591,17 @@ void ARMJIT::SetJITArgs(JITArgs args) noexcept
     if (MaxBlockSize != args.MaxBlockSize
         || LiteralOptimizations != args.LiteralOptimizations
         || BranchOptimizations != args.BranchOptimizations
-        || FastMemory != args.FastMemory)
+        || FastMemory != args.FastMemory
+        || FastVRAM != args.FastVRAM)
         ResetBlockCache();
 
     MaxBlockSize = args.MaxBlockSize;
     LiteralOptimizations = args.LiteralOptimizations;
     BranchOptimizations = args.BranchOptimizations;
     FastMemory = args.FastMemory;
+    FastVRAM = args.FastVRAM;
+    SetBackgroundCompile(args.BackgroundCompile);
+    CompileThreshold = args.CompileThreshold;
 }
 
 void ARMJIT::SetMaxBlockSize(int size) noexcept
@@ -531,6 +638,23 @@ void ARMJIT::SetFastMemory(bool enabled) noexcept
     FastMemory = enabled;
 }
 
+void ARMJIT::SetFastVRAM(bool enabled) noexcept
+{
+    if (FastVRAM != enabled)
+        ResetBlockCache();
+
+    FastVRAM = enabled;
+}
+
+void ARMJIT::SetBackgroundCompile(bool enabled) noexcept
+{
+    // the blocks still being compiled are kept
+    if (BackgroundCompile && !enabled)
+        FinishCompiles();
+
+    BackgroundCompile = enabled;
+}
+
 void ARMJIT::CompileBlock(ARM* cpu) noexcept
 {
     bool thumb = cpu->CPSR & 0x20;
@@ -544,27 +668,54 @@ void ARMJIT::CompileBlock(ARM* cpu) noexcept
     }
 
     auto& map = cpu->Num == 0 ? JitBlocks9 : JitBlocks7;
-    auto existingBlockIt = map.find(blockAddr);
-    if (existingBlockIt != map.end())
+    JitBlock** existingBlock = map.Find(blockAddr);
+    if (existingBlock)
     {
         // there's already a block, though it's not inside the fast map
         // could be that there are two blocks at the same physical addr
         // but different mirrors
-        u32 otherLocalAddr = existingBlockIt->second->StartAddrLocal;
+        u32 otherLocalAddr = (*existingBlock)->StartAddrLocal;
 
         if (localAddr == otherLocalAddr)
         {
-            JIT_DEBUGPRINT("switching out block %x %x %x\n", localAddr, blockAddr, existingBlockIt->second->StartAddr);
+            JIT_DEBUGPRINT("switching out block %x %x %x\n", localAddr, blockAddr, (*existingBlock)->StartAddr);
 
-            u64* entry = &FastBlockLookupRegions[localAddr >> 27][(localAddr & 0x7FFFFFF) / 2];
-            *entry = ((u64)blockAddr | cpu->Num) << 32;
-            *entry |= JITCompiler.SubEntryOffset(existingBlockIt->second->EntryPoint);
+            FastBlockLookupRegions[localAddr >> 27]->Set(localAddr & 0x7FFFFFF,
+                (((u64)blockAddr | cpu->Num) << 32) | JITCompiler.SubEntryOffset((*existingBlock)->EntryPoint));
             return;
         }
 
         // some memory has been remapped
-        RetireJitBlock(existingBlockIt->second);
-        map.erase(existingBlockIt);
+        JitBlock* oldBlock = *existingBlock;
+        map.Remove(blockAddr);
+        RemoveBlockLinks(oldBlock);
+        RetireJitBlock(oldBlock);
+    }
+
+    // until the compile thread is done with it, the block is interpreted
+    // the same way it is before it's compiled
+    bool interpretOnly = false;
+    if (CompileJob** job = PendingCompiles[cpu->Num].Find(blockAddr))
+    {
+        if ((*job)->Block->StartAddrLocal == localAddr)
+            interpretOnly = true;
+        else
+            DropCompile(*job);
+    }
+
+    // counted apart from the lookup tables, so code that's only
+    // interpreted doesn't get lookup pages allocated for it
+    if (!interpretOnly && CompileThreshold > 0)
+    {
+        u32* count = InterpretCounts.Find(localAddr);
+        u32 runs = count ? *count : 0;
+        if (runs < CompileThreshold)
+        {
+            InterpretCounts.Insert(localAddr, runs + 1);
+            interpretOnly = true;
+        }
+        else if (count)
+            InterpretCounts.Remove(localAddr);
     }
 
     FetchedInstr instrs[MaxBlockSize];
@@ -578,6 +729,7 @@ void ARMJIT::CompileBlock(ARM* cpu) noexcept
 
     u32 numLiterals = 0;
     u32 literalLoadAddrs[MaxBlockSize];
+    int literalInstrs[MaxBlockSize];
     // they are going to be hashed
     u32 literalValues[MaxBlockSize];
     u32 instrValues[MaxBlockSize];
@@ -604,7 +756,7 @@ void ARMJIT::CompileBlock(ARM* cpu) noexcept
         r15 += thumb ? 2 : 4;
 
         instrs[i].BranchFlags = 0;
-        instrs[i].SetFlags = 0;
+        instrs[i].HasLiteral = false;
         instrs[i].Instr = nextInstr[0];
         nextInstr[0] = nextInstr[1];
 
@@ -658,6 +810,7 @@ void ARMJIT::CompileBlock(ARM* cpu) noexcept
             else
                 nextInstr[1] = cpuv4->CodeRead32(r15);
             instrs[i].CodeCycles = cpu->CodeCycles;
+            memcpy(instrs[i].CodeTimings, NDS.ARM7MemTimings[instrs[i].CodeCycles], 4);
         }
         instrs[i].Info = ARMInstrInfo::Decode(thumb, cpu->Num, instrs[i].Instr, LiteralOptimizations);
 
@@ -701,6 +854,9 @@ void ARMJIT::CompileBlock(ARM* cpu) noexcept
 
         instrs[i].DataCycles = cpu->DataCycles;
         instrs[i].DataRegion = cpu->DataRegion;
+        instrs[i].DataMemRegion = cpu->Num == 0
+            ? Memory.ClassifyAddress9(cpu->DataRegion)
+            : Memory.ClassifyAddress7(cpu->DataRegion);
 
         u32 literalAddr;
         if (LiteralOptimizations
@@ -725,6 +881,9 @@ void ARMJIT::CompileBlock(ARM* cpu) noexcept
                 addressMasks[j] |= 1 << ((translatedAddr & 0x1FF) / 16);
                 JIT_DEBUGPRINT("literal loading %08x %08x %08x %08x\n", literalAddr, translatedAddr, addressMasks[j], addressRanges[j]);
                 cpu->DataRead32(literalAddr, &literalValues[numLiterals]);
+                instrs[i].HasLiteral = true;
+                instrs[i].Literal = literalValues[numLiterals];
+                literalInstrs[numLiterals] = i;
                 literalLoadAddrs[numLiterals++] = translatedAddr;
             }
         }
@@ -816,11 +975,6 @@ void ARMJIT::CompileBlock(ARM* cpu) noexcept
         }
 
         i++;
-
-        bool canCompile = JITCompiler.CanCompile(thumb, instrs[i - 1].Info.Kind);
-        bool secondaryFlagReadCond = !canCompile || (instrs[i - 1].BranchFlags & (branch_FollowCondTaken | branch_FollowCondNotTaken));
-        if (instrs[i - 1].Info.ReadFlags != 0 || secondaryFlagReadCond)
-            FloodFillSetFlags(instrs, i - 2, !secondaryFlagReadCond ? instrs[i - 1].Info.ReadFlags : 0xF);
     } while(!instrs[i - 1].Info.EndBlock && i < MaxBlockSize && !cpu->Halted && (!cpu->IRQ || (cpu->CPSR & 0x80)));
 
     if (numLiterals)
@@ -841,18 +995,28 @@ void ARMJIT::CompileBlock(ARM* cpu) noexcept
                 }
             }
         }
+
+        // the block overwrites these itself, they're loaded at runtime
+        for (u32 k = 0; k < numLiterals; k++)
+        {
+            if (InvalidLiterals.Find(literalLoadAddrs[k]) != -1)
+                instrs[literalInstrs[k]].HasLiteral = false;
+        }
     }
 
+    if (interpretOnly)
+        return;
+
     u32 literalHash = (u32)XXH3_64bits(literalValues, numLiterals * 4);
     u32 instrHash = (u32)XXH3_64bits(instrValues, numInstrs * 4);
 
-    auto prevBlockIt = RestoreCandidates.find(instrHash);
+    JitBlock** prevBlockIt = RestoreCandidates.Find(instrHash);
     JitBlock* prevBlock = NULL;
     bool mayRestore = true;
-    if (prevBlockIt != RestoreCandidates.end())
+    if (prevBlockIt)
     {
-        prevBlock = prevBlockIt->second;
-        RestoreCandidates.erase(prevBlockIt);
+        prevBlock = *prevBlockIt;
+        RestoreCandidates.Remove(instrHash);
 
         mayRestore = prevBlock->StartAddr == blockAddr && prevBlock->LiteralHash == literalHash;
 
@@ -876,13 +1040,18 @@ void ARMJIT::CompileBlock(ARM* cpu) noexcept
         mayRestore = false;
     }
 
+    CompileMemControl memControl;
+    memControl.ITCMSize = NDS.ARM9.ITCMSize;
+    memControl.ExMemCnt9 = NDS.ExMemCnt[0];
+    memControl.SCFGExt9 = NDS.ConsoleType == 1 ? static_cast<DSi&>(NDS).SCFG_EXT[0] : 0;
+
     JitBlock* block;
     if (!mayRestore)
     {
         if (prevBlock)
-            delete prevBlock;
+            BlockPool.Free(prevBlock);
 
-        block = new JitBlock(cpu->Num, i, numAddressRanges, numLiterals);
+        block = BlockPool.Alloc(cpu->Num, numAddressRanges, numLiterals);
         block->LiteralHash = literalHash;
         block->InstrHash = instrHash;
         for (u32 j = 0; j < numAddressRanges; j++)
@@ -894,14 +1063,48 @@ void ARMJIT::CompileBlock(ARM* cpu) noexcept
 
         block->StartAddr = blockAddr;
         block->StartAddrLocal = localAddr;
+        block->Thumb = thumb;
+
+        AnalyseLiveness(JITCompiler, thumb, instrs, i);
 
-        FloodFillSetFlags(instrs, i - 1, 0xF);
+        for (int j = 0; j < i; j++)
+        {
+            u32 target;
+            if (!DecodeImmediateTarget(thumb, instrs[j], target))
+                continue;
 
-        JitEnableWrite();
-        block->EntryPoint = JITCompiler.CompileBlock(cpu, thumb, instrs, i, hasMemoryInstr);
-        JitEnableExecute();
+            if (cpu->Num == 0)
+                instrs[j].TargetTimings[0] = ((ARMv5*)cpu)->MemTimings[target >> 12][0];
+            else
+                memcpy(instrs[j].TargetTimings, NDS.ARM7MemTimings[target >> 15], 4);
+        }
 
-        JIT_DEBUGPRINT("block start %p\n", block->EntryPoint);
+        if (!BackgroundCompileEnabled())
+        {
+#ifdef JIT_BACKEND_BACKGROUND_COMPILE
+            if (JITCompiler.IsCodeSpaceLow())
+                ResetBlockCache();
+
+            JitEnableWrite();
+#ifdef JIT_PERF_MAP_ENABLED
+            JITCompiler.EntryCounter = &block->EntryCount;
+#endif
+            block->EntryPoint = JITCompiler.CompileBlock(cpu, thumb, instrs, i, hasMemoryInstr, memControl);
+            JitEnableExecute();
+#else
+            // this one resets the block cache itself when it runs out of space
+            JitEnableWrite();
+            block->EntryPoint = JITCompiler.CompileBlock(cpu, thumb, instrs, i, hasMemoryInstr);
+            JitEnableExecute();
+#endif
+
+#ifdef JIT_BACKEND_BLOCK_LINKING
+            block->LinkSite = JITCompiler.GetLinkSite();
+            block->LinkTarget = JITCompiler.GetLinkTarget();
+#endif
+
+            JIT_DEBUGPRINT("block start %p\n", block->EntryPoint);
+        }
     }
     else
     {
@@ -926,14 +1129,317 @@ void ARMJIT::CompileBlock(ARM* cpu) noexcept
         range->Blocks.Add(block);
     }
 
-    if (cpu->Num == 0)
-        JitBlocks9[blockAddr] = block;
+    if (!mayRestore && BackgroundCompileEnabled())
+        SubmitCompile(cpu, block, instrs, i, hasMemoryInstr, memControl);
     else
-        JitBlocks7[blockAddr] = block;
+        PublishBlock(block);
+}
+
+void ARMJIT::PublishBlock(JitBlock* block) noexcept
+{
+    if (block->Num == 0)
+        JitBlocks9.Insert(block->StartAddr, block);
+    else
+        JitBlocks7.Insert(block->StartAddr, block);
+
+    FastBlockLookupRegions[block->StartAddrLocal >> 27]->Set(block->StartAddrLocal & 0x7FFFFFF,
+        (((u64)block->StartAddr | block->Num) << 32) | JITCompiler.SubEntryOffset(block->EntryPoint));
+
+    AddBlockLinks(block);
+}
+
+void ARMJIT::SubmitCompile(ARM* cpu, JitBlock* block, FetchedInstr instrs[], int count, bool hasMemoryInstr,
+    const CompileMemControl& memControl) noexcept
+{
+    if (!CompileThread)
+    {
+        CompileQueueLock = Platform::Mutex_Create();
+        CompileStart = Platform::Semaphore_Create();
+        CompileDone = Platform::Semaphore_Create();
+        CompileThread = Platform::Thread_Create([this]() { CompileThreadFunc(); });
+    }
+
+    std::unique_ptr<CompileJob> job;
+    if (FreeCompileJobs.empty())
+    {
+        job = std::make_unique<CompileJob>();
+    }
+    else
+    {
+        job = std::move(FreeCompileJobs.back());
+        FreeCompileJobs.pop_back();
+    }
 
-    u64* entry = &FastBlockLookupRegions[(localAddr >> 27)][(localAddr & 0x7FFFFFF) / 2];
-    *entry = ((u64)blockAddr | cpu->Num) << 32;
-    *entry |= JITCompiler.SubEntryOffset(block->EntryPoint);
+    job->Block = block;
+    job->CPU = cpu;
+    job->Thumb = block->Thumb;
+    job->HasMemoryInstr = hasMemoryInstr;
+    job->NumInstrs = count;
+    job->MemControl = memControl;
+#ifdef JIT_PERF_MAP_ENABLED
+    // the block might be dropped while it's compiled, the pool keeps its memory around
+    job->EntryCounter = &block->EntryCount;
+#endif
+    memcpy(job->Instrs, instrs, count * sizeof(FetchedInstr));
+
+    PendingCompiles[block->Num].Insert(block->StartAddr, job.get());
+    NumCompilesRunning++;
+
+    Platform::Mutex_Lock(CompileQueueLock);
+    CompileQueue.push_back(job.get());
+    Platform::Mutex_Unlock(CompileQueueLock);
+    Platform::Semaphore_Post(CompileStart);
+
+    CompileJobs.push_back(std::move(job));
+}
+
+void ARMJIT::CompileThreadFunc() noexcept
+{
+    for (;;)
+    {
+        Platform::Semaphore_Wait(CompileStart);
+
+        Platform::Mutex_Lock(CompileQueueLock);
+        if (CompileThreadQuit)
+        {
+            Platform::Mutex_Unlock(CompileQueueLock);
+            return;
+        }
+        CompileJob* job = CompileQueue.front();
+        CompileQueue.pop_front();
+        Platform::Mutex_Unlock(CompileQueueLock);
+
+        // the block cache can only be reset from the emulation thread
+        job->EntryPoint = nullptr;
+#ifdef JIT_BACKEND_BACKGROUND_COMPILE
+        if (!JITCompiler.IsCodeSpaceLow())
+        {
+            JitEnableWrite();
+#ifdef JIT_PERF_MAP_ENABLED
+            JITCompiler.EntryCounter = job->EntryCounter;
+#endif
+            job->EntryPoint = JITCompiler.CompileBlock(job->CPU, job->Thumb, job->Instrs, job->NumInstrs, job->HasMemoryInstr,
+                job->MemControl);
+            JitEnableExecute();
+
+            job->LinkSite = JITCompiler.GetLinkSite();
+            job->LinkTarget = JITCompiler.GetLinkTarget();
+        }
+#endif
+
+        Platform::Semaphore_Post(CompileDone);
+    }
+}
+
+void ARMJIT::WaitForCompiles() noexcept
+{
+    for (; NumCompilesRunning > 0; NumCompilesRunning--)
+        Platform::Semaphore_Wait(CompileDone);
+}
+
+void ARMJIT::FinishCompiles() noexcept
+{
+    if (CompileJobs.empty())
+        return;
+
+    WaitForCompiles();
+
+    bool outOfSpace = false;
+    for (std::unique_ptr<CompileJob>& job : CompileJobs)
+    {
+        if (!job->Block)
+            continue;
+
+        if (!job->EntryPoint)
+        {
+            outOfSpace = true;
+            DropCompile(job.get());
+            continue;
+        }
+
+        JitBlock* block = job->Block;
+        PendingCompiles[block->Num].Remove(block->StartAddr);
+
+        block->EntryPoint = job->EntryPoint;
+        block->LinkSite = job->LinkSite;
+        block->LinkTarget = job->LinkTarget;
+        PublishBlock(block);
+    }
+
+    for (std::unique_ptr<CompileJob>& job : CompileJobs)
+        FreeCompileJobs.push_back(std::move(job));
+    CompileJobs.clear();
+
+    if (outOfSpace)
+        ResetBlockCache();
+}
+
+void ARMJIT::DropCompile(CompileJob* job) noexcept
+{
+    JitBlock* block = job->Block;
+    PendingCompiles[block->Num].Remove(block->StartAddr);
+
+    for (int j = 0; j < block->NumAddresses; j++)
+    {
+        u32 addr = block->AddressRanges()[j];
+        AddressRange* region = CodeMemRegions[addr >> 27];
+        AddressRange* range = &region[(addr & 0x7FFFFFF) / 512];
+
+        range->Blocks.RemoveByValue(block);
+        if (range->Blocks.Length == 0)
+        {
+            range->Code = 0;
+            if (!PageContainsCode(&region[(addr & 0x7FFF000) / 512]))
+                Memory.SetCodeProtection(addr >> 27, addr & 0x7FFFFFF, false);
+        }
+    }
+
+    BlockPool.Free(block);
+    job->Block = nullptr;
+}
+
+void ARMJIT::CancelCompiles() noexcept
+{
+    // they might still be compiled with what was there before
+    for (std::unique_ptr<CompileJob>& job : CompileJobs)
+    {
+        if (job->Block)
+            DropCompile(job.get());
+    }
+}
+
+bool ARMJIT::CanLink(JitBlock* from, JitBlock* to) const noexcept
+{
+    // VRAM is mapped differently all the time, it's left to the dispatcher
+    return to->Thumb == (from->LinkTarget & 0x1)
+        && (to->StartAddrLocal >> 27) != ARMJIT_Memory::memregion_VRAM
+        && LocaliseCodeAddress(to->Num, to->StartAddr) == to->StartAddrLocal;
+}
+
+void ARMJIT::PatchLink(JitBlock* from, JitBlockEntry entry) noexcept
+{
+    // without linking in the backend no block has a link site
+#ifdef JIT_BACKEND_BLOCK_LINKING
+    JITCompiler.PatchLink(from->LinkSite, entry);
+#endif
+}
+
+void ARMJIT::LinkBlock(JitBlock* from, JitBlock* to) noexcept
+{
+    JitEnableWrite();
+    PatchLink(from, to->EntryPoint);
+    JitEnableExecute();
+
+    from->LinkedTo = to;
+    to->LinkedFrom.Add(from);
+}
+
+void ARMJIT::AddBlockLinks(JitBlock* block) noexcept
+{
+    auto& map = block->Num == 0 ? JitBlocks9 : JitBlocks7;
+    auto& pending = PendingLinks[block->Num];
+
+    if (block->LinkSite)
+    {
+        JitBlock** target = map.Find(block->LinkTarget & ~0x1);
+        if (target && CanLink(block, *target))
+            LinkBlock(block, *target);
+        else
+            pending.emplace(block->LinkTarget & ~0x1, block);
+    }
+
+    auto range = pending.equal_range(block->StartAddr);
+    for (auto it = range.first; it != range.second;)
+    {
+        if (CanLink(it->second, block))
+        {
+            LinkBlock(it->second, block);
+            it = pending.erase(it);
+        }
+        else
+            it++;
+    }
+}
+
+void ARMJIT::RemoveBlockLinks(JitBlock* block) noexcept
+{
+    auto& pending = PendingLinks[block->Num];
+
+    JitEnableWrite();
+    if (block->LinkedTo)
+    {
+        // the block might be restored, it can't jump into one which might not exist anymore by then
+        block->LinkedTo->LinkedFrom.RemoveByValue(block);
+        PatchLink(block, NULL);
+        block->LinkedTo = nullptr;
+    }
+    else if (block->LinkSite)
+    {
+        auto range = pending.equal_range(block->LinkTarget & ~0x1);
+        for (auto it = range.first; it != range.second; it++)
+        {
+            if (it->second == block)
+            {
+                pending.erase(it);
+                break;
+            }
+        }
+    }
+
+    for (int i = 0; i < block->LinkedFrom.Length; i++)
+    {
+        JitBlock* from = block->LinkedFrom[i];
+        PatchLink(from, NULL);
+        from->LinkedTo = nullptr;
+        pending.emplace(from->LinkTarget & ~0x1, from);
+    }
+    block->LinkedFrom.Clear();
+    JitEnableExecute();
+}
+
+void ARMJIT::UnlinkBlocks() noexcept
+{
+    JitEnableWrite();
+    for (int num = 0; num < 2; num++)
+    {
+        (num == 0 ? JitBlocks9 : JitBlocks7).ForEach([&](u32, JitBlock* block)
+        {
+            if (block->LinkedTo)
+            {
+                PatchLink(block, NULL);
+                block->LinkedTo = nullptr;
+                PendingLinks[num].emplace(block->LinkTarget & ~0x1, block);
+            }
+            block->LinkedFrom.Clear();
+        });
+    }
+    JitEnableExecute();
+
+    CancelCompiles();
+
+    // the new mapping might not be in place yet
+    LinksOutdated = true;
+}
+
+void ARMJIT::RelinkBlocks() noexcept
+{
+    for (int num = 0; num < 2; num++)
+    {
+        auto& map = num == 0 ? JitBlocks9 : JitBlocks7;
+        for (auto it = PendingLinks[num].begin(); it != PendingLinks[num].end();)
+        {
+            JitBlock** target = map.Find(it->first);
+            if (target && CanLink(it->second, *target))
+            {
+                LinkBlock(it->second, *target);
+                it = PendingLinks[num].erase(it);
+            }
+            else
+                it++;
+        }
+    }
+
+    LinksOutdated = false;
 }
 
 void ARMJIT::InvalidateByAddr(u32 localAddr) noexcept
@@ -1013,11 +1519,26 @@ void ARMJIT::InvalidateByAddr(u32 localAddr) noexcept
             }
         }
 
-        FastBlockLookupRegions[block->StartAddrLocal >> 27][(block->StartAddrLocal & 0x7FFFFFF) / 2] = (u64)UINT32_MAX << 32;
+        // it's not anywhere else yet
+        CompileJob** job = PendingCompiles[block->Num].Find(block->StartAddr);
+        if (job && (*job)->Block == block)
+        {
+            PendingCompiles[block->Num].Remove(block->StartAddr);
+            (*job)->Block = nullptr;
+            BlockPool.Free(block);
+            continue;
+        }
+
+        FastBlockLookupRegions[block->StartAddrLocal >> 27]->Set(block->StartAddrLocal & 0x7FFFFFF, (u64)UINT32_MAX << 32);
+        // its code was compiled once already, so it is again right away
+        if (CompileThreshold > 0)
+            InterpretCounts.Insert(block->StartAddrLocal, UINT32_MAX);
         if (block->Num == 0)
-            JitBlocks9.erase(block->StartAddr);
+            JitBlocks9.Remove(block->StartAddr);
         else
-            JitBlocks7.erase(block->StartAddr);
+            JitBlocks7.Remove(block->StartAddr);
+
+        RemoveBlockLinks(block);
 
         if (!literalInvalidation)
         {
@@ -1025,7 +1546,7 @@ void ARMJIT::InvalidateByAddr(u32 localAddr) noexcept
         }
         else
         {
-            delete block;
+            BlockPool.Free(block);
         }
     }
 }
@@ -1064,21 +1585,120 @@ void ARMJIT::CheckAndInvalidateWVRAM(int bank) noexcept
     }
 }
 
-JitBlockEntry ARMJIT::LookUpBlock(u32 num, u64* entries, u32 offset, u32 addr) noexcept
+void ARMJIT::InvalidateChangedCode(int region, u32 offset, const u8* cur, const u8* incoming, u32 len) noexcept
 {
-    u64* entry = &entries[offset / 2];
-    if (*entry >> 32 == (addr | num))
-        return JITCompiler.AddEntryOffset((u32)*entry);
+    AddressRange* ranges = &CodeMemRegions[region][offset / 512];
+    for (u32 i = 0; i < len; i+=512)
+    {
+        // invalidating drops every block of the range, so stop at the first difference
+        for (u32 j = 0; j < 512 && ranges[i / 512].Code; j += 16)
+        {
+            if ((ranges[i / 512].Code & (1 << (j / 16)))
+                && memcmp(&cur[i+j], &incoming[i+j], 16) != 0)
+            {
+                InvalidateByAddr((offset+i+j) | (region << 27));
+                break;
+            }
+        }
+    }
+}
+
+bool ARMJIT::HasVRAMCode() const noexcept
+{
+    for (const AddressRange& range : CodeIndexVRAM)
+    {
+        if (range.Code) return true;
+    }
+    for (const AddressRange& range : CodeIndexARM7WVRAM)
+    {
+        if (range.Code) return true;
+    }
+    return false;
+}
+
+size_t ARMJIT::GetLookupMemoryUsage() const noexcept
+{
+    size_t usage = 0;
+    for (const BlockLookupTable* table : FastBlockLookupRegions)
+    {
+        if (table)
+            usage += table->GetNumPages() * sizeof(u64*)
+                + table->GetNumAllocatedPages() * (BlockLookupTable::PageSize / 2 * sizeof(u64));
+    }
+    return usage;
+}
+
+void ARMJIT::GetHugePageUsage(size_t& memory, size_t& views, size_t& code) noexcept
+{
+    Memory.GetHugePageUsage(memory, views);
+#ifdef JIT_BACKEND_HUGE_PAGES
+    code = JITCompiler.GetHugePageUsage();
+#else
+    code = 0;
+#endif
+}
+
+#ifdef JIT_PERF_MAP_ENABLED
+std::vector<ARMJIT::HotBlock> ARMJIT::GetHotBlocks(u32 count) noexcept
+{
+    std::vector<HotBlock> blocks;
+    auto add = [&blocks](u32, JitBlock* block)
+    {
+        blocks.push_back({block->Num, block->StartAddr, block->Thumb, block->EntryCount});
+    };
+    JitBlocks9.ForEach(add);
+    JitBlocks7.ForEach(add);
+
+    count = std::min<u32>(count, blocks.size());
+    std::partial_sort(blocks.begin(), blocks.begin() + count, blocks.end(),
+        [](const HotBlock& a, const HotBlock& b) { return a.EntryCount > b.EntryCount; });
+    blocks.resize(count);
+    return blocks;
+}
+
+void AddPerfMapSymbol(const void* start, size_t size, const char* namefmt, ...)
+{
+    // shared by every emulator instance, like the process
+    static std::mutex lock;
+    static Platform::FileHandle* file = nullptr;
+
+    std::lock_guard<std::mutex> guard(lock);
+    if (!file)
+    {
+        char path[64];
+        snprintf(path, sizeof(path), "/tmp/perf-%d.map", (int)getpid());
+        file = Platform::OpenFile(path, Platform::FileMode::Write);
+        if (!file)
+            return;
+    }
+
+    va_list args;
+    va_start(args, namefmt);
+    char name[64];
+    vsnprintf(name, sizeof(name), namefmt, args);
+    va_end(args);
+
+    // perf only reads the file once it's done recording
+    Platform::FileWriteFormatted(file, "%lx %zx %s\n", (unsigned long)start, size, name);
+    Platform::FileFlush(file);
+}
+#endif
+
+JitBlockEntry ARMJIT::LookUpBlock(u32 num, u64** pages, u32 offset, u32 addr) noexcept
+{
+    u64 entry = pages[offset >> BlockLookupTable::PageShift][(offset & (BlockLookupTable::PageSize - 1)) / 2];
+    if (entry >> 32 == (addr | num))
+        return JITCompiler.AddEntryOffset((u32)entry);
     return NULL;
 }
 
 void ARMJIT::blockSanityCheck(u32 num, u32 blockAddr, JitBlockEntry entry) noexcept
 {
     u32 localAddr = LocaliseCodeAddress(num, blockAddr);
-    assert(JITCompiler.AddEntryOffset((u32)FastBlockLookupRegions[localAddr >> 27][(localAddr & 0x7FFFFFF) / 2]) == entry);
+    assert(JITCompiler.AddEntryOffset((u32)FastBlockLookupRegions[localAddr >> 27]->Get(localAddr & 0x7FFFFFF)) == entry);
 }
 
-bool ARMJIT::SetupExecutableRegion(u32 num, u32 blockAddr, u64*& entry, u32& start, u32& size) noexcept
+bool ARMJIT::SetupExecutableRegion(u32 num, u32 blockAddr, u64**& pages, u32& start, u32& size) noexcept
 {
     // amazingly ignoring the DTCM is the proper behaviour for code fetches
     int region = num == 0
@@ -1090,7 +1710,8 @@ bool ARMJIT::SetupExecutableRegion(u32 num, u32 blockAddr, u64*& entry, u32& sta
         && Memory.GetMirrorLocation(region, num, blockAddr, memoryOffset, start, size))
     {
         //printf("setup exec region %d %d %08x %08x %x %x\n", num, region, blockAddr, start, size, memoryOffset);
-        entry = FastBlockLookupRegions[region] + memoryOffset / 2;
+        // mirrors are at least a page large and aligned to their size
+        pages = FastBlockLookupRegions[region]->GetPages() + (memoryOffset >> BlockLookupTable::PageShift);
         return true;
     }
     return false;
@@ -1115,6 +1736,9 @@ void ARMJIT::ResetBlockCache() noexcept
 {
     Log(LogLevel::Debug, "Resetting JIT block cache...\n");
 
+    // nothing can be compiled while the code space is reset
+    WaitForCompiles();
+
     // could be replace through a function which only resets
     // the permissions but we're too lazy
     Memory.Reset();
@@ -1123,14 +1747,12 @@ void ARMJIT::ResetBlockCache() noexcept
     for (int i = 0; i < ARMJIT_Memory::memregions_Count; i++)
     {
         if (FastBlockLookupRegions[i])
-            memset(FastBlockLookupRegions[i], 0xFF, CodeRegionSizes[i] * sizeof(u64) / 2);
+            FastBlockLookupRegions[i]->Reset();
     }
-    for (auto it = RestoreCandidates.begin(); it != RestoreCandidates.end(); it++)
-        delete it->second;
-    RestoreCandidates.clear();
-    for (auto it : JitBlocks9)
+    RestoreCandidates.ForEach([this](u32, JitBlock* block) { BlockPool.Free(block); });
+    RestoreCandidates.Clear();
+    auto freeBlock = [this](u32, JitBlock* block)
     {
-        JitBlock* block = it.second;
         for (int j = 0; j < block->NumAddresses; j++)
         {
             u32 addr = block->AddressRanges()[j];
@@ -1138,22 +1760,25 @@ void ARMJIT::ResetBlockCache() noexcept
             range->Blocks.Clear();
             range->Code = 0;
         }
-        delete block;
-    }
-    for (auto it : JitBlocks7)
+        BlockPool.Free(block);
+    };
+    JitBlocks9.ForEach(freeBlock);
+    JitBlocks7.ForEach(freeBlock);
+    JitBlocks9.Clear();
+    JitBlocks7.Clear();
+    for (std::unique_ptr<CompileJob>& job : CompileJobs)
     {
-        JitBlock* block = it.second;
-        for (int j = 0; j < block->NumAddresses; j++)
-        {
-            u32 addr = block->AddressRanges()[j];
-            AddressRange* range = &CodeMemRegions[addr >> 27][(addr & 0x7FFFFFF) / 512];
-            range->Blocks.Clear();
-            range->Code = 0;
-        }
-        delete block;
+        if (job->Block)
+            freeBlock(0, job->Block);
+        FreeCompileJobs.push_back(std::move(job));
     }
-    JitBlocks9.clear();
-    JitBlocks7.clear();
+    CompileJobs.clear();
+    PendingCompiles[0].Clear();
+    PendingCompiles[1].Clear();
+    InterpretCounts.Clear();
+    PendingLinks[0].clear();
+    PendingLinks[1].clear();
+    LinksOutdated = false;
 
     JITCompiler.Reset();
 }
@@ -20,8 +20,10 @@
 #define ARMJIT_H
 
 #include <algorithm>
+#include <deque>
 #include <optional>
 #include <memory>
+#include <vector>
 #include "types.h"
 #include "MemConstants.h"
 #include "Args.h"
@@ -29,18 +31,74 @@
 
 #ifdef JIT_ENABLED
 #include "JitBlock.h"
+#include "FlatHashMap.h"
 
 #if defined(__APPLE__) && defined(__aarch64__)
     #include <pthread.h>
 #endif
 
 #include "ARMJIT_Compiler.h"
+#include "Platform.h"
 
 namespace melonDS
 {
 class ARM;
 
 class JitBlock;
+
+// A block handed to the compile thread. Until it's published it's only
+// in the code index, so that writing to its code drops it.
+struct CompileJob
+{
+    JitBlock* Block; // null once it's dropped
+    ARM* CPU;
+    bool Thumb;
+    bool HasMemoryInstr;
+    int NumInstrs;
+    CompileMemControl MemControl;
+#ifdef JIT_PERF_MAP_ENABLED
+    u64* EntryCounter;
+#endif
+    FetchedInstr Instrs[32];
+
+    // set by the compile thread, EntryPoint stays null if the code space ran out
+    JitBlockEntry EntryPoint;
+    void* LinkSite;
+    u32 LinkTarget;
+};
+
+// The block entries for every halfword of a memory region, split into pages.
+// A page is only allocated once a block is compiled inside it, until then it
+// points to a page shared by all tables where every entry is empty, so looking
+// up doesn't have to care.
+class BlockLookupTable
+{
+public:
+    static constexpr u32 PageShift = 12;
+    static constexpr u32 PageSize = 1 << PageShift; // of code, a page has half as many entries
+
+    explicit BlockLookupTable(u32 size) noexcept;
+    ~BlockLookupTable() noexcept;
+    BlockLookupTable(const BlockLookupTable&) = delete;
+    BlockLookupTable& operator=(const BlockLookupTable&) = delete;
+
+    u64** GetPages() noexcept { return Pages.get(); }
+
+    u64 Get(u32 offset) const noexcept { return Pages[offset >> PageShift][(offset & (PageSize - 1)) / 2]; }
+    void Set(u32 offset, u64 entry) noexcept;
+
+    // frees all pages
+    void Reset() noexcept;
+
+    u32 GetNumPages() const noexcept { return NumPages; }
+    u32 GetNumAllocatedPages() const noexcept { return NumAllocatedPages; }
+
+private:
+    std::unique_ptr<u64*[]> Pages;
+    u32 NumPages;
+    u32 NumAllocatedPages = 0;
+};
+
 class ARMJIT
 {
 public:
@@ -51,17 +109,46 @@ public:
         MaxBlockSize(jit.has_value() ? std::clamp(jit->MaxBlockSize, 1u, 32u) : 32),
         LiteralOptimizations(jit.has_value() ? jit->LiteralOptimizations : false),
         BranchOptimizations(jit.has_value() ? jit->BranchOptimizations : false),
-        FastMemory(jit.has_value() ? jit->FastMemory : false)
+        FastMemory(jit.has_value() ? jit->FastMemory : false),
+        FastVRAM(jit.has_value() ? jit->FastVRAM : false),
+        BackgroundCompile(jit.has_value() ? jit->BackgroundCompile : false),
+        CompileThreshold(jit.has_value() ? jit->CompileThreshold : 0)
     {}
     ~ARMJIT() noexcept;
     void InvalidateByAddr(u32) noexcept;
     void CheckAndInvalidateWVRAM(int) noexcept;
     void CheckAndInvalidateITCM() noexcept;
+    void InvalidateChangedCode(int region, u32 offset, const u8* cur, const u8* incoming, u32 len) noexcept;
+    bool HasVRAMCode() const noexcept;
+    // what the block lookup tables currently take up, in bytes
+    size_t GetLookupMemoryUsage() const noexcept;
+    // how much of the guest memory, the fast memory views into it
+    // and the code memory ended up in huge pages, in bytes.
+    // code is 0 with backends which don't ask for huge pages
+    void GetHugePageUsage(size_t& memory, size_t& views, size_t& code) noexcept;
+#ifdef JIT_PERF_MAP_ENABLED
+    struct HotBlock
+    {
+        u32 Num;
+        u32 Addr;
+        bool Thumb;
+        u64 EntryCount;
+    };
+    // the compiled blocks which were entered most often,
+    // counts are lost when the block cache is reset
+    std::vector<HotBlock> GetHotBlocks(u32 count) noexcept;
+#endif
     void Reset() noexcept;
     void JitEnableWrite() noexcept;
     void JitEnableExecute() noexcept;
     void CompileBlock(ARM* cpu) noexcept;
+    // puts the blocks compiled in the background in place. It waits for all
+    // of them, so it's the same ones every time the emulation is run again
+    void FinishCompiles() noexcept;
     void ResetBlockCache() noexcept;
+    // to be called when memory is remapped, blocks might now be somewhere else
+    void UnlinkBlocks() noexcept;
+    void RelinkBlocks() noexcept;
 
     template <u32 num, int region>
     void CheckAndInvalidate(u32 addr) noexcept
@@ -70,8 +157,8 @@ public:
         if (CodeMemRegions[region][(localAddr & 0x7FFFFFF) / 512].Code & (1 << ((localAddr & 0x1FF) / 16)))
             InvalidateByAddr(localAddr);
     }
-    JitBlockEntry LookUpBlock(u32 num, u64* entries, u32 offset, u32 addr) noexcept;
-    bool SetupExecutableRegion(u32 num, u32 blockAddr, u64*& entry, u32& start, u32& size) noexcept;
+    JitBlockEntry LookUpBlock(u32 num, u64** pages, u32 offset, u32 addr) noexcept;
+    bool SetupExecutableRegion(u32 num, u32 blockAddr, u64**& pages, u32& start, u32& size) noexcept;
     u32 LocaliseCodeAddress(u32 num, u32 addr) const noexcept;
 
     ARMJIT_Memory Memory;
@@ -80,29 +167,88 @@ private:
     bool LiteralOptimizations = false;
     bool BranchOptimizations = false;
     bool FastMemory = false;
+    bool FastVRAM = false;
+    bool BackgroundCompile = false;
+    u32 CompileThreshold = 0;
+
+    void PublishBlock(JitBlock* block) noexcept;
+    void SubmitCompile(ARM* cpu, JitBlock* block, FetchedInstr instrs[], int count, bool hasMemoryInstr,
+        const CompileMemControl& memControl) noexcept;
+    void DropCompile(CompileJob* job) noexcept;
+    void CancelCompiles() noexcept;
+    void WaitForCompiles() noexcept;
+    void CompileThreadFunc() noexcept;
+
+    // everything submitted since the last FinishCompiles, in order
+    std::vector<std::unique_ptr<CompileJob>> CompileJobs {};
+    std::vector<std::unique_ptr<CompileJob>> FreeCompileJobs {};
+    // the jobs which aren't dropped, by address for each CPU
+    FlatHashMap<CompileJob*> PendingCompiles[2] {};
+    // how many jobs the compile thread hasn't signalled as done yet
+    u32 NumCompilesRunning = 0;
+
+    // how often the code at a local address was interpreted so far,
+    // only for code that hasn't reached CompileThreshold yet
+    FlatHashMap<u32> InterpretCounts {};
+
+    Platform::Thread* CompileThread = nullptr;
+    Platform::Mutex* CompileQueueLock = nullptr;
+    Platform::Semaphore* CompileStart = nullptr;
+    Platform::Semaphore* CompileDone = nullptr;
+    // both under CompileQueueLock
+    std::deque<CompileJob*> CompileQueue {};
+    bool CompileThreadQuit = false;
 public:
     melonDS::NDS& NDS;
     TinyVector<u32> InvalidLiterals {};
     friend class ARMJIT_Memory;
     void blockSanityCheck(u32 num, u32 blockAddr, JitBlockEntry entry) noexcept;
     void RetireJitBlock(JitBlock* block) noexcept;
+    bool CanLink(JitBlock* from, JitBlock* to) const noexcept;
+    // needs write access to the code memory
+    void PatchLink(JitBlock* from, JitBlockEntry entry) noexcept;
+    void LinkBlock(JitBlock* from, JitBlock* to) noexcept;
+    void AddBlockLinks(JitBlock* block) noexcept;
+    void RemoveBlockLinks(JitBlock* block) noexcept;
 
     int GetMaxBlockSize() const noexcept { return MaxBlockSize; }
     bool LiteralOptimizationsEnabled() const noexcept { return LiteralOptimizations; }
     bool BranchOptimizationsEnabled() const noexcept { return BranchOptimizations; }
     bool FastMemoryEnabled() const noexcept { return FastMemory; }
+#ifdef JIT_BACKEND_FAST_VRAM
+    bool FastVRAMEnabled() const noexcept { return FastMemory && FastVRAM; }
+#else
+    bool FastVRAMEnabled() const noexcept { return false; }
+#endif
+#ifdef JIT_BACKEND_BACKGROUND_COMPILE
+    bool BackgroundCompileEnabled() const noexcept { return BackgroundCompile; }
+#else
+    bool BackgroundCompileEnabled() const noexcept { return false; }
+#endif
+    u32 GetCompileThreshold() const noexcept { return CompileThreshold; }
 
     void SetJITArgs(JITArgs args) noexcept;
     void SetMaxBlockSize(int size) noexcept;
     void SetLiteralOptimizations(bool enabled) noexcept;
     void SetBranchOptimizations(bool enabled) noexcept;
     void SetFastMemory(bool enabled) noexcept;
+    void SetFastVRAM(bool enabled) noexcept;
+    void SetBackgroundCompile(bool enabled) noexcept;
+    void SetCompileThreshold(u32 threshold) noexcept { CompileThreshold = threshold; }
+    // they aren't part of savestates, so loading one starts them over
+    void ResetInterpretCounts() noexcept { InterpretCounts.Clear(); }
 
     Compiler JITCompiler;
-    std::unordered_map<u32, JitBlock*> JitBlocks9 {};
-    std::unordered_map<u32, JitBlock*> JitBlocks7 {};
+    FlatHashMap<JitBlock*> JitBlocks9 {};
+    FlatHashMap<JitBlock*> JitBlocks7 {};
+
+    FlatHashMap<JitBlock*> RestoreCandidates {};
+    JitBlockPool BlockPool {};
 
-    std::unordered_map<u32, JitBlock*> RestoreCandidates {};
+    // blocks which could be linked to the one starting at the key
+    // once it's compiled, for each CPU
+    std::unordered_multimap<u32, JitBlock*> PendingLinks[2] {};
+    bool LinksOutdated = false;
 
 
     AddressRange CodeIndexITCM[ITCMPhysicalSize / 512] {};
@@ -119,19 +265,19 @@ public:
     AddressRange CodeIndexNWRAM_B[NWRAMSize / 512] {};
     AddressRange CodeIndexNWRAM_C[NWRAMSize / 512] {};
 
-    u64 FastBlockLookupITCM[ITCMPhysicalSize / 2] {};
-    u64 FastBlockLookupMainRAM[MainRAMMaxSize / 2] {};
-    u64 FastBlockLookupSWRAM[SharedWRAMSize / 2] {};
-    u64 FastBlockLookupVRAM[0x100000 / 2] {};
-    u64 FastBlockLookupARM9BIOS[ARM9BIOSSize / 2] {};
-    u64 FastBlockLookupARM7BIOS[ARM7BIOSSize / 2] {};
-    u64 FastBlockLookupARM7WRAM[ARM7WRAMSize / 2] {};
-    u64 FastBlockLookupARM7WVRAM[0x40000 / 2] {};
-    u64 FastBlockLookupBIOS9DSi[0x10000 / 2] {};
-    u64 FastBlockLookupBIOS7DSi[0x10000 / 2] {};
-    u64 FastBlockLookupNWRAM_A[NWRAMSize / 2] {};
-    u64 FastBlockLookupNWRAM_B[NWRAMSize / 2] {};
-    u64 FastBlockLookupNWRAM_C[NWRAMSize / 2] {};
+    BlockLookupTable FastBlockLookupITCM {ITCMPhysicalSize};
+    BlockLookupTable FastBlockLookupMainRAM {MainRAMMaxSize};
+    BlockLookupTable FastBlockLookupSWRAM {SharedWRAMSize};
+    BlockLookupTable FastBlockLookupVRAM {0x100000};
+    BlockLookupTable FastBlockLookupARM9BIOS {ARM9BIOSSize};
+    BlockLookupTable FastBlockLookupARM7BIOS {ARM7BIOSSize};
+    BlockLookupTable FastBlockLookupARM7WRAM {ARM7WRAMSize};
+    BlockLookupTable FastBlockLookupARM7WVRAM {0x40000};
+    BlockLookupTable FastBlockLookupBIOS9DSi {0x10000};
+    BlockLookupTable FastBlockLookupBIOS7DSi {0x10000};
+    BlockLookupTable FastBlockLookupNWRAM_A {NWRAMSize};
+    BlockLookupTable FastBlockLookupNWRAM_B {NWRAMSize};
+    BlockLookupTable FastBlockLookupNWRAM_C {NWRAMSize};
 
     AddressRange* const CodeMemRegions[ARMJIT_Memory::memregions_Count] =
     {
@@ -155,26 +301,26 @@ public:
         CodeIndexNWRAM_C
     };
 
-    u64* const FastBlockLookupRegions[ARMJIT_Memory::memregions_Count] =
+    BlockLookupTable* const FastBlockLookupRegions[ARMJIT_Memory::memregions_Count] =
     {
         NULL,
-        FastBlockLookupITCM,
+        &FastBlockLookupITCM,
         NULL,
-        FastBlockLookupARM9BIOS,
-        FastBlockLookupMainRAM,
-        FastBlockLookupSWRAM,
+        &FastBlockLookupARM9BIOS,
+        &FastBlockLookupMainRAM,
+        &FastBlockLookupSWRAM,
         NULL,
-        FastBlockLookupVRAM,
-        FastBlockLookupARM7BIOS,
-        FastBlockLookupARM7WRAM,
+        &FastBlockLookupVRAM,
+        &FastBlockLookupARM7BIOS,
+        &FastBlockLookupARM7WRAM,
         NULL,
         NULL,
-        FastBlockLookupARM7WVRAM,
-        FastBlockLookupBIOS9DSi,
-        FastBlockLookupBIOS7DSi,
-        FastBlockLookupNWRAM_A,
-        FastBlockLookupNWRAM_B,
-        FastBlockLookupNWRAM_C
+        &FastBlockLookupARM7WVRAM,
+        &FastBlockLookupBIOS9DSi,
+        &FastBlockLookupBIOS7DSi,
+        &FastBlockLookupNWRAM_A,
+        &FastBlockLookupNWRAM_B,
+        &FastBlockLookupNWRAM_C
     };
 };
 }
@@ -200,7 +346,9 @@ public:
     void JitEnableWrite() noexcept {}
     void JitEnableExecute() noexcept {}
     void CompileBlock(ARM*) noexcept {}
+    void FinishCompiles() noexcept {}
     void ResetBlockCache() noexcept {}
+    void UnlinkBlocks() noexcept {}
     template <u32, int>
     void CheckAndInvalidate(u32 addr) noexcept {}
 
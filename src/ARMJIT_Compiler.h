@@ -23,8 +23,23 @@
 
 #if defined(__x86_64__)
 #include "ARMJIT_x64/ARMJIT_Compiler.h"
+
+// what only the x64 backend does so far:
+
+// it drops the ARM9's byte stores to VRAM itself, so VRAM can be in fast memory
+#define JIT_BACKEND_FAST_VRAM
+// it asks for its code memory to be put into huge pages
+#define JIT_BACKEND_HUGE_PAGES
+// it doesn't touch the CPUs or the console while compiling, so it can do that on another thread
+#define JIT_BACKEND_BACKGROUND_COMPILE
+// it ends blocks with an exit which can be patched to jump straight into the next block
+#define JIT_BACKEND_BLOCK_LINKING
 #elif defined(__aarch64__)
 #include "ARMJIT_A64/ARMJIT_Compiler.h"
+
+#ifdef JIT_PERF_MAP_ENABLED
+#error "Only the x64 JIT backend writes a perf map and counts block entries"
+#endif
 #else
 #error "The current target platform doesn't have a JIT backend"
 #endif
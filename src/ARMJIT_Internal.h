@@ -63,16 +63,42 @@ struct FetchedInstr
 
     u8 BranchFlags;
     u8 SetFlags;
+    // registers whose current value might still be read, at the start of the instruction
+    u16 LiveRegs;
     u32 Instr;
     u32 Addr;
 
     u8 DataCycles;
+    // the memory region DataRegion falls into
+    u8 DataMemRegion;
     u16 CodeCycles;
     u32 DataRegion;
 
+    // looked up while decoding, so that the compile thread doesn't need the
+    // timing tables: the ARM7MemTimings row of the ARM7's own code, and for
+    // a branch to an immediate target the timings of the target
+    // (MemTimings[target >> 12][0] for the ARM9, its ARM7MemTimings row for the ARM7)
+    u8 CodeTimings[4];
+    u8 TargetTimings[4];
+
+    // a literal load is compiled to a constant if the literal could be
+    // read while decoding the block, Literal is the word it's in then
+    bool HasLiteral;
+    u32 Literal;
+
     ARMInstrInfo::Info Info;
 };
 
+// the memory control registers a block is compiled with,
+// copied while it's decoded for the same reason
+struct CompileMemControl
+{
+    u32 ITCMSize;
+    u16 ExMemCnt9;
+    // 0 on the DS
+    u32 SCFGExt9;
+};
+
 // size should be 16 bytes because I'm to lazy to use mul and whatnot
 struct __attribute__((packed)) AddressRange
 {
@@ -103,6 +129,11 @@ template <typename T, int ConsoleType> void SlowWrite7(u32 addr, u32 val);
 template <bool Write, int ConsoleType> void SlowBlockTransfer9(u32 addr, u64* data, u32 num, ARMv5* cpu);
 template <bool Write, int ConsoleType> void SlowBlockTransfer7(u32 addr, u64* data, u32 num);
 
+#ifdef JIT_PERF_MAP_ENABLED
+// names generated code for Linux perf, in /tmp/perf-<pid>.map
+void AddPerfMapSymbol(const void* start, size_t size, const char* namefmt, ...);
+#endif
+
 }
 
 #endif
\ No newline at end of file
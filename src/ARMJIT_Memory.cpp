@@ -47,6 +47,7 @@
 #include "NDSCart.h"
 #include "SPU.h"
 
+#include <stdio.h>
 #include <stdlib.h>
 
 /*
@@ -240,12 +241,12 @@ const u32 OffsetsPerRegion[ARMJIT_Memory::memregions_Count] =
     MemBlockMainRAMOffset,
     MemBlockSWRAMOffset,
     UINT32_MAX,
-    UINT32_MAX,
+    MemBlockVRAMOffset,
     UINT32_MAX,
     MemBlockARM7WRAMOffset,
     UINT32_MAX,
     UINT32_MAX,
-    UINT32_MAX,
+    MemBlockVRAMOffset,
     UINT32_MAX,
     UINT32_MAX,
     MemBlockNWRAM_AOffset,
@@ -259,6 +260,8 @@ enum
     memstate_MappedRW,
     // on Switch this is unmapped as well
     memstate_MappedProtected,
+    // VRAM, read only until it's written to, see UnprotectVRAM()
+    memstate_MappedWriteTracked,
 };
 
 
@@ -274,7 +277,11 @@ bool ARMJIT_Memory::MapIntoRange(u32 addr, u32 num, u32 offset, u32 size) noexce
     bool r = MapViewOfFileEx(MemoryFile, FILE_MAP_READ | FILE_MAP_WRITE, 0, offset, size, dst) == dst;
     return r;
 #else
-    return mmap(dst, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, MemoryFile, offset) != MAP_FAILED;
+    if (mmap(dst, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, MemoryFile, offset) == MAP_FAILED)
+        return false;
+    // main RAM and its mirrors are big enough
+    AdviseHugePages(dst, size);
+    return true;
 #endif
 }
 
@@ -405,10 +412,16 @@ void ARMJIT_Memory::SetCodeProtection(int region, u32 offset, bool protect) noex
             continue;
 
         u8* states = (u8*)(mapping.Num == 0 ? MappingStatus9 : MappingStatus7);
+        // VRAM goes back to being write-tracked, which leaves it read only
+        bool writeTracked = region == memregion_VRAM || region == memregion_VWRAM;
 
         //printf("%x %d %x %x %x %d\n", effectiveAddr, mapping.Num, mapping.Addr, mapping.LocalOffset, mapping.Size, states[effectiveAddr >> 12]);
-        assert(states[effectiveAddr >> 12] == (protect ? memstate_MappedRW : memstate_MappedProtected));
-        states[effectiveAddr >> 12] = protect ? memstate_MappedProtected : memstate_MappedRW;
+        assert(protect
+            ? (states[effectiveAddr >> 12] == memstate_MappedRW || states[effectiveAddr >> 12] == memstate_MappedWriteTracked)
+            : states[effectiveAddr >> 12] == memstate_MappedProtected);
+        states[effectiveAddr >> 12] = protect
+            ? memstate_MappedProtected
+            : (writeTracked ? memstate_MappedWriteTracked : memstate_MappedRW);
 
 #if defined(__SWITCH__)
         bool success;
@@ -418,11 +431,63 @@ void ARMJIT_Memory::SetCodeProtection(int region, u32 offset, bool protect) noex
             success = MapIntoRange(effectiveAddr, mapping.Num, OffsetsPerRegion[region] + offset, 0x1000);
         assert(success);
 #else
-        SetCodeProtectionRange(effectiveAddr, 0x1000, mapping.Num, protect ? 1 : 2);
+        SetCodeProtectionRange(effectiveAddr, 0x1000, mapping.Num, (protect || writeTracked) ? 1 : 2);
 #endif
     }
 }
 
+void ARMJIT_Memory::UnprotectVRAM(u32 num, u32 addr) noexcept
+{
+#ifndef __SWITCH__
+    addr &= ~0xFFF;
+
+    // the mapping only exists while a single bank is there
+    u8* page = num == 0 ? NDS.GPU.GetARM9VRAMPage(addr) : NDS.GPU.GetARM7VRAMPage(addr);
+    assert(page);
+    page += addr & 0x3000;
+
+    u32 bank = NDS.GPU.GetVRAMBank(page);
+    assert(bank != ~0u);
+    u32 offset = page - NDS.GPU.VRAM[bank];
+    for (u32 i = 0; i < 0x1000; i += VRAMDirtyGranularity)
+        NDS.GPU.MarkVRAMDirty(bank, offset + i);
+
+    u8* states = num == 0 ? MappingStatus9 : MappingStatus7;
+    states[addr >> 12] = memstate_MappedRW;
+    SetCodeProtectionRange(addr, 0x1000, num, 2);
+
+    WrittenVRAMPages.push_back(addr | (bank << 1) | num);
+#endif
+}
+
+void ARMJIT_Memory::ProtectVRAM(u32 banks) noexcept
+{
+#ifndef __SWITCH__
+    for (size_t i = 0; i < WrittenVRAMPages.size();)
+    {
+        u32 entry = WrittenVRAMPages[i];
+        if (!(banks & (1 << ((entry >> 1) & 0xF))))
+        {
+            i++;
+            continue;
+        }
+
+        u32 num = entry & 0x1;
+        u32 addr = entry & ~0xFFF;
+        u8* states = num == 0 ? MappingStatus9 : MappingStatus7;
+        // it might have been unmapped or had code put in it since
+        if (states[addr >> 12] == memstate_MappedRW)
+        {
+            states[addr >> 12] = memstate_MappedWriteTracked;
+            SetCodeProtectionRange(addr, 0x1000, num, 1);
+        }
+
+        WrittenVRAMPages[i] = WrittenVRAMPages.back();
+        WrittenVRAMPages.pop_back();
+    }
+#endif
+}
+
 void ARMJIT_Memory::RemapDTCM(u32 newBase, u32 newSize) noexcept
 {
     // this first part could be made more efficient
@@ -496,6 +561,8 @@ void ARMJIT_Memory::RemapNWRAM(int num) noexcept
         Mappings[memregion_NewSharedWRAM_A + num][i].Unmap(memregion_NewSharedWRAM_A + num, NDS);
     }
     Mappings[memregion_NewSharedWRAM_A + num].Clear();
+
+    NDS.JIT.UnlinkBlocks();
 }
 
 void ARMJIT_Memory::RemapSWRAM() noexcept
@@ -517,6 +584,42 @@ void ARMJIT_Memory::RemapSWRAM() noexcept
         Mappings[memregion_SharedWRAM][i].Unmap(memregion_SharedWRAM, NDS);
     }
     Mappings[memregion_SharedWRAM].Clear();
+
+    NDS.JIT.UnlinkBlocks();
+}
+
+void ARMJIT_Memory::RemapVRAM(u32 windows) noexcept
+{
+    for (int i = 0; i < Mappings[memregion_VRAM].Length;)
+    {
+        Mapping& mapping = Mappings[memregion_VRAM][i];
+        if (windows & (1 << ((mapping.Addr >> 21) & 0x7)))
+        {
+            mapping.Unmap(memregion_VRAM, NDS);
+            Mappings[memregion_VRAM].Remove(i);
+        }
+        else
+            i++;
+    }
+    if (windows & (1 << 8))
+    {
+        for (int i = 0; i < Mappings[memregion_VWRAM].Length; i++)
+            Mappings[memregion_VWRAM][i].Unmap(memregion_VWRAM, NDS);
+        Mappings[memregion_VWRAM].Clear();
+    }
+
+    for (size_t i = 0; i < WrittenVRAMPages.size();)
+    {
+        u32 entry = WrittenVRAMPages[i];
+        u8* states = (entry & 0x1) == 0 ? MappingStatus9 : MappingStatus7;
+        if (states[entry >> 12] == memstate_Unmapped)
+        {
+            WrittenVRAMPages[i] = WrittenVRAMPages.back();
+            WrittenVRAMPages.pop_back();
+        }
+        else
+            i++;
+    }
 }
 
 bool ARMJIT_Memory::MapAtAddress(u32 addr) noexcept
@@ -531,10 +634,18 @@ bool ARMJIT_Memory::MapAtAddress(u32 addr) noexcept
         return false;
 
     u32 mirrorStart, mirrorSize, memoryOffset;
-    bool isMapped = GetMirrorLocation(region, num, addr, memoryOffset, mirrorStart, mirrorSize);
+    bool writeTracked = region == memregion_VRAM || region == memregion_VWRAM;
+    bool isMapped = writeTracked
+        ? GetVRAMLocation(num, addr, memoryOffset, mirrorStart, mirrorSize)
+        : GetMirrorLocation(region, num, addr, memoryOffset, mirrorStart, mirrorSize);
     if (!isMapped)
         return false;
 
+    // code in VRAM is tracked by its address, regardless of the bank that's there
+    u32 codeOffset = writeTracked
+        ? LocaliseAddress(region, num, mirrorStart) & 0x7FFFFFF
+        : memoryOffset;
+
     u8* states = num == 0 ? MappingStatus9 : MappingStatus7;
     //printf("mapping mirror %x, %x %x %d %d\n", mirrorStart, mirrorSize, memoryOffset, region, num);
     bool isExecutable = NDS.JIT.CodeMemRegions[region];
@@ -569,7 +680,7 @@ bool ARMJIT_Memory::MapAtAddress(u32 addr) noexcept
     }
 #endif
 
-    AddressRange* range = NDS.JIT.CodeMemRegions[region] + memoryOffset / 512;
+    AddressRange* range = NDS.JIT.CodeMemRegions[region] + codeOffset / 512;
 
     // this overcomplicated piece of code basically just finds whole pieces of code memory
     // which can be mapped/protected
@@ -593,7 +704,9 @@ bool ARMJIT_Memory::MapAtAddress(u32 addr) noexcept
                 && (!skipDTCM || mirrorStart + offset != NDS.ARM9.DTCMBase))
             {
                 assert(states[(mirrorStart + offset) >> 12] == memstate_Unmapped);
-                states[(mirrorStart + offset) >> 12] = hasCode ? memstate_MappedProtected : memstate_MappedRW;
+                states[(mirrorStart + offset) >> 12] = hasCode
+                    ? memstate_MappedProtected
+                    : (writeTracked ? memstate_MappedWriteTracked : memstate_MappedRW);
                 offset += 0x1000;
             }
 
@@ -607,7 +720,7 @@ bool ARMJIT_Memory::MapAtAddress(u32 addr) noexcept
                 assert(succeded);
             }
 #else
-            if (hasCode)
+            if (hasCode || writeTracked)
             {
                 SetCodeProtectionRange(mirrorStart + sectionOffset, sectionSize, num, 1);
             }
@@ -616,7 +729,7 @@ bool ARMJIT_Memory::MapAtAddress(u32 addr) noexcept
     }
 
     assert(num == 0 || num == 1);
-    Mapping mapping{mirrorStart, mirrorSize, memoryOffset, num};
+    Mapping mapping{mirrorStart, mirrorSize, codeOffset, num};
     Mappings[region].Add(mapping);
 
     //printf("mapped mirror at %08x-%08x\n", mirrorStart, mirrorStart + mirrorSize - 1);
@@ -632,8 +745,23 @@ bool ARMJIT_Memory::FaultHandler(FaultDescription& faultDesc, melonDS::NDS& nds)
 
         u8* memStatus = nds.CurCPU == 0 ? nds.JIT.Memory.MappingStatus9 : nds.JIT.Memory.MappingStatus7;
 
-        if (memStatus[faultDesc.EmulatedFaultAddr >> 12] == memstate_Unmapped)
+        u8 status = memStatus[faultDesc.EmulatedFaultAddr >> 12];
+        if (status == memstate_Unmapped)
+        {
             rewriteToSlowPath = !nds.JIT.Memory.MapAtAddress(faultDesc.EmulatedFaultAddr);
+        }
+#ifdef JIT_BACKEND_FAST_VRAM
+        else if (status == memstate_MappedWriteTracked)
+        {
+            // a byte store which wasn't expected to go to VRAM, it has to be dropped.
+            // Otherwise it's the first write since the renderers last looked at the page
+            rewriteToSlowPath = nds.CurCPU == 0
+                && (nds.ConsoleType == 0 || !(static_cast<DSi&>(nds).SCFG_EXT[0] & (1<<13)))
+                && nds.JIT.JITCompiler.IsARM9ByteStore(faultDesc.FaultPC);
+            if (!rewriteToSlowPath)
+                nds.JIT.Memory.UnprotectVRAM(nds.CurCPU, faultDesc.EmulatedFaultAddr);
+        }
+#endif
 
         if (rewriteToSlowPath)
             faultDesc.FaultPC = nds.JIT.JITCompiler.RewriteMemAccess(faultDesc.FaultPC);
@@ -644,6 +772,51 @@ bool ARMJIT_Memory::FaultHandler(FaultDescription& faultDesc, melonDS::NDS& nds)
 }
 
 const u64 AddrSpaceSize = 0x100000000;
+const size_t HugePageSize = 2 * 1024 * 1024;
+
+void ARMJIT_Memory::AdviseHugePages(void* start, size_t size) noexcept
+{
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+    // only the huge pages which lie completely inside can be used,
+    // whether they are is up to the kernel (and its settings for shared memory)
+    uintptr_t alignedStart = ((uintptr_t)start + HugePageSize - 1) & ~(uintptr_t)(HugePageSize - 1);
+    uintptr_t alignedEnd = ((uintptr_t)start + size) & ~(uintptr_t)(HugePageSize - 1);
+    if (alignedEnd > alignedStart)
+        madvise((void*)alignedStart, alignedEnd - alignedStart, MADV_HUGEPAGE);
+#endif
+}
+
+size_t ARMJIT_Memory::GetHugePageBackedSize(const void* start, size_t size) noexcept
+{
+    size_t total = 0;
+#if defined(__linux__)
+    FILE* smaps = fopen("/proc/self/smaps", "r");
+    if (!smaps)
+        return 0;
+
+    unsigned long long begin = (uintptr_t)start, end = (uintptr_t)start + size;
+    bool inRange = false;
+    char line[512];
+    while (fgets(line, sizeof(line), smaps))
+    {
+        unsigned long long vmaStart, vmaEnd, kb;
+        if (sscanf(line, "%llx-%llx", &vmaStart, &vmaEnd) == 2)
+            inRange = vmaStart < end && vmaEnd > begin;
+        else if (inRange && (sscanf(line, "AnonHugePages: %llu kB", &kb) == 1
+            || sscanf(line, "ShmemPmdMapped: %llu kB", &kb) == 1))
+            total += kb * 1024;
+    }
+    fclose(smaps);
+#endif
+    return total;
+}
+
+void ARMJIT_Memory::GetHugePageUsage(size_t& memory, size_t& views) const noexcept
+{
+    memory = GetHugePageBackedSize(MemoryBase, MemoryTotalSize);
+    views = GetHugePageBackedSize(FastMem9Start, AddrSpaceSize)
+        + GetHugePageBackedSize(FastMem7Start, AddrSpaceSize);
+}
 
 ARMJIT_Memory::ARMJIT_Memory(melonDS::NDS& nds) : NDS(nds)
 {
@@ -693,8 +866,10 @@ ARMJIT_Memory::ARMJIT_Memory(melonDS::NDS& nds) : NDS(nds)
     // The idea was to give the OS more freedom where to position the buffers,
     // but something was bad about this so instead we take this vmem eating monster
     // which seems to work better.
-    MemoryBase = (u8*)mmap(NULL, AddrSpaceSize*4, PROT_NONE, MAP_ANON | MAP_PRIVATE, -1, 0);
-    munmap(MemoryBase, AddrSpaceSize*4);
+    // aligned to huge pages, so that the regions in them can be put into those
+    MemoryBase = (u8*)mmap(NULL, AddrSpaceSize*4 + HugePageSize, PROT_NONE, MAP_ANON | MAP_PRIVATE, -1, 0);
+    munmap(MemoryBase, AddrSpaceSize*4 + HugePageSize);
+    MemoryBase = (u8*)(((uintptr_t)MemoryBase + HugePageSize - 1) & ~(uintptr_t)(HugePageSize - 1));
     FastMem9Start = MemoryBase;
     FastMem7Start = MemoryBase + AddrSpaceSize;
     MemoryBase = MemoryBase + AddrSpaceSize*2;
@@ -716,14 +891,21 @@ ARMJIT_Memory::ARMJIT_Memory(melonDS::NDS& nds) : NDS(nds)
         MemoryFile = fd;
     }
 #else
-    char fastmemPidName[snprintf(NULL, 0, "/melondsfastmem%d", getpid()) + 1];
-    sprintf(fastmemPidName, "/melondsfastmem%d", getpid());
-    MemoryFile = shm_open(fastmemPidName, O_RDWR | O_CREAT | O_EXCL, 0600);
+#if defined(__linux__)
+    // unlike the tmpfs behind shm_open this can be put into huge pages
+    MemoryFile = memfd_create("melondsfastmem", MFD_CLOEXEC);
     if (MemoryFile == -1)
+#endif
     {
-        Log(LogLevel::Error, "Failed to open memory using shm_open! (%s)", strerror(errno));
+        char fastmemPidName[snprintf(NULL, 0, "/melondsfastmem%d", getpid()) + 1];
+        sprintf(fastmemPidName, "/melondsfastmem%d", getpid());
+        MemoryFile = shm_open(fastmemPidName, O_RDWR | O_CREAT | O_EXCL, 0600);
+        if (MemoryFile == -1)
+        {
+            Log(LogLevel::Error, "Failed to open memory using shm_open! (%s)", strerror(errno));
+        }
+        shm_unlink(fastmemPidName);
     }
-    shm_unlink(fastmemPidName);
 #endif
     if (ftruncate(MemoryFile, MemoryTotalSize) < 0)
     {
@@ -741,6 +923,7 @@ ARMJIT_Memory::ARMJIT_Memory(melonDS::NDS& nds) : NDS(nds)
 #endif
 
     mmap(MemoryBase, MemoryTotalSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, MemoryFile, 0);
+    AdviseHugePages(MemoryBase, MemoryTotalSize);
 
     u8* basePtr = MemoryBase;
 #endif
@@ -822,6 +1005,7 @@ void ARMJIT_Memory::Reset() noexcept
             Mappings[region][i].Unmap(region, NDS);
         Mappings[region].Clear();
     }
+    WrittenVRAMPages.clear();
 
     for (size_t i = 0; i < sizeof(MappingStatus9); i++)
     {
@@ -845,6 +1029,15 @@ bool ARMJIT_Memory::IsFastmemCompatible(int region) const noexcept
         || region == memregion_NewSharedWRAM_C)
         return false;
 #endif
+    if (region == memregion_VRAM || region == memregion_VWRAM)
+    {
+        // the banks are mapped in 16 KB pieces and write-protected 4 KB at a time
+#if defined(_WIN32) || defined(__SWITCH__)
+        return false;
+#else
+        return NDS.JIT.FastVRAMEnabled();
+#endif
+    }
     return OffsetsPerRegion[region] != UINT32_MAX;
 }
 
@@ -997,6 +1190,20 @@ bool ARMJIT_Memory::GetMirrorLocation(int region, u32 num, u32 addr, u32& memory
     }
 }
 
+bool ARMJIT_Memory::GetVRAMLocation(u32 num, u32 addr, u32& memoryOffset, u32& mirrorStart, u32& mirrorSize) const noexcept
+{
+    // where several banks overlap writes go to all of them,
+    // those stay on the slow path like unmapped VRAM
+    const u8* page = num == 0 ? NDS.GPU.GetARM9VRAMPage(addr) : NDS.GPU.GetARM7VRAMPage(addr);
+    if (!page)
+        return false;
+
+    memoryOffset = page - GetVRAM();
+    mirrorStart = addr & ~0x3FFF;
+    mirrorSize = 0x4000;
+    return true;
+}
+
 u32 ARMJIT_Memory::LocaliseAddress(int region, u32 num, u32 addr) const noexcept
 {
     switch (region)
@@ -1323,13 +1530,18 @@ static void NDS_ARM7IOWrite32(u32 addr, u32 val)
 }
 
 void* ARMJIT_Memory::GetFuncForAddr(ARM* cpu, u32 addr, bool store, int size) const noexcept
+{
+    return GetFuncForAddr(cpu, addr, store, size, NDS.ExMemCnt[0]);
+}
+
+void* ARMJIT_Memory::GetFuncForAddr(ARM* cpu, u32 addr, bool store, int size, u16 exMemCnt9) const noexcept
 {
     if (cpu->Num == 0)
     {
         switch (addr & 0xFF000000)
         {
         case 0x04000000:
-            if (!store && size == 32 && addr == 0x04100010 && NDS.ExMemCnt[0] & (1<<11))
+            if (!store && size == 32 && addr == 0x04100010 && exMemCnt9 & (1<<11))
                 return (void*)NDSCartSlot_ReadROMData;
 
             /*
@@ -23,6 +23,7 @@
 #include "MemConstants.h"
 
 #ifdef JIT_ENABLED
+#  include <vector>
 #  include "TinyVector.h"
 #  include "ARM.h"
 #  if defined(__SWITCH__)
@@ -64,7 +65,8 @@ const u32 MemBlockDTCMOffset = MemBlockARM7WRAMOffset + RoundUp(ARM7WRAMSize);
 const u32 MemBlockNWRAM_AOffset = MemBlockDTCMOffset + RoundUp(DTCMPhysicalSize);
 const u32 MemBlockNWRAM_BOffset = MemBlockNWRAM_AOffset + RoundUp(NWRAMSize);
 const u32 MemBlockNWRAM_COffset = MemBlockNWRAM_BOffset + RoundUp(NWRAMSize);
-const u32 MemoryTotalSize = MemBlockNWRAM_COffset + RoundUp(NWRAMSize);
+const u32 MemBlockVRAMOffset = MemBlockNWRAM_COffset + RoundUp(NWRAMSize);
+const u32 MemoryTotalSize = MemBlockVRAMOffset + RoundUp(VRAMSize);
 
 class ARMJIT_Memory
 {
@@ -107,7 +109,13 @@ public:
     void RemapDTCM(u32 newBase, u32 newSize) noexcept;
     void RemapSWRAM() noexcept;
     void RemapNWRAM(int num) noexcept;
+    // windows has a bit for each 2MB of the ARM9's VRAM space whose
+    // mappings are dropped, and bit 8 for the ARM7's, see GPU::VRAMWindows()
+    void RemapVRAM(u32 windows) noexcept;
     void SetCodeProtection(int region, u32 offset, bool protect) noexcept;
+    // write-protects the pages of these VRAM banks again which were written
+    // to through fast memory, after their dirty flags have been cleared
+    void ProtectVRAM(u32 banks) noexcept;
 
     [[nodiscard]] u8* GetMainRAM() noexcept { return MemoryBase + MemBlockMainRAMOffset; }
     [[nodiscard]] const u8* GetMainRAM() const noexcept { return MemoryBase + MemBlockMainRAMOffset; }
@@ -130,13 +138,26 @@ public:
     [[nodiscard]] u8* GetNWRAM_C() noexcept { return MemoryBase + MemBlockNWRAM_COffset; }
     [[nodiscard]] const u8* GetNWRAM_C() const noexcept { return MemoryBase + MemBlockNWRAM_COffset; }
 
+    [[nodiscard]] u8* GetVRAM() noexcept { return MemoryBase + MemBlockVRAMOffset; }
+    [[nodiscard]] const u8* GetVRAM() const noexcept { return MemoryBase + MemBlockVRAMOffset; }
+
     int ClassifyAddress9(u32 addr) const noexcept;
     int ClassifyAddress7(u32 addr) const noexcept;
     bool GetMirrorLocation(int region, u32 num, u32 addr, u32& memoryOffset, u32& mirrorStart, u32& mirrorSize) const noexcept;
+    bool GetVRAMLocation(u32 num, u32 addr, u32& memoryOffset, u32& mirrorStart, u32& mirrorSize) const noexcept;
     u32 LocaliseAddress(int region, u32 num, u32 addr) const noexcept;
     bool IsFastmemCompatible(int region) const noexcept;
+    void* GetFuncForAddr(ARM* cpu, u32 addr, bool store, int size, u16 exMemCnt9) const noexcept;
+    // with the current EXMEMCNT, for compiling on the emulation thread
     void* GetFuncForAddr(ARM* cpu, u32 addr, bool store, int size) const noexcept;
     bool MapAtAddress(u32 addr) noexcept;
+
+    // asks for the range to be put into huge pages, only does something on Linux
+    static void AdviseHugePages(void* start, size_t size) noexcept;
+    // how much of the range is mapped through huge pages, in bytes
+    static size_t GetHugePageBackedSize(const void* start, size_t size) noexcept;
+    // of the memory block itself and of the fast memory views into it
+    void GetHugePageUsage(size_t& memory, size_t& views) const noexcept;
 private:
     friend class Compiler;
     struct Mapping
@@ -154,6 +175,7 @@ private:
         u8* FaultPC;
     };
     static bool FaultHandler(FaultDescription& faultDesc, melonDS::NDS& nds);
+    void UnprotectVRAM(u32 num, u32 addr) noexcept;
     bool MapIntoRange(u32 addr, u32 num, u32 offset, u32 size) noexcept;
     bool UnmapFromRange(u32 addr, u32 num, u32 offset, u32 size) noexcept;
     void SetCodeProtectionRange(u32 addr, u32 size, u32 num, int protection) noexcept;
@@ -179,6 +201,8 @@ private:
     u8 MappingStatus9[1 << (32-12)] {};
     u8 MappingStatus7[1 << (32-12)] {};
     TinyVector<Mapping> Mappings[memregions_Count] {};
+    // the VRAM pages which were made writable, page address | bank << 1 | num
+    std::vector<u32> WrittenVRAMPages {};
 #else
 public:
     explicit ARMJIT_Memory(melonDS::NDS&) {};
@@ -192,7 +216,9 @@ public:
     void RemapDTCM(u32 newBase, u32 newSize) noexcept {}
     void RemapSWRAM() noexcept {}
     void RemapNWRAM(int num) noexcept {}
+    void RemapVRAM(u32 windows) noexcept {}
     void SetCodeProtection(int region, u32 offset, bool protect) noexcept {}
+    void ProtectVRAM(u32 banks) noexcept {}
 
     [[nodiscard]] u8* GetMainRAM() noexcept { return MainRAM.data(); }
     [[nodiscard]] const u8* GetMainRAM() const noexcept { return MainRAM.data(); }
@@ -214,6 +240,9 @@ public:
 
     [[nodiscard]] u8* GetNWRAM_C() noexcept { return NWRAM_C.data(); }
     [[nodiscard]] const u8* GetNWRAM_C() const noexcept { return NWRAM_C.data(); }
+
+    [[nodiscard]] u8* GetVRAM() noexcept { return VRAM.data(); }
+    [[nodiscard]] const u8* GetVRAM() const noexcept { return VRAM.data(); }
 private:
     std::array<u8, MainRAMMaxSize> MainRAM {};
     std::array<u8, ARM7WRAMSize> ARM7WRAM {};
@@ -222,6 +251,7 @@ private:
     std::array<u8, NWRAMSize> NWRAM_A {};
     std::array<u8, NWRAMSize> NWRAM_B {};
     std::array<u8, NWRAMSize> NWRAM_C {};
+    std::array<u8, VRAMSize> VRAM {};
 #endif
 };
 }
@@ -34,7 +34,9 @@ namespace melonDS
     using namespace Common;
     // Imported inside the namespace so that other headers aren't polluted
 
-template <typename T, typename Reg>
+// EvictByLiveness makes use of FetchedInstr::LiveRegs when registers run out,
+// otherwise the register with the fewest uses left in the block is given up
+template <typename T, typename Reg, bool EvictByLiveness = false>
 class RegisterCache
 {
 public:
@@ -59,6 +61,14 @@ public:
         if (DirtyRegs & (1 << reg))
             Compiler->SaveReg(reg, Mapping[reg]);
 
+        DiscardRegister(reg);
+    }
+
+    // drops the register without writing it back, only for values nobody is going to read
+    void DiscardRegister(int reg)
+    {
+        assert(Mapping[reg] != -1);
+
         DirtyRegs &= ~(1 << reg);
         LoadedRegs &= ~(1 << reg);
         NativeRegsUsed &= ~(1 << (int)Mapping[reg]);
@@ -132,15 +142,22 @@ public:
 
         u16 futureNeeded = 0;
         int ranking[16];
+        int nextUse[16];
         for (int j = 0; j < 16; j++)
+        {
             ranking[j] = 0;
-        for (int j = i; j < InstrsCount; j++)
+            nextUse[j] = InstrsCount;
+        }
+        for (int j = InstrsCount - 1; j >= i; j--)
         {
             BitSet16 regsNeeded((Instrs[j].Info.SrcRegs & ~(1 << 15)) | Instrs[j].Info.DstRegs);
             futureNeeded |= regsNeeded.m_val;
             regsNeeded &= BitSet16(~Instrs[j].Info.NotStrictlyNeeded);
             for (int reg : regsNeeded)
+            {
                 ranking[reg]++;
+                nextUse[reg] = j;
+            }
         }
 
         // we'll unload all registers which are never used again
@@ -156,19 +173,53 @@ public:
             BitSet16 loadedSet(LoadedRegs);
             while (loadedSet.Count() + neededCount > NativeRegsAvailable)
             {
-                int leastReg = -1;
-                int rank = 1000;
-                for (int reg : loadedSet)
+                if constexpr (EvictByLiveness)
                 {
-                    if (!((1 << reg) & necessaryRegs) && ranking[reg] < rank)
+                    // values which are going to be overwritten before they're read can
+                    // just be dropped. Otherwise we give up the register which is needed
+                    // again last, preferably one which doesn't have to be written back
+                    int evictReg = -1;
+                    int evictScore = -1;
+                    for (int reg : loadedSet)
                     {
-                        leastReg = reg;
-                        rank = ranking[reg];
+                        if ((1 << reg) & necessaryRegs)
+                            continue;
+
+                        int score;
+                        if (!(instr.LiveRegs & (1 << reg)))
+                            score = InstrsCount * 2 + 1;
+                        else
+                            score = nextUse[reg] * 2 + !(DirtyRegs & (1 << reg));
+
+                        if (score > evictScore)
+                        {
+                            evictReg = reg;
+                            evictScore = score;
+                        }
                     }
+
+                    assert(evictReg != -1);
+                    if (!(instr.LiveRegs & (1 << evictReg)))
+                        DiscardRegister(evictReg);
+                    else
+                        UnloadRegister(evictReg);
                 }
+                else
+                {
+                    int leastReg = -1;
+                    int rank = 1000;
+                    for (int reg : loadedSet)
+                    {
+                        if (!((1 << reg) & necessaryRegs) && ranking[reg] < rank)
+                        {
+                            leastReg = reg;
+                            rank = ranking[reg];
+                        }
+                    }
 
-                assert(leastReg != -1);
-                UnloadRegister(leastReg);
+                    assert(leastReg != -1);
+                    UnloadRegister(leastReg);
+                }
 
                 loadedSet.m_val = LoadedRegs;
             }
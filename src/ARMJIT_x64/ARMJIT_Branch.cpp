@@ -38,6 +38,12 @@ void Compiler::Comp_JumpTo(u32 addr, bool forceNonConstantCycles)
     // we can simplify constant branches by a lot
     IrregularCycles = true;
 
+    if (Exit && (Thumb ? CurInstr.Info.Kind != ARMInstrInfo::tk_BCOND : CurInstr.Cond() >= 0xE))
+    {
+        HasLinkTarget = true;
+        LinkTarget = addr;
+    }
+
     u32 newPC;
     u32 cycles = 0;
 
@@ -52,13 +58,10 @@ void Compiler::Comp_JumpTo(u32 addr, bool forceNonConstantCycles)
         AND(32, R(RCPSR), Imm32(~0x20));
     }
 
+    // this might not run on the emulation thread, so only what was looked up while decoding is used
     if (Num == 0)
     {
-        ARMv5* cpu9 = (ARMv5*)CurCPU;
-
-        u32 regionCodeCycles = cpu9->MemTimings[addr >> 12][0];
-        u32 compileTimeCodeCycles = cpu9->RegionCodeCycles;
-        cpu9->RegionCodeCycles = regionCodeCycles;
+        u32 regionCodeCycles = CurInstr.TargetTimings[0];
 
         if (Exit)
             MOV(32, MDisp(RCPU, offsetof(ARMv5, RegionCodeCycles)), Imm32(regionCodeCycles));
@@ -72,15 +75,12 @@ void Compiler::Comp_JumpTo(u32 addr, bool forceNonConstantCycles)
             // doesn't matter if we put garbage in the MSbs there
             if (addr & 0x2)
             {
-                cpu9->CodeRead32(addr-2, true);
-                cycles += cpu9->CodeCycles;
-                cpu9->CodeRead32(addr+2, false);
-                cycles += CurCPU->CodeCycles;
+                cycles += ARMv5::CodeFetchCycles(addr-2, true, regionCodeCycles, MemControl.ITCMSize);
+                cycles += ARMv5::CodeFetchCycles(addr+2, false, regionCodeCycles, MemControl.ITCMSize);
             }
             else
             {
-                cpu9->CodeRead32(addr, true);
-                cycles += cpu9->CodeCycles;
+                cycles += ARMv5::CodeFetchCycles(addr, true, regionCodeCycles, MemControl.ITCMSize);
             }
         }
         else
@@ -88,24 +88,15 @@ void Compiler::Comp_JumpTo(u32 addr, bool forceNonConstantCycles)
             addr &= ~0x3;
             newPC = addr+4;
 
-            cpu9->CodeRead32(addr, true);
-            cycles += cpu9->CodeCycles;
-            cpu9->CodeRead32(addr+4, false);
-            cycles += cpu9->CodeCycles;
+            cycles += ARMv5::CodeFetchCycles(addr, true, regionCodeCycles, MemControl.ITCMSize);
+            cycles += ARMv5::CodeFetchCycles(addr+4, false, regionCodeCycles, MemControl.ITCMSize);
         }
-
-        cpu9->RegionCodeCycles = compileTimeCodeCycles;
     }
     else
     {
-        ARMv4* cpu7 = (ARMv4*)CurCPU;
-
         u32 codeRegion = addr >> 24;
         u32 codeCycles = addr >> 15; // cheato
 
-        cpu7->CodeRegion = codeRegion;
-        cpu7->CodeCycles = codeCycles;
-
         if (Exit)
         {
             MOV(32, MDisp(RCPU, offsetof(ARM, CodeRegion)), Imm32(codeRegion));
@@ -117,29 +108,15 @@ void Compiler::Comp_JumpTo(u32 addr, bool forceNonConstantCycles)
             addr &= ~0x1;
             newPC = addr+2;
 
-            // this is necessary because ARM7 bios protection
-            u32 compileTimePC = CurCPU->R[15];
-            CurCPU->R[15] = newPC;
-
-            cycles += NDS.ARM7MemTimings[codeCycles][0] + NDS.ARM7MemTimings[codeCycles][1];
-
-            CurCPU->R[15] = compileTimePC;
+            cycles += CurInstr.TargetTimings[0] + CurInstr.TargetTimings[1];
         }
         else
         {
             addr &= ~0x3;
             newPC = addr+4;
 
-            u32 compileTimePC = CurCPU->R[15];
-            CurCPU->R[15] = newPC;
-
-            cycles += NDS.ARM7MemTimings[codeCycles][2] + NDS.ARM7MemTimings[codeCycles][3];
-
-            CurCPU->R[15] = compileTimePC;
+            cycles += CurInstr.TargetTimings[2] + CurInstr.TargetTimings[3];
         }
-
-        cpu7->CodeRegion = R15 >> 24;
-        cpu7->CodeCycles = addr >> 15;
     }
 
     if (Exit)
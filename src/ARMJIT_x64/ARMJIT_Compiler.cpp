@@ -42,7 +42,7 @@ extern "C" void ARM_Ret();
 namespace melonDS
 {
 template <>
-const X64Reg RegisterCache<Compiler, X64Reg>::NativeRegAllocOrder[] =
+const X64Reg RegisterCache<Compiler, X64Reg, true>::NativeRegAllocOrder[] =
 {
 #ifdef _WIN32
     RBX, RSI, RDI, R12, R13, R14, // callee saved
@@ -53,7 +53,7 @@ const X64Reg RegisterCache<Compiler, X64Reg>::NativeRegAllocOrder[] =
 #endif
 };
 template <>
-const int RegisterCache<Compiler, X64Reg>::NativeRegsAvailable =
+const int RegisterCache<Compiler, X64Reg, true>::NativeRegsAvailable =
 #ifdef _WIN32
     8
 #else
@@ -257,6 +257,9 @@ Compiler::Compiler(melonDS::NDS& nds) : XEmitter(), NDS(nds)
         pageAligned = (u8*)mmap(NULL, 1024*1024*32, PROT_READ | PROT_WRITE | PROT_EXEC, MAP_PRIVATE | MAP_ANONYMOUS ,-1, 0);
     #else
         mprotect(pageAligned, alignedSize, PROT_EXEC | PROT_READ | PROT_WRITE);
+        // the blocks jump around a lot, fewer iTLB misses with huge pages.
+        // Before Reset() touches it for the first time
+        ARMJIT_Memory::AdviseHugePages(pageAligned, alignedSize);
     #endif
 
         ResetStart = pageAligned;
@@ -302,7 +305,7 @@ Compiler::Compiler(melonDS::NDS& nds) : XEmitter(), NDS(nds)
         MOV(32, R(RSCRATCH3), MComplex(RCPU, RSCRATCH2, SCALE_4, offsetof(ARM, R_UND)));
         RET();
 
-#ifdef JIT_PROFILING_ENABLED
+#if defined(JIT_PROFILING_ENABLED) || defined(JIT_PERF_MAP_ENABLED)
         CreateMethod("ReadBanked", ReadBanked);
 #endif
     }
@@ -349,7 +352,7 @@ Compiler::Compiler(melonDS::NDS& nds) : XEmitter(), NDS(nds)
         CLC();
         RET();
 
-#ifdef JIT_PROFILING_ENABLED
+#if defined(JIT_PROFILING_ENABLED) || defined(JIT_PERF_MAP_ENABLED)
         CreateMethod("WriteBanked", WriteBanked);
 #endif
     }
@@ -412,7 +415,7 @@ Compiler::Compiler(melonDS::NDS& nds) : XEmitter(), NDS(nds)
                     ABI_PopRegistersAndAdjustStack(CallerSavedPushRegs, 8);
                     RET();
 
-#ifdef JIT_PROFILING_ENABLED
+#if defined(JIT_PROFILING_ENABLED) || defined(JIT_PERF_MAP_ENABLED)
                     CreateMethod("FastMemStorePatch%d_%d_%d", PatchedStoreFuncs[consoleType][num][size][reg], num, size, reg);
 #endif
 
@@ -455,7 +458,7 @@ Compiler::Compiler(melonDS::NDS& nds) : XEmitter(), NDS(nds)
                             MOVZX(32, 8 << size, rdMapped, R(RSCRATCH));
                         RET();
 
-#ifdef JIT_PROFILING_ENABLED
+#if defined(JIT_PROFILING_ENABLED) || defined(JIT_PERF_MAP_ENABLED)
                         CreateMethod("FastMemLoadPatch%d_%d_%d_%d", PatchedLoadFuncs[consoleType][num][size][signextend][reg], num, size, reg, signextend);
 #endif
                     }
@@ -664,6 +667,7 @@ void Compiler::Reset()
     NearCode = NearStart;
     FarCode = FarStart;
 
+    std::lock_guard<std::mutex> lock(LoadStorePatchesLock);
     LoadStorePatches.clear();
 }
 
@@ -672,6 +676,11 @@ bool Compiler::IsJITFault(const u8* addr)
     return (u64)addr >= (u64)ResetStart && (u64)addr < (u64)ResetStart + CodeMemSize;
 }
 
+size_t Compiler::GetHugePageUsage() const
+{
+    return ARMJIT_Memory::GetHugePageBackedSize(ResetStart, CodeMemSize);
+}
+
 void Compiler::Comp_SpecialBranchBehaviour(bool taken)
 {
     if (taken && CurInstr.BranchFlags & branch_IdleBranch)
@@ -688,17 +697,22 @@ void Compiler::Comp_SpecialBranchBehaviour(bool taken)
     }
 }
 
-#ifdef JIT_PROFILING_ENABLED
+#if defined(JIT_PROFILING_ENABLED) || defined(JIT_PERF_MAP_ENABLED)
 void Compiler::CreateMethod(const char* namefmt, void* start, ...)
 {
+    va_list args;
+    va_start(args, start);
+    char name[64];
+    vsnprintf(name, sizeof(name), namefmt, args);
+    va_end(args);
+
+#ifdef JIT_PERF_MAP_ENABLED
+    AddPerfMapSymbol(start, GetWritableCodePtr() - (u8*)start, "%s", name);
+#endif
+
+#ifdef JIT_PROFILING_ENABLED
     if (iJIT_IsProfilingActive())
     {
-        va_list args;
-        va_start(args, start);
-        char name[64];
-        vsprintf(name, namefmt, args);
-        va_end(args);
-
         iJIT_Method_Load method = {0};
         method.method_id = iJIT_GetNewMethodID();
         method.method_name = name;
@@ -707,33 +721,46 @@ void Compiler::CreateMethod(const char* namefmt, void* start, ...)
 
         iJIT_NotifyEvent(iJVM_EVENT_TYPE_METHOD_LOAD_FINISHED, (void*)&method);
     }
+#endif
 }
 #endif
 
-JitBlockEntry Compiler::CompileBlock(ARM* cpu, bool thumb, FetchedInstr instrs[], int instrsCount, bool hasMemoryInstr)
+bool Compiler::IsCodeSpaceLow()
 {
     if (NearSize - (GetCodePtr() - NearStart) < 1024 * 32) // guess...
     {
         Log(LogLevel::Debug, "near reset\n");
-        NDS.JIT.ResetBlockCache();
+        return true;
     }
     if (FarSize - (FarCode - FarStart) < 1024 * 32) // guess...
     {
         Log(LogLevel::Debug, "far reset\n");
-        NDS.JIT.ResetBlockCache();
+        return true;
     }
+    return false;
+}
 
+JitBlockEntry Compiler::CompileBlock(ARM* cpu, bool thumb, FetchedInstr instrs[], int instrsCount, bool hasMemoryInstr,
+    const CompileMemControl& memControl)
+{
     ConstantCycles = 0;
+    HasLinkTarget = false;
     Thumb = thumb;
     Num = cpu->Num;
     CodeRegion = instrs[0].Addr >> 24;
     CurCPU = cpu;
+    MemControl = memControl;
     // CPSR might have been modified in a previous block
     CPSRDirty = false;
 
     JitBlockEntry res = (JitBlockEntry)GetWritableCodePtr();
 
-    RegCache = RegisterCache<Compiler, X64Reg>(this, instrs, instrsCount);
+#ifdef JIT_PERF_MAP_ENABLED
+    MOV(64, R(RSCRATCH), ImmPtr(EntryCounter));
+    ADD(64, MatR(RSCRATCH), Imm8(1));
+#endif
+
+    RegCache = RegisterCache<Compiler, X64Reg, true>(this, instrs, instrsCount);
 
     for (int i = 0; i < instrsCount; i++)
     {
@@ -840,16 +867,48 @@ JitBlockEntry Compiler::CompileBlock(ARM* cpu, bool thumb, FetchedInstr instrs[]
 
         if (comp == NULL)
             LoadCPSR();
+        else if (i == instrsCount - 1 && !CurInstr.Info.Branches())
+        {
+            HasLinkTarget = true;
+            LinkTarget = (R15 - (Thumb ? 2 : 4)) | Thumb;
+        }
     }
 
     RegCache.Flush();
 
     if (ConstantCycles)
         ADD(32, MDisp(RCPU, offsetof(ARM, Cycles)), Imm32(ConstantCycles));
+
+    LinkSite = NULL;
+    if (HasLinkTarget)
+    {
+        // do what the dispatcher would do before it runs the next block,
+        // so we can go there directly as long as there are cycles left
+        CMP(32, MDisp(RCPU, offsetof(ARM, StopExecution)), Imm8(0));
+        FixupBranch stop = J_CC(CC_NZ);
+
+        u64* timestamp = Num == 0 ? &NDS.ARM9Timestamp : &NDS.ARM7Timestamp;
+        u64* target = Num == 0 ? &NDS.ARM9Target : &NDS.ARM7Target;
+        MOV(64, R(RSCRATCH3), ImmPtr(timestamp));
+        MOVSX(64, 32, RSCRATCH, MDisp(RCPU, offsetof(ARM, Cycles)));
+        ADD(64, R(RSCRATCH), MatR(RSCRATCH3));
+        CMP(64, R(RSCRATCH), MDisp(RSCRATCH3, (u8*)target - (u8*)timestamp));
+        FixupBranch outOfCycles = J_CC(CC_AE);
+        MOV(64, MatR(RSCRATCH3), R(RSCRATCH));
+        MOV(32, MDisp(RCPU, offsetof(ARM, Cycles)), Imm32(0));
+
+        // jumps right behind itself until it's linked
+        LinkSite = GetWritableCodePtr();
+        FixupBranch unlinked = J(true);
+        SetJumpTarget(unlinked);
+
+        SetJumpTarget(stop);
+        SetJumpTarget(outOfCycles);
+    }
     JMP((u8*)ARM_Ret, true);
 
-#ifdef JIT_PROFILING_ENABLED
-    CreateMethod("JIT_Block_%d_%d_%08X", (void*)res, Num, Thumb, instrs[0].Addr);
+#if defined(JIT_PROFILING_ENABLED) || defined(JIT_PERF_MAP_ENABLED)
+    CreateMethod("JIT_ARM%d_%s_%08X", (void*)res, Num ? 7 : 9, Thumb ? "Thumb" : "ARM", instrs[0].Addr);
 #endif
 
     /*FILE* codeout = fopen("codeout", "a");
@@ -861,10 +920,17 @@ JitBlockEntry Compiler::CompileBlock(ARM* cpu, bool thumb, FetchedInstr instrs[]
     return res;
 }
 
+void Compiler::PatchLink(void* site, JitBlockEntry entry)
+{
+    u8* jump = (u8*)site;
+    s32 offset = entry ? (s32)((u8*)entry - (jump + 5)) : 0;
+    memcpy(jump + 1, &offset, sizeof(offset));
+}
+
 void Compiler::Comp_AddCycles_C(bool forceNonConstant)
 {
     s32 cycles = Num ?
-        NDS.ARM7MemTimings[CurInstr.CodeCycles][Thumb ? 1 : 3]
+        CurInstr.CodeTimings[Thumb ? 1 : 3]
         : ((R15 & 0x2) ? 0 : CurInstr.CodeCycles);
 
     if ((!Thumb && CurInstr.Cond() < 0xE) || forceNonConstant)
@@ -876,7 +942,7 @@ void Compiler::Comp_AddCycles_C(bool forceNonConstant)
 void Compiler::Comp_AddCycles_CI(u32 i)
 {
     s32 cycles = (Num ?
-        NDS.ARM7MemTimings[CurInstr.CodeCycles][Thumb ? 0 : 2]
+        CurInstr.CodeTimings[Thumb ? 0 : 2]
         : ((R15 & 0x2) ? 0 : CurInstr.CodeCycles)) + i;
 
     if (!Thumb && CurInstr.Cond() < 0xE)
@@ -888,7 +954,7 @@ void Compiler::Comp_AddCycles_CI(u32 i)
 void Compiler::Comp_AddCycles_CI(Gen::X64Reg i, int add)
 {
     s32 cycles = Num ?
-        NDS.ARM7MemTimings[CurInstr.CodeCycles][Thumb ? 0 : 2]
+        CurInstr.CodeTimings[Thumb ? 0 : 2]
         : ((R15 & 0x2) ? 0 : CurInstr.CodeCycles);
 
     if (!Thumb && CurInstr.Cond() < 0xE)
@@ -913,7 +979,7 @@ void Compiler::Comp_AddCycles_CDI()
 
         s32 cycles;
 
-        s32 numC = NDS.ARM7MemTimings[CurInstr.CodeCycles][Thumb ? 0 : 2];
+        s32 numC = CurInstr.CodeTimings[Thumb ? 0 : 2];
         s32 numD = CurInstr.DataCycles;
 
         if ((CurInstr.DataRegion >> 24) == 0x02) // mainRAM
@@ -958,7 +1024,7 @@ void Compiler::Comp_AddCycles_CD()
     }
     else
     {
-        s32 numC = NDS.ARM7MemTimings[CurInstr.CodeCycles][Thumb ? 0 : 2];
+        s32 numC = CurInstr.CodeTimings[Thumb ? 0 : 2];
         s32 numD = CurInstr.DataCycles;
 
         if ((CurInstr.DataRegion >> 4) == 0x02)
@@ -30,6 +30,7 @@
 #include <jitprofiling.h>
 #endif
 
+#include <mutex>
 #include <unordered_map>
 
 
@@ -51,6 +52,8 @@ struct LoadStorePatch
     void* PatchFunc;
     s16 Offset;
     u16 Size;
+    // VRAM might drop it
+    bool ARM9ByteStore;
 };
 
 struct Op2
@@ -87,7 +90,24 @@ public:
 
     void Reset();
 
-    JitBlockEntry CompileBlock(ARM* cpu, bool thumb, FetchedInstr instrs[], int instrsCount, bool hasMemoryInstr);
+    JitBlockEntry CompileBlock(ARM* cpu, bool thumb, FetchedInstr instrs[], int instrsCount, bool hasMemoryInstr,
+        const CompileMemControl& memControl);
+    // no block may be compiled anymore until the block cache is reset
+    bool IsCodeSpaceLow();
+
+    // the exit of the block compiled last which can be patched to jump
+    // into its successor, null if the successor isn't known statically
+    void* GetLinkSite() const { return LinkSite; }
+    // the successor's address, bit 0 set if it's thumb
+    u32 GetLinkTarget() const { return LinkTarget; }
+
+#ifdef JIT_PERF_MAP_ENABLED
+    // the next block counts its entries here
+    u64* EntryCounter {};
+#endif
+
+    // entry NULL patches the exit to return to the dispatcher again
+    void PatchLink(void* site, JitBlockEntry entry);
 
     void LoadReg(int reg, Gen::X64Reg nativeReg);
     void SaveReg(int reg, Gen::X64Reg nativeReg);
@@ -235,10 +255,14 @@ public:
     }
 
     bool IsJITFault(const u8* addr);
+    // how much of the code memory is in huge pages, in bytes
+    size_t GetHugePageUsage() const;
 
     u8* RewriteMemAccess(u8* pc);
+    // whether the fast memory access at pc is a byte store from the ARM9
+    bool IsARM9ByteStore(u8* pc);
 
-#ifdef JIT_PROFILING_ENABLED
+#if defined(JIT_PROFILING_ENABLED) || defined(JIT_PERF_MAP_ENABLED)
     void CreateMethod(const char* namefmt, void* start, ...);
 #endif
 
@@ -254,6 +278,8 @@ public:
     void* PatchedStoreFuncs[2][2][3][16] {};
     void* PatchedLoadFuncs[2][2][3][2][16] {};
 
+    // blocks can be compiled on another thread than the one running them
+    std::mutex LoadStorePatchesLock;
     std::unordered_map<u8*, LoadStorePatch> LoadStorePatches {};
 
     u8* ResetStart {};
@@ -269,7 +295,7 @@ public:
 
     FetchedInstr CurInstr {};
 
-    RegisterCache<Compiler, Gen::X64Reg> RegCache {};
+    RegisterCache<Compiler, Gen::X64Reg, true> RegCache {};
 
     bool Thumb {};
     u32 Num {};
@@ -278,7 +304,12 @@ public:
 
     u32 ConstantCycles {};
 
+    bool HasLinkTarget {};
+    u32 LinkTarget {};
+    void* LinkSite {};
+
     ARM* CurCPU {};
+    CompileMemControl MemControl {};
 };
 
 }
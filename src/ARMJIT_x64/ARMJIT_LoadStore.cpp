@@ -35,6 +35,7 @@ int squeezePointer(T* ptr)
 
 u8* Compiler::RewriteMemAccess(u8* pc)
 {
+    std::lock_guard<std::mutex> lock(LoadStorePatchesLock);
     auto it = LoadStorePatches.find(pc);
     if (it != LoadStorePatches.end())
     {
@@ -57,6 +58,13 @@ u8* Compiler::RewriteMemAccess(u8* pc)
     abort();
 }
 
+bool Compiler::IsARM9ByteStore(u8* pc)
+{
+    std::lock_guard<std::mutex> lock(LoadStorePatchesLock);
+    auto it = LoadStorePatches.find(pc);
+    return it != LoadStorePatches.end() && it->second.ARM9ByteStore;
+}
+
 /*
     According to DeSmuME and my own research, approx. 99% (seriously, that's an empirical number)
     of all memory load and store instructions always access addresses in the same region as
@@ -69,38 +77,30 @@ u8* Compiler::RewriteMemAccess(u8* pc)
 
 bool Compiler::Comp_MemLoadLiteral(int size, bool signExtend, int rd, u32 addr)
 {
-    u32 localAddr = NDS.JIT.LocaliseCodeAddress(Num, addr);
-
-    int invalidLiteralIdx = NDS.JIT.InvalidLiterals.Find(localAddr);
-    if (invalidLiteralIdx != -1)
-    {
+    // the literal was read when the block was decoded, unless
+    // it's known to change or couldn't be tracked
+    if (!CurInstr.HasLiteral)
         return false;
-    }
 
     Comp_AddCycles_CDI();
 
     u32 val;
-    // make sure arm7 bios is accessible
-    u32 tmpR15 = CurCPU->R[15];
-    CurCPU->R[15] = R15;
     if (size == 32)
     {
-        CurCPU->DataRead32(addr & ~0x3, &val);
-        val = melonDS::ROR(val, (addr & 0x3) << 3);
+        val = melonDS::ROR(CurInstr.Literal, (addr & 0x3) << 3);
     }
     else if (size == 16)
     {
-        CurCPU->DataRead16(addr & ~0x1, &val);
+        val = (CurInstr.Literal >> ((addr & 0x2) << 3)) & 0xFFFF;
         if (signExtend)
             val = ((s32)val << 16) >> 16;
     }
     else
     {
-        CurCPU->DataRead8(addr, &val);
+        val = (CurInstr.Literal >> ((addr & 0x3) << 3)) & 0xFF;
         if (signExtend)
             val = ((s32)val << 24) >> 24;
     }
-    CurCPU->R[15] = tmpR15;
 
     MOV(32, MapReg(rd), Imm32(val));
 
@@ -196,11 +196,14 @@ void Compiler::Comp_MemAccess(int rd, int rn, const Op2& op2, int size, int flag
     if ((flags & memop_Writeback) && !(flags & memop_Post))
         MOV(32, rnMapped, R(finalAddr));
 
-    u32 expectedTarget = Num == 0
-        ? NDS.JIT.Memory.ClassifyAddress9(CurInstr.DataRegion)
-        : NDS.JIT.Memory.ClassifyAddress7(CurInstr.DataRegion);
+    u32 expectedTarget = CurInstr.DataMemRegion;
+
+    // the ARM9 ignores byte writes to VRAM, unless the DSi's SCFG_EXT allows them.
+    // Fast memory would let them through
+    bool ignoredStore = Num == 0 && size == 8 && (flags & memop_Store)
+        && expectedTarget == ARMJIT_Memory::memregion_VRAM && !(MemControl.SCFGExt9 & (1<<13));
 
-    if (NDS.JIT.FastMemoryEnabled() && ((!Thumb && CurInstr.Cond() != 0xE) || NDS.JIT.Memory.IsFastmemCompatible(expectedTarget)))
+    if (NDS.JIT.FastMemoryEnabled() && !ignoredStore && ((!Thumb && CurInstr.Cond() != 0xE) || NDS.JIT.Memory.IsFastmemCompatible(expectedTarget)))
     {
         if (rdMapped.IsImm())
         {
@@ -217,6 +220,7 @@ void Compiler::Comp_MemAccess(int rd, int rn, const Op2& op2, int size, int flag
             : PatchedLoadFuncs[NDS.ConsoleType][Num][__builtin_ctz(size) - 3][!!(flags & memop_SignExtend)][rdMapped.GetSimpleReg()];
 
         assert(patch.PatchFunc != NULL);
+        patch.ARM9ByteStore = Num == 0 && size == 8 && (flags & memop_Store);
 
         MOV(64, R(RSCRATCH), ImmPtr(Num == 0 ? NDS.JIT.Memory.FastMem9Start : NDS.JIT.Memory.FastMem7Start));
 
@@ -228,10 +232,24 @@ void Compiler::Comp_MemAccess(int rd, int rn, const Op2& op2, int size, int flag
             AND(32, R(RSCRATCH2), Imm8(addressMask));
         }
 
+        // with VRAM in fast memory the ARM9's byte stores could land
+        // there without faulting, they have to be dropped here
+        bool dropVRAMStore = patch.ARM9ByteStore && NDS.JIT.FastVRAMEnabled() && !(MemControl.SCFGExt9 & (1<<13));
+        FixupBranch skipVRAMStore;
+        if (dropVRAMStore)
+        {
+            MOV(32, R(RSCRATCH2), R(RSCRATCH3));
+            SHR(32, R(RSCRATCH2), Imm8(24));
+            CMP(32, R(RSCRATCH2), Imm8(0x06));
+            skipVRAMStore = J_CC(CC_E);
+        }
+
         u8* memopLoadStoreLocation = GetWritableCodePtr();
         if (flags & memop_Store)
         {
             MOV(size, MRegSum(RSCRATCH, maskedAddr), rdMapped);
+            if (dropVRAMStore)
+                SetJumpTarget(skipVRAMStore);
         }
         else
         {
@@ -261,6 +279,7 @@ void Compiler::Comp_MemAccess(int rd, int rn, const Op2& op2, int size, int flag
 
         assert(patch.Size >= 5);
 
+        std::lock_guard<std::mutex> lock(LoadStorePatchesLock);
         LoadStorePatches[memopLoadStoreLocation] = patch;
     }
     else
@@ -269,7 +288,7 @@ void Compiler::Comp_MemAccess(int rd, int rn, const Op2& op2, int size, int flag
 
         void* func = NULL;
         if (addrIsStatic)
-            func = NDS.JIT.Memory.GetFuncForAddr(CurCPU, staticAddress, flags & memop_Store, size);
+            func = NDS.JIT.Memory.GetFuncForAddr(CurCPU, staticAddress, flags & memop_Store, size, MemControl.ExMemCnt9);
 
         if (func)
         {
@@ -422,9 +441,7 @@ s32 Compiler::Comp_MemAccessBlock(int rn, BitSet16 regs, bool store, bool preinc
 
     s32 offset = (regsCount * 4) * (decrement ? -1 : 1);
 
-    int expectedTarget = Num == 0
-        ? NDS.JIT.Memory.ClassifyAddress9(CurInstr.DataRegion)
-        : NDS.JIT.Memory.ClassifyAddress7(CurInstr.DataRegion);
+    int expectedTarget = CurInstr.DataMemRegion;
 
     if (!store)
         Comp_AddCycles_CDI();
@@ -499,9 +516,11 @@ s32 Compiler::Comp_MemAccessBlock(int rn, BitSet16 regs, bool store, bool preinc
 
         LoadStorePatch patch;
         patch.Size = GetWritableCodePtr() - fastPathStart;
+        patch.ARM9ByteStore = false;
         SwitchToFarCode();
         patch.PatchFunc = GetWritableCodePtr();
 
+        std::lock_guard<std::mutex> lock(LoadStorePatchesLock);
         for (i = 0; i < regsCount; i++)
         {
             patch.Offset = fastPathStart - loadStoreAddr[i];
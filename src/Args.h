@@ -67,6 +67,29 @@ struct JITArgs
     /// Enabled by default, but frontends should disable this when debugging
     /// so the constants segfaults don't hinder debugging.
     bool FastMemory = true;
+
+    /// Compiles blocks on a separate thread instead of in the middle of emulation.
+    /// Until a block is done it keeps being interpreted, finished blocks
+    /// are put in place at the start of the next frame.
+    /// How long a block stays interpreted depends on what ran before,
+    /// so run-ahead and rewinding won't reproduce a run exactly with this.
+    /// Only has an effect with the x64 JIT.
+    /// Disabled by default.
+    bool BackgroundCompile = false;
+
+    /// How often code is interpreted before it's compiled,
+    /// so code that only runs a few times doesn't take up the code cache.
+    /// The counts start over whenever a snapshot is loaded. Code that was compiled
+    /// before stays compiled though, so run-ahead and rewinding can still time
+    /// interpreted code differently than the first time.
+    /// 0 by default, everything is compiled the first time it runs.
+    unsigned CompileThreshold = 0;
+
+    /// Lets fast memory accesses reach VRAM too, the pages are write-protected
+    /// so the first write to one after its dirty flags were cleared still marks it.
+    /// Only has an effect with FastMemory, and not on Windows, the Switch or ARM64.
+    /// Disabled by default.
+    bool FastVRAM = false;
 };
 
 struct GDBArgs
@@ -124,6 +147,13 @@ struct NDSArgs
     /// Defaults to the software renderer.
     /// Can be changed later at any time.
     std::unique_ptr<melonDS::Renderer3D> Renderer3D = std::make_unique<SoftRenderer>();
+
+    /// Lets the interpreter skip to the next event when it runs into a loop
+    /// that only waits for something to happen, like the JIT's branch optimizations do.
+    /// Interpreted code then isn't timed exactly like before.
+    /// Can be changed later at any time.
+    /// Enabled by default.
+    bool IdleLoopSkipping = true;
 };
 
 /// Arguments to pass into the DSi constructor.
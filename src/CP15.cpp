@@ -81,8 +81,20 @@ void ARMv5::CP15DoSavestate(Savestate* file)
     file->Var32(&DTCMSetting);
     file->Var32(&ITCMSetting);
 
-    file->VarArray(ITCM, ITCMPhysicalSize);
-    file->VarArray(DTCM, DTCMPhysicalSize);
+    // writes to the TCMs aren't tracked, snapshots compare them
+    Savestate::PageLoadCallback onLoadITCM;
+#ifdef JIT_ENABLED
+    if (!file->Saving && NDS.IsInSnapshot())
+    {
+        onLoadITCM = [this](u32 offset, const u8* incoming, u32 len)
+        {
+            NDS.JIT.InvalidateChangedCode(ARMJIT_Memory::memregion_ITCM, offset, &ITCM[offset], incoming, len);
+        };
+    }
+#endif
+
+    file->PagedArray(ITCM, ITCMPhysicalSize, nullptr, onLoadITCM);
+    file->PagedArray(DTCM, DTCMPhysicalSize);
 
     file->Var32(&PU_CodeCacheable);
     file->Var32(&PU_DataCacheable);
@@ -97,7 +109,8 @@ void ARMv5::CP15DoSavestate(Savestate* file)
     {
         UpdateDTCMSetting();
         UpdateITCMSetting();
-        UpdatePURegions(true);
+        if (!NDS.SnapshotKeepsMemTimings())
+            UpdatePURegions(true);
     }
 }
 
@@ -137,6 +150,7 @@ void ARMv5::UpdateITCMSetting()
         ITCMSize = 0x200 << ((ITCMSetting >> 1) & 0x1F);
 #ifdef JIT_ENABLED
         FastBlockLookupSize = 0;
+        NDS.JIT.UnlinkBlocks();
 #endif
     }
     else
@@ -292,6 +306,8 @@ void ARMv5::UpdatePURegions(bool update_all)
 
 void ARMv5::UpdateRegionTimings(u32 addrstart, u32 addrend)
 {
+    NDS.MemTimingsVersion++;
+
     for (u32 i = addrstart; i < addrend; i++)
     {
         u8 pu = PU_Map[i];
@@ -802,6 +818,17 @@ u32 ARMv5::CodeRead32(u32 addr, bool branch)
     return BusRead32(addr);
 }
 
+u32 ARMv5::CodeFetchCycles(u32 addr, bool branch, u32 regionCodeCycles, u32 itcmSize)
+{
+    if (addr < itcmSize)
+        return 1;
+
+    if (regionCodeCycles == 0xFF)
+        return (branch || !(addr & 0x1F)) ? kCodeCacheTiming : 1;
+
+    return regionCodeCycles;
+}
+
 
 void ARMv5::DataRead8(u32 addr, u32* val)
 {
@@ -549,6 +549,77 @@ u32 DMA::UnitTimings7_32(bool burststart)
     }
 }
 
+// copies between the pages of plain memory the source and destination are in, for
+// as long as both stay in them, without going through the bus. the timings are still
+// added up unit by unit, the main RAM bursts make them vary from one unit to the next.
+// returns false if the current unit has to be copied the regular way
+template <u32 num, typename T>
+bool DMA::RunPlain(bool& burststart)
+{
+    u8* src = (num == 0) ? NDS.GetARM9ReadPage(CurSrcAddr) : NDS.GetARM7ReadPage(CurSrcAddr);
+    if (!src) return false;
+
+    // main RAM, or VRAM where only one bank is mapped, those can be written as they're read
+    u8* dst;
+    u32 vramBank = 0;
+    bool mainRAM = false;
+    switch (CurDstAddr & 0xFF000000)
+    {
+    case 0x02000000:
+        dst = &NDS.MainRAM[CurDstAddr & NDS.MainRAMMask & ~0x3FFF];
+        mainRAM = true;
+        break;
+
+    case 0x06000000:
+        dst = (num == 0) ? NDS.GetARM9ReadPage(CurDstAddr) : NDS.GetARM7ReadPage(CurDstAddr);
+        if (!dst) return false;
+        vramBank = NDS.GPU.GetVRAMBank(dst);
+        if (vramBank == ~0u) return false;
+        break;
+
+    default:
+        return false;
+    }
+
+    u64& timestamp = (num == 0) ? NDS.ARM9Timestamp : NDS.ARM7Timestamp;
+    u64 target = (num == 0) ? NDS.ARM9Target : NDS.ARM7Target;
+    u32 srcPage = CurSrcAddr >> 14;
+    u32 dstPage = CurDstAddr >> 14;
+
+    do
+    {
+        if (num == 0)
+            timestamp += ((sizeof(T) == 2 ? UnitTimings9_16(burststart) : UnitTimings9_32(burststart)) << NDS.ARM9ClockShift);
+        else
+            timestamp += (sizeof(T) == 2 ? UnitTimings7_16(burststart) : UnitTimings7_32(burststart));
+        burststart = false;
+
+        u32 dstAddr = CurDstAddr & ~(sizeof(T)-1);
+        u32 offset = dstAddr & 0x3FFF;
+        if (mainRAM)
+        {
+            NDS.JIT.CheckAndInvalidate<num, ARMJIT_Memory::memregion_MainRAM>(dstAddr);
+            *(T*)&dst[offset] = *(T*)&src[CurSrcAddr & (0x3FFF & ~(sizeof(T)-1))];
+            NDS.MarkMainRAMDirty(dstAddr);
+        }
+        else
+        {
+            NDS.JIT.CheckAndInvalidate<num, (num == 0) ? ARMJIT_Memory::memregion_VRAM : ARMJIT_Memory::memregion_VWRAM>(dstAddr);
+            *(T*)&dst[offset] = *(T*)&src[CurSrcAddr & (0x3FFF & ~(sizeof(T)-1))];
+            NDS.GPU.MarkVRAMDirty(vramBank, (dst - NDS.GPU.VRAM[vramBank]) + offset);
+        }
+
+        CurSrcAddr += SrcAddrInc * (s32)sizeof(T);
+        CurDstAddr += DstAddrInc * (s32)sizeof(T);
+        IterCount--;
+        RemCount--;
+    }
+    while (IterCount > 0 && timestamp < target
+           && (CurSrcAddr >> 14) == srcPage && (CurDstAddr >> 14) == dstPage);
+
+    return true;
+}
+
 void DMA::Run9()
 {
     if (NDS.ARM9Timestamp >= NDS.ARM9Target) return;
@@ -563,6 +634,12 @@ void DMA::Run9()
     {
         while (IterCount > 0 && !Stall)
         {
+            if (RunPlain<0, u16>(burststart))
+            {
+                if (NDS.ARM9Timestamp >= NDS.ARM9Target) break;
+                continue;
+            }
+
             NDS.ARM9Timestamp += (UnitTimings9_16(burststart) << NDS.ARM9ClockShift);
             burststart = false;
 
@@ -580,6 +657,12 @@ void DMA::Run9()
     {
         while (IterCount > 0 && !Stall)
         {
+            if (RunPlain<0, u32>(burststart))
+            {
+                if (NDS.ARM9Timestamp >= NDS.ARM9Target) break;
+                continue;
+            }
+
             NDS.ARM9Timestamp += (UnitTimings9_32(burststart) << NDS.ARM9ClockShift);
             burststart = false;
 
@@ -636,6 +719,12 @@ void DMA::Run7()
     {
         while (IterCount > 0 && !Stall)
         {
+            if (RunPlain<1, u16>(burststart))
+            {
+                if (NDS.ARM7Timestamp >= NDS.ARM7Target) break;
+                continue;
+            }
+
             NDS.ARM7Timestamp += UnitTimings7_16(burststart);
             burststart = false;
 
@@ -653,6 +742,12 @@ void DMA::Run7()
     {
         while (IterCount > 0 && !Stall)
         {
+            if (RunPlain<1, u32>(burststart))
+            {
+                if (NDS.ARM7Timestamp >= NDS.ARM7Target) break;
+                continue;
+            }
+
             NDS.ARM7Timestamp += UnitTimings7_32(burststart);
             burststart = false;
 
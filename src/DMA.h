@@ -49,6 +49,9 @@ public:
     void Run9();
     void Run7();
 
+    template <u32 num, typename T>
+    bool RunPlain(bool& burststart);
+
     bool IsInMode(u32 mode) const noexcept
     {
         return ((mode == StartMode) && (Cnt & 0x80000000));
@@ -1249,6 +1249,9 @@ void DSi::ApplyNewRAMSize(u32 size)
         Log(LogLevel::Debug, "RAM: 16MB\n");
         break;
     }
+
+    UpdateReadMap(0x02000000, 0x03000000);
+    UpdateReadMap(0x0C000000, 0x0D000000);
 }
 
 
@@ -1529,6 +1532,7 @@ void DSi::ARM9Write8(u32 addr, u8 val)
     case 0x0C000000:
         JIT.CheckAndInvalidate<0, ARMJIT_Memory::memregion_MainRAM>(addr);
         *(u8*)&MainRAM[addr & MainRAMMask] = val;
+        MarkMainRAMDirty(addr);
         return;
     }
 
@@ -1614,6 +1618,7 @@ void DSi::ARM9Write16(u32 addr, u16 val)
     case 0x0C000000:
         JIT.CheckAndInvalidate<0, ARMJIT_Memory::memregion_MainRAM>(addr);
         *(u16*)&MainRAM[addr & MainRAMMask] = val;
+        MarkMainRAMDirty(addr);
         return;
     }
 
@@ -1699,6 +1704,7 @@ void DSi::ARM9Write32(u32 addr, u32 val)
     case 0x0C000000:
         JIT.CheckAndInvalidate<0, ARMJIT_Memory::memregion_MainRAM>(addr);
         *(u32*)&MainRAM[addr & MainRAMMask] = val;
+        MarkMainRAMDirty(addr);
         return;
     }
 
@@ -2002,6 +2008,7 @@ void DSi::ARM7Write8(u32 addr, u8 val)
     case 0x0C800000:
         JIT.CheckAndInvalidate<1, ARMJIT_Memory::memregion_MainRAM>(addr);
         *(u8*)&NDS::MainRAM[addr & NDS::MainRAMMask] = val;
+        MarkMainRAMDirty(addr);
         return;
     }
 
@@ -2092,6 +2099,7 @@ void DSi::ARM7Write16(u32 addr, u16 val)
     case 0x0C800000:
         JIT.CheckAndInvalidate<1, ARMJIT_Memory::memregion_MainRAM>(addr);
         *(u16*)&NDS::MainRAM[addr & NDS::MainRAMMask] = val;
+        MarkMainRAMDirty(addr);
         return;
     }
 
@@ -2182,6 +2190,7 @@ void DSi::ARM7Write32(u32 addr, u32 val)
     case 0x0C800000:
         JIT.CheckAndInvalidate<1, ARMJIT_Memory::memregion_MainRAM>(addr);
         *(u32*)&NDS::MainRAM[addr & NDS::MainRAMMask] = val;
+        MarkMainRAMDirty(addr);
         return;
     }
 
@@ -2217,6 +2226,43 @@ bool DSi::ARM7GetMemRegion(u32 addr, bool write, MemRegion* region)
     return false;
 }
 
+u8* DSi::LookupARM9ReadPage(u32 addr)
+{
+    switch (addr & 0xFF000000)
+    {
+    case 0x02000000:
+        // keep the region locking hack in ARM9Read32()
+        if ((addr & 0xFFFFC000) == (0x02FE71B0 & 0xFFFFC000))
+            return NULL;
+        break;
+
+    case 0x03000000:
+        // NWRAM is mapped in 32K/64K slots over a window, not worth it
+        return NULL;
+
+    case 0x0C000000:
+        return &MainRAM[addr & MainRAMMask];
+    }
+
+    return NDS::LookupARM9ReadPage(addr);
+}
+
+u8* DSi::LookupARM7ReadPage(u32 addr)
+{
+    switch (addr & 0xFF800000)
+    {
+    case 0x03000000:
+    case 0x03800000:
+        return NULL;
+
+    case 0x0C000000:
+    case 0x0C800000:
+        return &MainRAM[addr & MainRAMMask];
+    }
+
+    return NDS::LookupARM7ReadPage(addr);
+}
+
 
 
 
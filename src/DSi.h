@@ -115,6 +115,9 @@ public:
 
     bool ARM7GetMemRegion(u32 addr, bool write, MemRegion* region) override;
 
+    u8* LookupARM9ReadPage(u32 addr) override;
+    u8* LookupARM7ReadPage(u32 addr) override;
+
     u8 ARM9IORead8(u32 addr) override;
     u16 ARM9IORead16(u32 addr) override;
     u32 ARM9IORead32(u32 addr) override;
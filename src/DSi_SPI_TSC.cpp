@@ -121,6 +121,18 @@ void DSi_TSC::SetTouchCoords(u16 x, u16 y)
     }
 }
 
+bool DSi_TSC::GetTouchCoords(u16& x, u16& y) const
+{
+    if (TSCMode == 0x00) return TSC::GetTouchCoords(x, y);
+
+    if (Bank3Regs[0x0E] & 0x01)
+        return false;
+
+    x = (TouchX & 0x7FFF) >> 4;
+    y = (TouchY & 0x7FFF) >> 4;
+    return true;
+}
+
 void DSi_TSC::MicInputFrame(const s16* data, int samples)
 {
     if (TSCMode == 0x00) return TSC::MicInputFrame(data, samples);
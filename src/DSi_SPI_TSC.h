@@ -40,6 +40,7 @@ public:
     void SetMode(u8 mode);
 
     void SetTouchCoords(u16 x, u16 y) override;
+    bool GetTouchCoords(u16& x, u16& y) const override;
     void MicInputFrame(const s16* data, int samples) override;
 
     void Write(u8 val) override;
@@ -0,0 +1,164 @@
+/*
+    Copyright 2016-2023 melonDS team
+
+    This file is part of melonDS.
+
+    melonDS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS. If not, see http://www.gnu.org/licenses/.
+*/
+
+#ifndef MELONDS_FLATHASHMAP_H
+#define MELONDS_FLATHASHMAP_H
+
+#include <assert.h>
+#include <memory>
+#include "types.h"
+
+namespace melonDS
+{
+/*
+    FlatHashMap
+        - a hash map from u32 to small POD values, all in one array
+
+    - open addressing with linear probing, lookups touch one or two cache lines
+    - removing shifts the entries after it back, so there are no tombstones
+    - grows when it's half full, never shrinks
+    - not stl conformant either, iterate with ForEach
+*/
+template<typename V>
+class FlatHashMap
+{
+public:
+    V* Find(u32 key)
+    {
+        if (Count == 0)
+            return nullptr;
+
+        for (u32 i = Hash(key);; i = (i + 1) & Mask)
+        {
+            if (!Slots[i].Used)
+                return nullptr;
+            if (Slots[i].Key == key)
+                return &Slots[i].Value;
+        }
+    }
+
+    // replaces the value if the key is already there
+    void Insert(u32 key, V value)
+    {
+        if ((Count + 1) * 2 > Mask + 1)
+            Grow();
+
+        u32 i = Hash(key);
+        while (Slots[i].Used && Slots[i].Key != key)
+            i = (i + 1) & Mask;
+
+        if (!Slots[i].Used)
+        {
+            Slots[i].Used = true;
+            Slots[i].Key = key;
+            Count++;
+        }
+        Slots[i].Value = value;
+    }
+
+    bool Remove(u32 key)
+    {
+        if (Count == 0)
+            return false;
+
+        u32 i = Hash(key);
+        while (Slots[i].Key != key || !Slots[i].Used)
+        {
+            if (!Slots[i].Used)
+                return false;
+            i = (i + 1) & Mask;
+        }
+
+        // move the entries which probed past this slot back into it
+        for (u32 j = (i + 1) & Mask; Slots[j].Used; j = (j + 1) & Mask)
+        {
+            u32 home = Hash(Slots[j].Key);
+            if (((j - home) & Mask) >= ((j - i) & Mask))
+            {
+                Slots[i] = Slots[j];
+                i = j;
+            }
+        }
+        Slots[i].Used = false;
+        Count--;
+        return true;
+    }
+
+    void Clear()
+    {
+        if (Slots)
+        {
+            for (u32 i = 0; i <= Mask; i++)
+                Slots[i].Used = false;
+        }
+        Count = 0;
+    }
+
+    u32 Size() const { return Count; }
+
+    // func(key, value), the map mustn't be modified in the meantime
+    template <typename F>
+    void ForEach(F&& func)
+    {
+        for (u32 i = 0; Count && i <= Mask; i++)
+        {
+            if (Slots[i].Used)
+                func(Slots[i].Key, Slots[i].Value);
+        }
+    }
+
+private:
+    struct Slot
+    {
+        u32 Key;
+        bool Used;
+        V Value;
+    };
+
+    u32 Hash(u32 key) const
+    {
+        // keys are mostly addresses, the low bits aren't random enough on their own
+        return (key * 0x9E3779B1) >> Shift;
+    }
+
+    void Grow()
+    {
+        u32 oldSize = Slots ? Mask + 1 : 0;
+        std::unique_ptr<Slot[]> oldSlots = std::move(Slots);
+
+        u32 size = oldSize ? oldSize * 2 : 256;
+        Slots = std::make_unique<Slot[]>(size);
+        Mask = size - 1;
+        Shift = 32 - __builtin_ctz(size);
+        Count = 0;
+
+        for (u32 i = 0; i < oldSize; i++)
+        {
+            if (oldSlots[i].Used)
+                Insert(oldSlots[i].Key, oldSlots[i].Value);
+        }
+    }
+
+    std::unique_ptr<Slot[]> Slots;
+    u32 Mask = 0;
+    u32 Shift = 32;
+    u32 Count = 0;
+};
+}
+
+#endif // MELONDS_FLATHASHMAP_H
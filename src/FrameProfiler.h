@@ -0,0 +1,291 @@
+/*
+    Copyright 2016-2023 melonDS team
+
+    This file is part of melonDS.
+
+    melonDS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS. If not, see http://www.gnu.org/licenses/.
+*/
+
+#ifndef FRAMEPROFILER_H
+#define FRAMEPROFILER_H
+
+#include <chrono>
+#include <string.h>
+
+#if defined(_MSC_VER) && defined(_M_X64)
+#include <intrin.h>
+#elif defined(__x86_64__)
+#include <x86intrin.h>
+#endif
+
+#include "types.h"
+
+namespace melonDS
+{
+
+enum ProfSection
+{
+    Prof_None = 0,  // outside of NDS::RunFrame(), not counted
+    Prof_ARM9,
+    Prof_ARM7,
+    Prof_GPU3D,     // geometry engine and 3D rendering
+    Prof_GPU2D,     // scanline drawing
+    Prof_SPU,
+    Prof_Scheduler, // RunSystem() and the events it runs that aren't counted elsewhere
+    Prof_DMA,
+    Prof_Misc,      // timers, sleep mode...
+
+    Prof_MAX
+};
+
+// as many as the scheduler's event mask can hold
+constexpr u32 kProfMaxEvents = 32;
+
+/// What one frame (or everything since FrameProfiler::Reset()) cost. Times are in nanoseconds.
+struct FrameStats
+{
+    u64 Time[Prof_MAX];
+    u64 TotalTime;
+
+    // per scheduler event, how often its handler ran and how long it took,
+    // including the time attributed to other sections meanwhile
+    u32 EventCount[kProfMaxEvents];
+    u64 EventTime[kProfMaxEvents];
+
+    // emulated 33 MHz cycles, and how many of them the ARM9 spent waiting for the GX FIFO
+    u64 Cycles;
+    u64 GXStallCycles;
+};
+
+/// Splits the host time spent in NDS::RunFrame() between the emulated subsystems.
+///
+/// Time is attributed exclusively: entering a section stops the clock of the one
+/// that was running, so e.g. 2D drawing done from a scheduler event isn't also
+/// counted as scheduler time.
+///
+/// The scheduler events are also counted and timed, and the cycles the ARM9
+/// stalled on a full GX FIFO accumulated, to tell a game that's bound by the
+/// 3D engine on the console from one that's slow to emulate.
+///
+/// Disabled by default, in which case all it costs is a branch per section switch
+/// and scheduler event.
+class FrameProfiler
+{
+public:
+    FrameProfiler() noexcept { Reset(); }
+
+    void SetEnabled(bool enable) noexcept
+    {
+        if (enable && !Enabled)
+            memset(&Frame, 0, sizeof(Frame));
+
+        Enabled = enable;
+        Current = Prof_None;
+    }
+    [[nodiscard]] bool IsEnabled() const noexcept { return Enabled; }
+
+    void Reset() noexcept
+    {
+        memset(&Frame, 0, sizeof(Frame));
+        memset(&Totals, 0, sizeof(Totals));
+        memset(&LastFrame, 0, sizeof(LastFrame));
+        Current = Prof_None;
+        LastSwitch = 0;
+
+        StartNanos = NowNanos();
+        StartTicks = NowTicks();
+    }
+
+    /// Starts attributing time to the given section.
+    /// @returns The section that was running until now, to be passed to Leave().
+    ProfSection Enter(ProfSection section) noexcept
+    {
+        if (!Enabled) return section;
+
+        u64 now = NowTicks();
+        if (Current != Prof_None)
+            Frame.Time[Current] += now - LastSwitch;
+        LastSwitch = now;
+
+        ProfSection prev = Current;
+        Current = section;
+        return prev;
+    }
+
+    void Leave(ProfSection prev) noexcept { Enter(prev); }
+
+    /// Call before running the handler of a scheduler event.
+    /// @returns What to pass to EventDone() afterwards.
+    u64 EventStart() noexcept
+    {
+        return Enabled ? NowTicks() : 0;
+    }
+
+    void EventDone(u32 id, u64 start) noexcept
+    {
+        if (!Enabled) return;
+
+        Frame.EventTime[id] += NowTicks() - start;
+        Frame.EventCount[id]++;
+    }
+
+    void AddGXStall(u64 cycles) noexcept
+    {
+        if (Enabled) Frame.GXStallCycles += cycles;
+    }
+
+    /// Publishes the stats of the frame that just ran, see GetLastFrame().
+    /// @param cycles How long the frame was, in 33 MHz cycles.
+    void EndFrame(u64 cycles) noexcept
+    {
+        if (!Enabled) return;
+
+        // whatever runs until the next section switch goes to the next frame
+        u64 now = NowTicks();
+        if (Current != Prof_None)
+            Frame.Time[Current] += now - LastSwitch;
+        LastSwitch = now;
+
+        Frame.Cycles = cycles;
+
+        Add(Totals, Frame);
+        LastFrame = ToNanos(Frame);
+        memset(&Frame, 0, sizeof(Frame));
+    }
+
+    /// @returns The stats of the last frame that ran while enabled.
+    [[nodiscard]] const FrameStats& GetLastFrame() const noexcept { return LastFrame; }
+
+    /// @returns The stats of all the frames since the last Reset().
+    [[nodiscard]] FrameStats GetTotals() const noexcept { return ToNanos(Totals); }
+
+    /// @returns The time spent in the given section since the last Reset(), in nanoseconds.
+    [[nodiscard]] u64 GetTime(ProfSection section) const noexcept
+    {
+        return (u64)((Totals.Time[section] + Frame.Time[section]) * NanosPerTick());
+    }
+
+    [[nodiscard]] u64 GetTotalTime() const noexcept
+    {
+        u64 total = 0;
+        for (int i = 0; i < Prof_MAX; i++)
+            total += Totals.Time[i] + Frame.Time[i];
+        return (u64)(total * NanosPerTick());
+    }
+
+    static const char* GetSectionName(ProfSection section) noexcept
+    {
+        switch (section)
+        {
+            case Prof_ARM9: return "ARM9";
+            case Prof_ARM7: return "ARM7";
+            case Prof_GPU3D: return "GPU3D";
+            case Prof_GPU2D: return "GPU2D";
+            case Prof_SPU: return "SPU";
+            case Prof_Scheduler: return "Scheduler";
+            case Prof_DMA: return "DMA";
+            case Prof_Misc: return "Misc";
+            default: return "None";
+        }
+    }
+
+private:
+    static u64 NowNanos() noexcept
+    {
+        using namespace std::chrono;
+        return duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+    }
+
+    // section switches happen several times per scheduler iteration,
+    // so use the TSC where we have it, the OS clock is too slow for this
+    static u64 NowTicks() noexcept
+    {
+#if defined(__x86_64__) || defined(_M_X64)
+        return __rdtsc();
+#else
+        return NowNanos();
+#endif
+    }
+
+    // calibrated over the time since the last Reset()
+    double NanosPerTick() const noexcept
+    {
+        u64 ticks = NowTicks() - StartTicks;
+        if (ticks == 0) return 1.0;
+        return (double)(NowNanos() - StartNanos) / ticks;
+    }
+
+    static void Add(FrameStats& dst, const FrameStats& src) noexcept
+    {
+        for (int i = 0; i < Prof_MAX; i++)
+            dst.Time[i] += src.Time[i];
+        for (u32 i = 0; i < kProfMaxEvents; i++)
+        {
+            dst.EventCount[i] += src.EventCount[i];
+            dst.EventTime[i] += src.EventTime[i];
+        }
+        dst.Cycles += src.Cycles;
+        dst.GXStallCycles += src.GXStallCycles;
+    }
+
+    FrameStats ToNanos(const FrameStats& ticks) const noexcept
+    {
+        double scale = NanosPerTick();
+        FrameStats ret = ticks;
+
+        ret.TotalTime = 0;
+        for (int i = 0; i < Prof_MAX; i++)
+        {
+            ret.Time[i] = (u64)(ticks.Time[i] * scale);
+            ret.TotalTime += ret.Time[i];
+        }
+        for (u32 i = 0; i < kProfMaxEvents; i++)
+            ret.EventTime[i] = (u64)(ticks.EventTime[i] * scale);
+
+        return ret;
+    }
+
+    bool Enabled = false;
+    ProfSection Current;
+    u64 LastSwitch;
+
+    // times in ticks, TotalTime unused
+    FrameStats Frame;  // the frame that's running
+    FrameStats Totals; // the ones before it, since the last Reset()
+
+    FrameStats LastFrame;
+
+    u64 StartNanos;
+    u64 StartTicks;
+};
+
+/// Attributes the time until the end of the scope to the given section.
+class ProfileScope
+{
+public:
+    ProfileScope(FrameProfiler& profiler, ProfSection section) noexcept :
+        Profiler(profiler), Prev(profiler.Enter(section))
+    {}
+    ~ProfileScope() noexcept { Profiler.Leave(Prev); }
+
+    ProfileScope(const ProfileScope&) = delete;
+    ProfileScope& operator=(const ProfileScope&) = delete;
+
+private:
+    FrameProfiler& Profiler;
+    ProfSection Prev;
+};
+
+}
+
+#endif // FRAMEPROFILER_H
@@ -150,7 +150,7 @@ void CartGame::DoSavestate(Savestate* file)
     if (SRAMLength)
     {
         // fill save memory if data is present
-        file->VarArray(SRAM.get(), SRAMLength);
+        file->PagedArray(SRAM.get(), SRAMLength);
     }
     else
     {
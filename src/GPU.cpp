@@ -63,8 +63,21 @@ enum
                 VRAMDirty need to be reset for the respective VRAM bank.
 */
 
+// where each bank starts in the LCDC mapping, they follow each other
+// there. That's also how they're laid out in memory
+static constexpr u32 VRAMLCDCBase[9] = {0x00000, 0x20000, 0x40000, 0x60000, 0x80000, 0x90000, 0x94000, 0x98000, 0xA0000};
+
 GPU::GPU(melonDS::NDS& nds, std::unique_ptr<Renderer3D>&& renderer3d, std::unique_ptr<GPU2D::Renderer2D>&& renderer2d) noexcept :
     NDS(nds),
+    VRAM_A(nds.JIT.Memory.GetVRAM() + VRAMLCDCBase[0]),
+    VRAM_B(nds.JIT.Memory.GetVRAM() + VRAMLCDCBase[1]),
+    VRAM_C(nds.JIT.Memory.GetVRAM() + VRAMLCDCBase[2]),
+    VRAM_D(nds.JIT.Memory.GetVRAM() + VRAMLCDCBase[3]),
+    VRAM_E(nds.JIT.Memory.GetVRAM() + VRAMLCDCBase[4]),
+    VRAM_F(nds.JIT.Memory.GetVRAM() + VRAMLCDCBase[5]),
+    VRAM_G(nds.JIT.Memory.GetVRAM() + VRAMLCDCBase[6]),
+    VRAM_H(nds.JIT.Memory.GetVRAM() + VRAMLCDCBase[7]),
+    VRAM_I(nds.JIT.Memory.GetVRAM() + VRAMLCDCBase[8]),
     GPU2D_A(0, *this),
     GPU2D_B(1, *this),
     GPU3D(nds, renderer3d ? std::move(renderer3d) : std::make_unique<SoftRenderer>()),
@@ -228,15 +241,27 @@ void GPU::DoSavestate(Savestate* file) noexcept
     file->VarArray(Palette, 2*1024);
     file->VarArray(OAM, 2*1024);
 
-    file->VarArray(VRAM_A, 128*1024);
-    file->VarArray(VRAM_B, 128*1024);
-    file->VarArray(VRAM_C, 128*1024);
-    file->VarArray(VRAM_D, 128*1024);
-    file->VarArray(VRAM_E,  64*1024);
-    file->VarArray(VRAM_F,  16*1024);
-    file->VarArray(VRAM_G,  16*1024);
-    file->VarArray(VRAM_H,  32*1024);
-    file->VarArray(VRAM_I,  16*1024);
+    // restoring a snapshot only marks what changed in VRAM as dirty,
+    // like writes would, instead of flattening everything again
+    bool keepVRAMCache = !file->Saving && NDS.IsInSnapshot();
+    bool pagesTracked = NDS.SnapshotDirtyPagesValid(*file);
+    for (int i = 0; i < 9; i++)
+    {
+        Savestate::PageLoadCallback onLoadPage;
+        if (keepVRAMCache)
+        {
+            onLoadPage = [this, i](u32 offset, const u8* incoming, u32 len)
+            {
+                for (u32 j = 0; j < len; j += VRAMDirtyGranularity)
+                {
+                    if (memcmp(&VRAM[i][offset + j], &incoming[j], VRAMDirtyGranularity) != 0)
+                        VRAMDirty[i][(offset + j) / VRAMDirtyGranularity] = true;
+                }
+            };
+        }
+
+        file->PagedArray(VRAM[i], VRAMMask[i] + 1, pagesTracked ? &VRAMDirtyPages[i] : nullptr, onLoadPage);
+    }
 
     file->VarArray(VRAMCNT, 9);
     file->Var8(&VRAMSTAT);
@@ -275,7 +300,7 @@ void GPU::DoSavestate(Savestate* file) noexcept
     GPU2D_B.DoSavestate(file);
     GPU3D.DoSavestate(file);
 
-    if (!file->Saving)
+    if (!file->Saving && !keepVRAMCache)
         ResetVRAMCache();
 }
 
@@ -368,6 +393,80 @@ const u8* GPU::GetUniqueBankPtr(u32 mask, u32 offset) const noexcept
     return &VRAM[num][offset & VRAMMask[num]];
 }
 
+u8* GPU::GetARM9VRAMPage(u32 addr) noexcept
+{
+    switch (addr & 0x00E00000)
+    {
+    case 0x00000000: return VRAMPtr_ABG[(addr >> 14) & 0x1F];
+    case 0x00200000: return VRAMPtr_BBG[(addr >> 14) & 0x7];
+    case 0x00400000: return VRAMPtr_AOBJ[(addr >> 14) & 0xF];
+    case 0x00600000: return VRAMPtr_BOBJ[(addr >> 14) & 0x7];
+    }
+
+    // LCDC, see ReadVRAM_LCDC()
+    u32 offset = addr & 0xFC000;
+    for (int bank = 0; bank < 9; bank++)
+    {
+        if (offset >= VRAMLCDCBase[bank] && offset <= VRAMLCDCBase[bank] + VRAMMask[bank])
+            return (VRAMMap_LCDC & (1<<bank)) ? &VRAM[bank][offset - VRAMLCDCBase[bank]] : NULL;
+    }
+
+    return NULL;
+}
+
+u8* GPU::GetARM7VRAMPage(u32 addr) noexcept
+{
+    return GetUniqueBankPtr(VRAMMap_ARM7[(addr >> 17) & 0x1], addr & 0x1C000);
+}
+
+u32 GPU::VRAMWindows(u32 bank, u8 cnt) noexcept
+{
+    if (!(cnt & (1<<7)))
+        return 0;
+
+    switch (cnt & 0x7)
+    {
+    case 0: // LCDC, mirrored up to 0x06FFFFFF
+        return 0xF0;
+
+    case 1: // ABG, BBG for H and I
+        return (bank < 7) ? (1<<0) : (1<<1);
+
+    case 2:
+        if (bank == 2 || bank == 3) return 1<<8; // ARM7 VRAM
+        if (bank == 7) return 0;                 // BBG ext palette
+        if (bank == 8) return 1<<3;              // BOBJ
+        return 1<<2;                             // AOBJ
+
+    case 4: // BBG/BOBJ for C and D, ext palettes otherwise
+        if (bank == 2) return 1<<1;
+        if (bank == 3) return 1<<3;
+        return 0;
+
+    default: // texture/palettes
+        return 0;
+    }
+}
+
+void GPU::VRAMRemapped(u32 bank, u8 oldcnt, u8 cnt) noexcept
+{
+    u32 windows = VRAMWindows(bank, oldcnt) | VRAMWindows(bank, cnt);
+
+    // the ARM7's VRAM is mirrored all the way through
+    if (windows & (1<<8))
+        NDS.UpdateReadMap(0x06000000, 0x07000000);
+    else
+    {
+        for (u32 i = 0; i < 8; i++)
+        {
+            if (windows & (1<<i))
+                NDS.UpdateReadMap(0x06000000 + (i << 21), 0x06000000 + ((i + 1) << 21));
+        }
+    }
+
+    NDS.JIT.Memory.RemapVRAM(windows);
+}
+
 #define MAP_RANGE(map, base, n)    for (int i = 0; i < n; i++) VRAMMap_##map[(base)+i] |= bankmask;
 #define UNMAP_RANGE(map, base, n)  for (int i = 0; i < n; i++) VRAMMap_##map[(base)+i] &= ~bankmask;
 
@@ -434,6 +533,8 @@ void GPU::MapVRAM_AB(u32 bank, u8 cnt) noexcept
             break;
         }
     }
+
+    VRAMRemapped(bank, oldcnt, cnt);
 }
 
 void GPU::MapVRAM_CD(u32 bank, u8 cnt) noexcept
@@ -521,6 +622,8 @@ void GPU::MapVRAM_CD(u32 bank, u8 cnt) noexcept
             break;
         }
     }
+
+    VRAMRemapped(bank, oldcnt, cnt);
 }
 
 void GPU::MapVRAM_E(u32 bank, u8 cnt) noexcept
@@ -585,6 +688,8 @@ void GPU::MapVRAM_E(u32 bank, u8 cnt) noexcept
             break;
         }
     }
+
+    VRAMRemapped(bank, oldcnt, cnt);
 }
 
 void GPU::MapVRAM_FG(u32 bank, u8 cnt) noexcept
@@ -685,6 +790,8 @@ void GPU::MapVRAM_FG(u32 bank, u8 cnt) noexcept
             break;
         }
     }
+
+    VRAMRemapped(bank, oldcnt, cnt);
 }
 
 void GPU::MapVRAM_H(u32 bank, u8 cnt) noexcept
@@ -747,6 +854,8 @@ void GPU::MapVRAM_H(u32 bank, u8 cnt) noexcept
             break;
         }
     }
+
+    VRAMRemapped(bank, oldcnt, cnt);
 }
 
 void GPU::MapVRAM_I(u32 bank, u8 cnt) noexcept
@@ -817,6 +926,8 @@ void GPU::MapVRAM_I(u32 bank, u8 cnt) noexcept
             break;
         }
     }
+
+    VRAMRemapped(bank, oldcnt, cnt);
 }
 
 
@@ -881,6 +992,8 @@ void GPU::StartHBlank(u32 line) noexcept
 
     if (VCount < 192)
     {
+        ProfileScope scope(NDS.Profiler, Prof_GPU2D);
+
         // draw
         // note: this should start 48 cycles after the scanline start
         if (line < 192)
@@ -900,6 +1013,7 @@ void GPU::StartHBlank(u32 line) noexcept
     }
     else if (VCount == 215)
     {
+        ProfileScope scope(NDS.Profiler, Prof_GPU3D);
         GPU3D.VCount215(*this);
     }
     else if (VCount == 262)
@@ -1122,6 +1236,9 @@ NonStupidBitField<Size/VRAMDirtyGranularity> VRAMTrackingSet<Size, MappingGranul
         }
     }
 
+    // writes through the JIT's fast memory are only seen once per clear
+    gpu.NDS.JIT.Memory.ProtectVRAM(banksToBeZeroed);
+
     while (banksToBeZeroed != 0)
     {
         u32 num = __builtin_ctz(banksToBeZeroed);
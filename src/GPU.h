@@ -72,6 +72,22 @@ public:
     u8* GetUniqueBankPtr(u32 mask, u32 offset) noexcept;
     const u8* GetUniqueBankPtr(u32 mask, u32 offset) const noexcept;
 
+    // the 16K page the ARM9/ARM7 read at addr in their VRAM ranges, if a single
+    // bank is mapped there. null otherwise, see NDS::UpdateReadMap()
+    u8* GetARM9VRAMPage(u32 addr) noexcept;
+    u8* GetARM7VRAMPage(u32 addr) noexcept;
+
+    // the bank a pointer to VRAM is in, ~0 if it isn't in any of them
+    u32 GetVRAMBank(const u8* ptr) const noexcept
+    {
+        for (u32 bank = 0; bank < 9; bank++)
+        {
+            if (ptr >= VRAM[bank] && ptr <= &VRAM[bank][VRAMMask[bank]])
+                return bank;
+        }
+        return ~0u;
+    }
+
     void SetRenderer2D(std::unique_ptr<GPU2D::Renderer2D>&& renderer) noexcept { GPU2D_Renderer = std::move(renderer); }
     [[nodiscard]] const GPU2D::Renderer2D& GetRenderer2D() const noexcept { return *GPU2D_Renderer; }
     [[nodiscard]] GPU2D::Renderer2D& GetRenderer2D() noexcept { return *GPU2D_Renderer; }
@@ -148,6 +164,16 @@ public:
         return 0;
     }
 
+    // marks a write for the flattened copies, and for snapshots
+    void MarkVRAMDirty(u32 bank, u32 addr) noexcept
+    {
+        VRAMDirty[bank][addr / VRAMDirtyGranularity] = true;
+        VRAMDirtyPages[bank] |= 1ULL << (addr >> Savestate::PAGE_SHIFT);
+    }
+
+    // the pages of each bank written since the last snapshot, see NDS::SaveSnapshot()
+    void ResetVRAMDirtyPages() noexcept { memset(VRAMDirtyPages, 0, sizeof(VRAMDirtyPages)); }
+
     template<typename T>
     void WriteVRAM_LCDC(u32 addr, T val)
     {
@@ -211,7 +237,7 @@ public:
         if (VRAMMap_LCDC & (1<<bank))
         {
             *(T*)&VRAM[bank][addr] = val;
-            VRAMDirty[bank][addr / VRAMDirtyGranularity] = true;
+            MarkVRAMDirty(bank, addr);
         }
     }
 
@@ -243,37 +269,37 @@ public:
 
         if (mask & (1<<0))
         {
-            VRAMDirty[0][(addr & 0x1FFFF) / VRAMDirtyGranularity] = true;
+            MarkVRAMDirty(0, addr & 0x1FFFF);
             *(T*)&VRAM_A[addr & 0x1FFFF] = val;
         }
         if (mask & (1<<1))
         {
-            VRAMDirty[1][(addr & 0x1FFFF) / VRAMDirtyGranularity] = true;
+            MarkVRAMDirty(1, addr & 0x1FFFF);
             *(T*)&VRAM_B[addr & 0x1FFFF] = val;
         }
         if (mask & (1<<2))
         {
-            VRAMDirty[2][(addr & 0x1FFFF) / VRAMDirtyGranularity] = true;
+            MarkVRAMDirty(2, addr & 0x1FFFF);
             *(T*)&VRAM_C[addr & 0x1FFFF] = val;
         }
         if (mask & (1<<3))
         {
-            VRAMDirty[3][(addr & 0x1FFFF) / VRAMDirtyGranularity] = true;
+            MarkVRAMDirty(3, addr & 0x1FFFF);
             *(T*)&VRAM_D[addr & 0x1FFFF] = val;
         }
         if (mask & (1<<4))
         {
-            VRAMDirty[4][(addr & 0xFFFF) / VRAMDirtyGranularity] = true;
+            MarkVRAMDirty(4, addr & 0xFFFF);
             *(T*)&VRAM_E[addr & 0xFFFF] = val;
         }
         if (mask & (1<<5))
         {
-            VRAMDirty[5][(addr & 0x3FFF) / VRAMDirtyGranularity] = true;
+            MarkVRAMDirty(5, addr & 0x3FFF);
             *(T*)&VRAM_F[addr & 0x3FFF] = val;
         }
         if (mask & (1<<6))
         {
-            VRAMDirty[6][(addr & 0x3FFF) / VRAMDirtyGranularity] = true;
+            MarkVRAMDirty(6, addr & 0x3FFF);
             *(T*)&VRAM_G[addr & 0x3FFF] = val;
         }
     }
@@ -304,27 +330,27 @@ public:
 
         if (mask & (1<<0))
         {
-            VRAMDirty[0][(addr & 0x1FFFF) / VRAMDirtyGranularity] = true;
+            MarkVRAMDirty(0, addr & 0x1FFFF);
             *(T*)&VRAM_A[addr & 0x1FFFF] = val;
         }
         if (mask & (1<<1))
         {
-            VRAMDirty[1][(addr & 0x1FFFF) / VRAMDirtyGranularity] = true;
+            MarkVRAMDirty(1, addr & 0x1FFFF);
             *(T*)&VRAM_B[addr & 0x1FFFF] = val;
         }
         if (mask & (1<<4))
         {
-            VRAMDirty[4][(addr & 0xFFFF) / VRAMDirtyGranularity] = true;
+            MarkVRAMDirty(4, addr & 0xFFFF);
             *(T*)&VRAM_E[addr & 0xFFFF] = val;
         }
         if (mask & (1<<5))
         {
-            VRAMDirty[5][(addr & 0x3FFF) / VRAMDirtyGranularity] = true;
+            MarkVRAMDirty(5, addr & 0x3FFF);
             *(T*)&VRAM_F[addr & 0x3FFF] = val;
         }
         if (mask & (1<<6))
         {
-            VRAMDirty[6][(addr & 0x3FFF) / VRAMDirtyGranularity] = true;
+            MarkVRAMDirty(6, addr & 0x3FFF);
             *(T*)&VRAM_G[addr & 0x3FFF] = val;
         }
     }
@@ -353,17 +379,17 @@ public:
 
         if (mask & (1<<2))
         {
-            VRAMDirty[2][(addr & 0x1FFFF) / VRAMDirtyGranularity] = true;
+            MarkVRAMDirty(2, addr & 0x1FFFF);
             *(T*)&VRAM_C[addr & 0x1FFFF] = val;
         }
         if (mask & (1<<7))
         {
-            VRAMDirty[7][(addr & 0x7FFF) / VRAMDirtyGranularity] = true;
+            MarkVRAMDirty(7, addr & 0x7FFF);
             *(T*)&VRAM_H[addr & 0x7FFF] = val;
         }
         if (mask & (1<<8))
         {
-            VRAMDirty[8][(addr & 0x3FFF) / VRAMDirtyGranularity] = true;
+            MarkVRAMDirty(8, addr & 0x3FFF);
             *(T*)&VRAM_I[addr & 0x3FFF] = val;
         }
     }
@@ -391,12 +417,12 @@ public:
 
         if (mask & (1<<3))
         {
-            VRAMDirty[3][(addr & 0x1FFFF) / VRAMDirtyGranularity] = true;
+            MarkVRAMDirty(3, addr & 0x1FFFF);
             *(T*)&VRAM_D[addr & 0x1FFFF] = val;
         }
         if (mask & (1<<8))
         {
-            VRAMDirty[8][(addr & 0x3FFF) / VRAMDirtyGranularity] = true;
+            MarkVRAMDirty(8, addr & 0x3FFF);
             *(T*)&VRAM_I[addr & 0x3FFF] = val;
         }
     }
@@ -418,8 +444,16 @@ public:
     {
         u32 mask = VRAMMap_ARM7[(addr >> 17) & 0x1];
 
-        if (mask & (1<<2)) *(T*)&VRAM_C[addr & 0x1FFFF] = val;
-        if (mask & (1<<3)) *(T*)&VRAM_D[addr & 0x1FFFF] = val;
+        if (mask & (1<<2))
+        {
+            MarkVRAMDirty(2, addr & 0x1FFFF);
+            *(T*)&VRAM_C[addr & 0x1FFFF] = val;
+        }
+        if (mask & (1<<3))
+        {
+            MarkVRAMDirty(3, addr & 0x1FFFF);
+            *(T*)&VRAM_D[addr & 0x1FFFF] = val;
+        }
     }
 
 
@@ -539,15 +573,16 @@ public:
     alignas(u64) u8 Palette[2*1024] {};
     alignas(u64) u8 OAM[2*1024] {};
 
-    alignas(u64) u8 VRAM_A[128*1024] {};
-    alignas(u64) u8 VRAM_B[128*1024] {};
-    alignas(u64) u8 VRAM_C[128*1024] {};
-    alignas(u64) u8 VRAM_D[128*1024] {};
-    alignas(u64) u8 VRAM_E[ 64*1024] {};
-    alignas(u64) u8 VRAM_F[ 16*1024] {};
-    alignas(u64) u8 VRAM_G[ 16*1024] {};
-    alignas(u64) u8 VRAM_H[ 32*1024] {};
-    alignas(u64) u8 VRAM_I[ 16*1024] {};
+    // the banks are in the JIT's memory block, so fast memory can map them
+    u8* const VRAM_A; // 128 KB
+    u8* const VRAM_B; // 128 KB
+    u8* const VRAM_C; // 128 KB
+    u8* const VRAM_D; // 128 KB
+    u8* const VRAM_E; //  64 KB
+    u8* const VRAM_F; //  16 KB
+    u8* const VRAM_G; //  16 KB
+    u8* const VRAM_H; //  32 KB
+    u8* const VRAM_I; //  16 KB
 
     u8* const VRAM[9]     = {VRAM_A,  VRAM_B,  VRAM_C,  VRAM_D,  VRAM_E, VRAM_F, VRAM_G, VRAM_H, VRAM_I};
     u32 const VRAMMask[9] = {0x1FFFF, 0x1FFFF, 0x1FFFF, 0x1FFFF, 0xFFFF, 0x3FFF, 0x3FFF, 0x7FFF, 0x3FFF};
@@ -578,6 +613,7 @@ public:
     melonDS::GPU3D GPU3D;
 
     NonStupidBitField<128*1024/VRAMDirtyGranularity> VRAMDirty[9] {};
+    u64 VRAMDirtyPages[9] {};
     VRAMTrackingSet<512*1024, 16*1024> VRAMDirty_ABG {};
     VRAMTrackingSet<256*1024, 16*1024> VRAMDirty_AOBJ {};
     VRAMTrackingSet<128*1024, 16*1024> VRAMDirty_BBG {};
@@ -606,6 +642,12 @@ public:
     alignas(u64) u8 VRAMFlat_TexPal[128*1024] {};
 private:
     void ResetVRAMCache() noexcept;
+    // the parts of the VRAM space where a bank mapped with cnt can be
+    // accessed: a bit for each 2MB of the ARM9's, bit 8 for the ARM7's
+    static u32 VRAMWindows(u32 bank, u8 cnt) noexcept;
+    // updates what the CPUs see after a bank was mapped differently,
+    // only where it was and is now
+    void VRAMRemapped(u32 bank, u8 oldcnt, u8 cnt) noexcept;
     void AssignFramebuffers() noexcept;
     void InitFramebuffers() noexcept;
     template<typename T>
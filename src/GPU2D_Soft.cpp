@@ -420,7 +420,7 @@ void SoftRenderer::DoCapture(u32 line, u32 width)
     srcBaddr &= 0xFFFF;
 
     static_assert(VRAMDirtyGranularity == 512);
-    GPU.VRAMDirty[dstvram][(dstaddr * 2) / VRAMDirtyGranularity] = true;
+    GPU.MarkVRAMDirty(dstvram, dstaddr * 2);
 
     switch ((captureCnt >> 29) & 0x3)
     {
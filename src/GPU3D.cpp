@@ -557,6 +557,14 @@ void GPU3D::DoSavestate(Savestate* file) noexcept
     {
         softRenderer->EnableRenderThread();
     }
+    else if (!file->Saving && (softRenderer || NDS.IsInSnapshot()))
+    {
+        // the render thread redraws the loaded frame when it restarts, do the same here
+        // so the next frame doesn't show what was rendered before loading.
+        // other renderers only for snapshots, savestate files can be loaded
+        // from a thread that doesn't have their context
+        CurrentRenderer->RenderFrame(NDS.GPU);
+    }
 }
 
 
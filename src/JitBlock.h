@@ -19,6 +19,8 @@
 #ifndef MELONDS_JITBLOCK_H
 #define MELONDS_JITBLOCK_H
 
+#include <memory>
+#include <vector>
 #include "types.h"
 #include "TinyVector.h"
 
@@ -29,12 +31,21 @@ typedef void (*JitBlockEntry)();
 class JitBlock
 {
 public:
-    JitBlock(u32 num, u32 literalHash, u32 numAddresses, u32 numLiterals)
+    // blocks are reused, see JitBlockPool
+    void Init(u32 num, u32 numAddresses, u32 numLiterals)
     {
         Num = num;
         NumAddresses = numAddresses;
         NumLiterals = numLiterals;
         Data.SetLength(numAddresses * 2 + numLiterals);
+
+        LinkSite = nullptr;
+        LinkTarget = 0;
+        LinkedTo = nullptr;
+        LinkedFrom.Clear();
+#ifdef JIT_PERF_MAP_ENABLED
+        EntryCount = 0;
+#endif
     }
 
     u32 StartAddr;
@@ -43,9 +54,23 @@ public:
     u8 Num;
     u16 NumAddresses;
     u16 NumLiterals;
+    bool Thumb;
 
     JitBlockEntry EntryPoint;
 
+    // the exit which can be patched to jump directly into the block after
+    // this one, null if there's none. LinkTarget is where that block starts,
+    // bit 0 set for thumb
+    void* LinkSite = nullptr;
+    u32 LinkTarget = 0;
+    JitBlock* LinkedTo = nullptr;
+    TinyVector<JitBlock*> LinkedFrom;
+
+#ifdef JIT_PERF_MAP_ENABLED
+    // counted up by the block's code whenever it's entered
+    u64 EntryCount;
+#endif
+
     const u32* AddressRanges() const { return &Data[0]; }
     u32* AddressRanges() { return &Data[0]; }
     const u32* AddressMasks() const { return &Data[NumAddresses]; }
@@ -56,6 +81,41 @@ public:
 private:
     TinyVector<u32> Data;
 };
+
+// Code which is overlayed all the time makes for a lot of blocks which are
+// thrown away soon after they were compiled. Instead of going back to the heap
+// they're allocated in chunks and kept on a free list, with the memory for
+// their address ranges and literals.
+class JitBlockPool
+{
+public:
+    JitBlock* Alloc(u32 num, u32 numAddresses, u32 numLiterals)
+    {
+        if (FreeBlocks.empty())
+        {
+            Chunks.push_back(std::make_unique<JitBlock[]>(ChunkSize));
+            JitBlock* chunk = Chunks.back().get();
+            for (u32 i = 0; i < ChunkSize; i++)
+                FreeBlocks.push_back(&chunk[ChunkSize - 1 - i]);
+        }
+
+        JitBlock* block = FreeBlocks.back();
+        FreeBlocks.pop_back();
+        block->Init(num, numAddresses, numLiterals);
+        return block;
+    }
+
+    void Free(JitBlock* block)
+    {
+        FreeBlocks.push_back(block);
+    }
+
+private:
+    static constexpr u32 ChunkSize = 256;
+
+    std::vector<std::unique_ptr<JitBlock[]>> Chunks;
+    std::vector<JitBlock*> FreeBlocks;
+};
 }
 
 #endif //MELONDS_JITBLOCK_H
@@ -27,6 +27,7 @@ constexpr u32 MainRAMMaxSize = 0x1000000;
 constexpr u32 SharedWRAMSize = 0x8000;
 constexpr u32 ARM7WRAMSize = 0x10000;
 constexpr u32 NWRAMSize = 0x40000;
+constexpr u32 VRAMSize = 0xA4000; // all the banks, A to I
 constexpr u32 ARM9BIOSSize = 0x1000;
 constexpr u32 ARM7BIOSSize = 0x4000;
 constexpr u32 DSiBIOSSize = 0x10000;
@@ -51,6 +51,9 @@ using namespace Platform;
 const s32 kMaxIterationCycles = 64;
 const s32 kIterationCycleMargin = 8;
 
+// same as LINE_CYCLES in GPU.cpp
+const s32 kScanlineCycles = 355*6;
+
 // timing notes
 //
 // * this implementation is technically wrong for VRAM
@@ -121,16 +124,20 @@ NDS::NDS(NDSArgs&& args, int type) noexcept :
 {
     RegisterEventFunc(Event_Div, 0, MemberEventFunc(NDS, DivDone));
     RegisterEventFunc(Event_Sqrt, 0, MemberEventFunc(NDS, SqrtDone));
+    RegisterEventFunc(Event_InputHook, 0, MemberEventFunc(NDS, InputHookDone));
 
     MainRAM = JIT.Memory.GetMainRAM();
     SharedWRAM = JIT.Memory.GetSharedWRAM();
     ARM7WRAM = JIT.Memory.GetARM7WRAM();
+
+    SetIdleLoopSkipping(args.IdleLoopSkipping);
 }
 
 NDS::~NDS() noexcept
 {
     UnregisterEventFunc(Event_Div, 0);
     UnregisterEventFunc(Event_Sqrt, 0);
+    UnregisterEventFunc(Event_InputHook, 0);
     // The destructor for each component is automatically called by the compiler
 }
 
@@ -196,6 +203,8 @@ void NDS::SetARM7RegionTimings(u32 addrstart, u32 addrend, u32 region, int buswi
         S32 = S16;
     }
 
+    MemTimingsVersion++;
+
     for (u32 i = addrstart; i < addrend; i++)
     {
         // CPU and DMA timings are the same
@@ -428,6 +437,7 @@ void NDS::Reset()
     // BIOS files are now loaded by the frontend
 
     JIT.Reset();
+    ResetDirtyPages(0);
 
     if (ConsoleType == 1)
     {
@@ -516,6 +526,7 @@ void NDS::Reset()
         evt.Param = 0;
     }
     SchedListMask = 0;
+    UpdateNextEvent();
 
     KeyInput = 0x007F03FF;
     KeyCnt[0] = 0;
@@ -529,6 +540,8 @@ void NDS::Reset()
     SPI.Reset();
     RTC.Reset();
     Wifi.Reset();
+
+    UpdateReadMap(0, 0x10000000);
 }
 
 void NDS::Start()
@@ -598,9 +611,46 @@ bool NDS::DoSavestate(Savestate* file)
         }
     }
 
-    file->VarArray(MainRAM, MainRAMMaxSize);
-    file->VarArray(SharedWRAM, SharedWRAMSize);
-    file->VarArray(ARM7WRAM, ARM7WRAMSize);
+    if (InSnapshot)
+    {
+        // the memory timing tables only have to be rebuilt if something
+        // rebuilt them since the snapshot was saved
+        u32 timingsVersion = MemTimingsVersion;
+        file->Var32(&timingsVersion);
+        SnapshotTimingsMatch = !file->Saving && ConsoleType == 0 && timingsVersion == MemTimingsVersion;
+    }
+
+    // snapshots don't leave the process, so they can skip the part
+    // of main RAM that this console doesn't have
+    u32 mainRAMSize = InSnapshot ? (MainRAMMask + 1) : MainRAMMaxSize;
+
+    // the JIT's fast memory accesses write to RAM directly, those aren't tracked
+    bool ramPagesTracked = SnapshotDirtyPagesValid(*file);
+    Savestate::PageLoadCallback onLoadMainRAM, onLoadSharedWRAM, onLoadARM7WRAM;
+#ifdef JIT_ENABLED
+    if (EnableJIT && JIT.FastMemoryEnabled())
+        ramPagesTracked = false;
+
+    // restoring a snapshot only drops the blocks whose code changed
+    bool keepJITBlocks = !file->Saving && InSnapshot;
+    if (keepJITBlocks)
+    {
+        auto invalidateChangedCode = [this](int region, const u8* mem) -> Savestate::PageLoadCallback
+        {
+            return [this, region, mem](u32 offset, const u8* incoming, u32 len)
+            {
+                JIT.InvalidateChangedCode(region, offset, &mem[offset], incoming, len);
+            };
+        };
+        onLoadMainRAM = invalidateChangedCode(ARMJIT_Memory::memregion_MainRAM, MainRAM);
+        onLoadSharedWRAM = invalidateChangedCode(ARMJIT_Memory::memregion_SharedWRAM, SharedWRAM);
+        onLoadARM7WRAM = invalidateChangedCode(ARMJIT_Memory::memregion_WRAM7, ARM7WRAM);
+    }
+#endif
+
+    file->PagedArray(MainRAM, mainRAMSize, ramPagesTracked ? MainRAMDirty : nullptr, onLoadMainRAM);
+    file->PagedArray(SharedWRAM, SharedWRAMSize, ramPagesTracked ? &SharedWRAMDirty : nullptr, onLoadSharedWRAM);
+    file->PagedArray(ARM7WRAM, ARM7WRAMSize, ramPagesTracked ? &ARM7WRAMDirty : nullptr, onLoadARM7WRAM);
 
     //file->VarArray(ARM9BIOS, 0x1000);
     //file->VarArray(ARM7BIOS, 0x4000);
@@ -652,6 +702,8 @@ bool NDS::DoSavestate(Savestate* file)
 
     for (int i = 0; i < Event_MAX; i++)
     {
+        if (i == Event_InputHook) continue;
+
         SchedEvent& evt = SchedList[i];
 
         file->Var64(&evt.Timestamp);
@@ -659,6 +711,25 @@ bool NDS::DoSavestate(Savestate* file)
         file->Var32(&evt.Param);
     }
     file->Var32(&SchedListMask);
+    if (!file->Saving)
+    {
+        SchedListMask &= ~(1<<Event_InputHook); // rescheduled by the next frame
+
+        // the handlers are called through a table, don't let a bad state index past it
+        for (u32 mask = SchedListMask; mask; mask &= mask - 1)
+        {
+            u32 i = __builtin_ctz(mask);
+            SchedEvent& evt = SchedList[i];
+            if (evt.FuncID >= MaxEventFuncs || !evt.Funcs[evt.FuncID].Func)
+            {
+                Log(LogLevel::Error, "savestate: event %u has no function %u, dropped\n", i, evt.FuncID);
+                SchedListMask &= ~(1<<i);
+                evt.FuncID = 0;
+            }
+        }
+
+        UpdateNextEvent();
+    }
     file->Var64(&ARM9Timestamp);
     file->Var64(&ARM9Target);
     file->Var64(&ARM7Timestamp);
@@ -674,7 +745,9 @@ bool NDS::DoSavestate(Savestate* file)
     file->VarArray(KeyCnt, 2*sizeof(u16));
     file->Var16(&RCnt);
 
-    file->Var8(&WRAMCnt);
+    // loaded separately, MapSharedWRAM() does nothing if the value doesn't change
+    u8 wramcnt = WRAMCnt;
+    file->Var8(&wramcnt);
 
     file->Bool32(&RunningGame);
 
@@ -682,12 +755,16 @@ bool NDS::DoSavestate(Savestate* file)
     {
         // 'dept of redundancy dept'
         // but we do need to update the mappings
-        MapSharedWRAM(WRAMCnt);
+        MapSharedWRAM(wramcnt);
 
-        InitTimings();
-        SetGBASlotTimings();
+        // rebuilding these takes a few milliseconds
+        if (!SnapshotKeepsMemTimings())
+        {
+            InitTimings();
+            SetGBASlotTimings();
 
-        UpdateWifiTimings();
+            UpdateWifiTimings();
+        }
     }
 
     for (int i = 0; i < 8; i++)
@@ -714,8 +791,19 @@ bool NDS::DoSavestate(Savestate* file)
         SPU.SetPowerCnt(PowerControl7 & 0x0001);
         Wifi.SetPowerCnt(PowerControl7 & 0x0002);
 
+        // the VRAM mappings were loaded as they were, shared WRAM went through MapSharedWRAM()
+        UpdateReadMap(0x06000000, 0x07000000);
+        JIT.Memory.RemapVRAM(0x1FF);
+
+        // RAM doesn't match any snapshot anymore
+        if (!InSnapshot)
+            ResetDirtyPages(0);
+
 #ifdef JIT_ENABLED
-        JIT.Reset();
+        // code running from VRAM or the DSi's NWRAM is looked up through
+        // mappings that change behind the JIT's back, don't bother with those
+        if (!keepJITBlocks || ConsoleType != 0 || JIT.HasVRAMCode())
+            JIT.Reset();
 #endif
     }
 
@@ -724,6 +812,57 @@ bool NDS::DoSavestate(Savestate* file)
     return true;
 }
 
+bool NDS::SaveSnapshot(Savestate& state, const Savestate* base)
+{
+    state.BeginSnapshot(base ? base : &state);
+
+    InSnapshot = true;
+    DoSavestate(&state);
+    InSnapshot = false;
+
+    // writes are tracked relative to this snapshot from now on
+    ResetDirtyPages(state.GetSnapshotID());
+    return state.IsSnapshot();
+}
+
+bool NDS::LoadSnapshot(Savestate& state)
+{
+    if (!state.IsSnapshot())
+        return false;
+
+    state.Rewind(false);
+
+    InSnapshot = true;
+    bool ret = DoSavestate(&state) && !state.Error;
+    InSnapshot = false;
+
+#ifdef JIT_ENABLED
+    // the kept blocks stay compiled, but everything else counts
+    // towards the compile threshold from the start again
+    JIT.ResetInterpretCounts();
+#endif
+
+    ResetDirtyPages(ret ? state.GetSnapshotID() : 0);
+    return ret;
+}
+
+bool NDS::SnapshotKeepsMemTimings() const noexcept
+{
+    return InSnapshot && SnapshotTimingsMatch;
+}
+
+void NDS::ResetDirtyPages(u64 base) noexcept
+{
+    memset(MainRAMDirty, 0, sizeof(MainRAMDirty));
+    SharedWRAMDirty = 0;
+    ARM7WRAMDirty = 0;
+    GPU.ResetVRAMDirtyPages();
+    // so writes to VRAM through the JIT's fast memory are seen again
+    JIT.Memory.ProtectVRAM(0x1FF);
+
+    DirtyPagesBase = base;
+}
+
 void NDS::SetNDSCart(std::unique_ptr<NDSCart::CartCommon>&& cart)
 {
     NDSCartSlot.SetCart(std::move(cart));
@@ -769,23 +908,27 @@ void NDS::SetARM9BIOS(const std::array<u8, ARM9BIOSSize>& bios) noexcept
     ARM9BIOSNative = CRC32(ARM9BIOS.data(), ARM9BIOS.size()) == ARM9BIOSCRC32;
 }
 
-u64 NDS::NextTarget()
+void NDS::UpdateNextEvent()
 {
     u64 minEvent = UINT64_MAX;
 
-    u32 mask = SchedListMask;
-    for (int i = 0; i < Event_MAX; i++)
+    for (u32 mask = SchedListMask; mask; mask &= mask - 1)
     {
-        if (!mask) break;
-        if (mask & 0x1)
-        {
-            if (SchedList[i].Timestamp < minEvent)
-                minEvent = SchedList[i].Timestamp;
-        }
-
-        mask >>= 1;
+        u64 timestamp = SchedList[__builtin_ctz(mask)].Timestamp;
+        if (timestamp < minEvent)
+            minEvent = timestamp;
     }
 
+    SchedNextTimestamp = minEvent;
+    SchedNextDirty = false;
+}
+
+u64 NDS::NextTarget()
+{
+    if (SchedNextDirty)
+        UpdateNextEvent();
+
+    u64 minEvent = SchedNextTimestamp;
     u64 max = SysTimestamp + kMaxIterationCycles;
 
     if (minEvent < max + kIterationCycleMargin)
@@ -798,45 +941,41 @@ void NDS::RunSystem(u64 timestamp)
 {
     SysTimestamp = timestamp;
 
-    u32 mask = SchedListMask;
-    for (int i = 0; i < Event_MAX; i++)
+    // SchedNextTimestamp is never later than the earliest event
+    if (SysTimestamp < SchedNextTimestamp)
+        return;
+
+    // in ID order, and only the events that were scheduled when we started:
+    // the ones scheduled by the handlers wait for the next call
+    for (u32 mask = SchedListMask; mask; mask &= mask - 1)
     {
-        if (!mask) break;
-        if (mask & 0x1)
-        {
-            SchedEvent& evt = SchedList[i];
+        u32 i = __builtin_ctz(mask);
+        SchedEvent& evt = SchedList[i];
 
-            if (evt.Timestamp <= SysTimestamp)
-            {
-                SchedListMask &= ~(1<<i);
+        if (evt.Timestamp <= SysTimestamp)
+        {
+            SchedListMask &= ~(1<<i);
 
-                EventFunc func = evt.Funcs[evt.FuncID];
-                func(evt.Param);
-            }
+            const EventHandler& handler = evt.Funcs[evt.FuncID];
+            u64 start = Profiler.EventStart();
+            handler.Func(handler.Context, evt.Param);
+            Profiler.EventDone(i, start);
         }
-
-        mask >>= 1;
     }
+
+    SchedNextDirty = true;
 }
 
 u64 NDS::NextTargetSleep()
 {
     u64 minEvent = UINT64_MAX;
 
-    u32 mask = SchedListMask;
-    for (int i = 0; i < Event_MAX; i++)
+    u32 mask = SchedListMask & ((1<<Event_SPU) | (1<<Event_RTC));
+    for (; mask; mask &= mask - 1)
     {
-        if (!mask) break;
-        if (i == Event_SPU || i == Event_RTC)
-        {
-            if (mask & 0x1)
-            {
-                if (SchedList[i].Timestamp < minEvent)
-                    minEvent = SchedList[i].Timestamp;
-            }
-        }
-
-        mask >>= 1;
+        u64 timestamp = SchedList[__builtin_ctz(mask)].Timestamp;
+        if (timestamp < minEvent)
+            minEvent = timestamp;
     }
 
     return minEvent;
@@ -847,46 +986,46 @@ void NDS::RunSystemSleep(u64 timestamp)
     u64 offset = timestamp - SysTimestamp;
     SysTimestamp = timestamp;
 
-    u32 mask = SchedListMask;
-    for (int i = 0; i < Event_MAX; i++)
+    for (u32 mask = SchedListMask; mask; mask &= mask - 1)
     {
-        if (!mask) break;
+        u32 i = __builtin_ctz(mask);
+        SchedEvent& evt = SchedList[i];
+
         if (i == Event_SPU || i == Event_RTC)
         {
-            if (mask & 0x1)
+            if (evt.Timestamp <= SysTimestamp)
             {
-                SchedEvent& evt = SchedList[i];
-
-                if (evt.Timestamp <= SysTimestamp)
-                {
-                    SchedListMask &= ~(1<<i);
+                SchedListMask &= ~(1<<i);
 
-                    u32 param;
-                    if (i == Event_SPU)
-                        param = 1;
-                    else
-                        param = evt.Param;
+                u32 param;
+                if (i == Event_SPU)
+                    param = 1;
+                else
+                    param = evt.Param;
 
-                    EventFunc func = evt.Funcs[evt.FuncID];
-                    func(param);
-                }
+                const EventHandler& handler = evt.Funcs[evt.FuncID];
+                u64 start = Profiler.EventStart();
+                handler.Func(handler.Context, param);
+                Profiler.EventDone(i, start);
             }
         }
-        else if (mask & 0x1)
+        else
         {
-            if (SchedList[i].Timestamp <= SysTimestamp)
+            if (evt.Timestamp <= SysTimestamp)
             {
-                SchedList[i].Timestamp += offset;
+                evt.Timestamp += offset;
             }
         }
-
-        mask >>= 1;
     }
+
+    UpdateNextEvent();
 }
 
 template <bool EnableJIT>
 u32 NDS::RunFrame()
 {
+    ProfileScope frameScope(Profiler, Prof_Misc);
+
     FrameStartTimestamp = SysTimestamp;
 
     GPU.TotalScanlines = 0;
@@ -931,12 +1070,23 @@ u32 NDS::RunFrame()
             if (!(CPUStop & CPUStop_Wakeup))
             {
                 GPU.StartFrame();
+
+                if (InputHookLine >= 0 && InputHookFunc)
+                {
+                    CancelEvent(Event_InputHook);
+                    SchedList[Event_InputHook].Timestamp = SysTimestamp;
+                    ScheduleEvent(Event_InputHook, true, InputHookLine * kScanlineCycles, 0, 0);
+                }
             }
             CPUStop &= ~CPUStop_Wakeup;
 
             while (Running && GPU.TotalScanlines==0)
             {
-                u64 target = NextTarget();
+                u64 target;
+                {
+                    ProfileScope scope(Profiler, Prof_Scheduler);
+                    target = NextTarget();
+                }
                 ARM9Target = target << ARM9ClockShift;
                 CurCPU = 0;
 
@@ -945,10 +1095,13 @@ u32 NDS::RunFrame()
                     // GXFIFO stall
                     s32 cycles = GPU.GPU3D.CyclesToRunFor();
 
+                    u64 stallStart = ARM9Timestamp;
                     ARM9Timestamp = std::min(ARM9Target, ARM9Timestamp+(cycles<<ARM9ClockShift));
+                    Profiler.AddGXStall((ARM9Timestamp - stallStart) >> ARM9ClockShift);
                 }
                 else if (CPUStop & CPUStop_DMA9)
                 {
+                    ProfileScope scope(Profiler, Prof_DMA);
                     DMAs[0].Run();
                     if (!(CPUStop & CPUStop_GXStall)) DMAs[1].Run();
                     if (!(CPUStop & CPUStop_GXStall)) DMAs[2].Run();
@@ -961,6 +1114,7 @@ u32 NDS::RunFrame()
                 }
                 else
                 {
+                    ProfileScope scope(Profiler, Prof_ARM9);
 #ifdef JIT_ENABLED
                     if (EnableJIT)
                         ARM9.ExecuteJIT();
@@ -970,7 +1124,10 @@ u32 NDS::RunFrame()
                 }
 
                 RunTimers(0);
-                GPU.GPU3D.Run();
+                {
+                    ProfileScope scope(Profiler, Prof_GPU3D);
+                    GPU.GPU3D.Run();
+                }
 
                 target = ARM9Timestamp >> ARM9ClockShift;
                 CurCPU = 1;
@@ -981,6 +1138,7 @@ u32 NDS::RunFrame()
 
                     if (CPUStop & CPUStop_DMA7)
                     {
+                        ProfileScope scope(Profiler, Prof_DMA);
                         DMAs[4].Run();
                         DMAs[5].Run();
                         DMAs[6].Run();
@@ -993,6 +1151,7 @@ u32 NDS::RunFrame()
                     }
                     else
                     {
+                        ProfileScope scope(Profiler, Prof_ARM7);
 #ifdef JIT_ENABLED
                         if (EnableJIT)
                             ARM7.ExecuteJIT();
@@ -1004,7 +1163,10 @@ u32 NDS::RunFrame()
                     RunTimers(1);
                 }
 
-                RunSystem(target);
+                {
+                    ProfileScope scope(Profiler, Prof_Scheduler);
+                    RunSystem(target);
+                }
 
                 if (CPUStop & CPUStop_Sleep)
                 {
@@ -1033,6 +1195,8 @@ u32 NDS::RunFrame()
     if (LagFrameFlag)
         NumLagFrames++;
 
+    Profiler.EndFrame(SysTimestamp - FrameStartTimestamp);
+
     if (Running)
         return GPU.TotalScanlines;
     else
@@ -1043,7 +1207,11 @@ u32 NDS::RunFrame()
 {
 #ifdef JIT_ENABLED
     if (EnableJIT)
+    {
+        // blocks compiled in the background are put in place between frames
+        JIT.FinishCompiles();
         return RunFrame<true>();
+    }
     else
 #endif
         return RunFrame<false>();
@@ -1063,18 +1231,45 @@ void NDS::Reschedule(u64 target)
     }
 }
 
-void NDS::RegisterEventFunc(u32 id, u32 funcid, EventFunc func)
+const char* NDS::GetEventName(u32 id)
 {
+    switch (id)
+    {
+        case Event_LCD: return "LCD";
+        case Event_SPU: return "SPU";
+        case Event_Wifi: return "Wifi";
+        case Event_RTC: return "RTC";
+        case Event_DisplayFIFO: return "DisplayFIFO";
+        case Event_ROMTransfer: return "ROMTransfer";
+        case Event_ROMSPITransfer: return "ROMSPITransfer";
+        case Event_SPITransfer: return "SPITransfer";
+        case Event_Div: return "Div";
+        case Event_Sqrt: return "Sqrt";
+        case Event_DSi_SDMMCTransfer: return "DSi_SDMMCTransfer";
+        case Event_DSi_SDIOTransfer: return "DSi_SDIOTransfer";
+        case Event_DSi_NWifi: return "DSi_NWifi";
+        case Event_DSi_CamIRQ: return "DSi_CamIRQ";
+        case Event_DSi_CamTransfer: return "DSi_CamTransfer";
+        case Event_DSi_DSP: return "DSi_DSP";
+        case Event_InputHook: return "InputHook";
+        default: return "Unknown";
+    }
+}
+
+void NDS::RegisterEventFunc(u32 id, u32 funcid, EventHandler handler)
+{
+    assert(funcid < MaxEventFuncs);
     SchedEvent& evt = SchedList[id];
 
-    evt.Funcs[funcid] = func;
+    evt.Funcs[funcid] = handler;
 }
 
 void NDS::UnregisterEventFunc(u32 id, u32 funcid)
 {
+    assert(funcid < MaxEventFuncs);
     SchedEvent& evt = SchedList[id];
 
-    evt.Funcs.erase(funcid);
+    evt.Funcs[funcid] = {};
 }
 
 void NDS::ScheduleEvent(u32 id, bool periodic, s32 delay, u32 funcid, u32 param)
@@ -1101,6 +1296,8 @@ void NDS::ScheduleEvent(u32 id, bool periodic, s32 delay, u32 funcid, u32 param)
     evt.Param = param;
 
     SchedListMask |= (1<<id);
+    if (evt.Timestamp < SchedNextTimestamp)
+        SchedNextTimestamp = evt.Timestamp;
 
     Reschedule(evt.Timestamp);
 }
@@ -1108,6 +1305,7 @@ void NDS::ScheduleEvent(u32 id, bool periodic, s32 delay, u32 funcid, u32 param)
 void NDS::CancelEvent(u32 id)
 {
     SchedListMask &= ~(1<<id);
+    SchedNextDirty = true;
 }
 
 
@@ -1121,6 +1319,23 @@ void NDS::ReleaseScreen()
     SPI.GetTSC()->SetTouchCoords(0x000, 0xFFF);
 }
 
+void NDS::SetInputHook(int line, std::function<void()> func)
+{
+    if (line > 262) line = 262;
+
+    InputHookLine = line;
+    InputHookFunc = std::move(func);
+
+    if (InputHookLine < 0 || !InputHookFunc)
+        CancelEvent(Event_InputHook);
+}
+
+void NDS::InputHookDone(u32 param)
+{
+    if (InputHookFunc)
+        InputHookFunc();
+}
+
 
 void NDS::CheckKeyIRQ(u32 cpu, u32 oldkey, u32 newkey)
 {
@@ -1241,6 +1456,21 @@ void NDS::MapSharedWRAM(u8 val)
         SWRAM_ARM7.Mask = 0x7FFF;
         break;
     }
+
+    // either CPU might be running code from it
+    ARM9.SetupCodeMem(ARM9.R[15]);
+    ARM7.SetupCodeMem(ARM7.R[15]);
+
+    UpdateReadMap(0x03000000, 0x04000000);
+}
+
+void NDS::UpdateReadMap(u32 start, u32 end)
+{
+    for (u32 addr = start; addr < end; addr += 0x4000)
+    {
+        ARM9ReadMap[addr >> 14] = LookupARM9ReadPage(addr);
+        ARM7ReadMap[addr >> 14] = LookupARM7ReadPage(addr);
+    }
 }
 
 
@@ -1885,6 +2115,9 @@ void NDS::debug(u32 param)
 
 u8 NDS::ARM9Read8(u32 addr)
 {
+    if (u8* page = GetARM9ReadPage(addr))
+        return *(u8*)&page[addr & 0x3FFF];
+
     if ((addr & 0xFFFFF000) == 0xFFFF0000)
     {
         return *(u8*)&ARM9BIOS[addr & 0xFFF];
@@ -1946,6 +2179,9 @@ u16 NDS::ARM9Read16(u32 addr)
 {
     addr &= ~0x1;
 
+    if (u8* page = GetARM9ReadPage(addr))
+        return *(u16*)&page[addr & 0x3FFF];
+
     if ((addr & 0xFFFFF000) == 0xFFFF0000)
     {
         return *(u16*)&ARM9BIOS[addr & 0xFFF];
@@ -2006,6 +2242,9 @@ u32 NDS::ARM9Read32(u32 addr)
 {
     addr &= ~0x3;
 
+    if (u8* page = GetARM9ReadPage(addr))
+        return *(u32*)&page[addr & 0x3FFF];
+
     if ((addr & 0xFFFFF000) == 0xFFFF0000)
     {
         return *(u32*)&ARM9BIOS[addr & 0xFFF];
@@ -2072,6 +2311,7 @@ void NDS::ARM9Write8(u32 addr, u8 val)
     case 0x02000000:
         JIT.CheckAndInvalidate<0, ARMJIT_Memory::memregion_MainRAM>(addr);
         *(u8*)&MainRAM[addr & MainRAMMask] = val;
+        MarkMainRAMDirty(addr);
         return;
 
     case 0x03000000:
@@ -2079,6 +2319,7 @@ void NDS::ARM9Write8(u32 addr, u8 val)
         {
             JIT.CheckAndInvalidate<0, ARMJIT_Memory::memregion_SharedWRAM>(addr);
             *(u8*)&SWRAM_ARM9.Mem[addr & SWRAM_ARM9.Mask] = val;
+            MarkSharedWRAMDirty(SWRAM_ARM9, addr);
         }
         return;
 
@@ -2113,6 +2354,7 @@ void NDS::ARM9Write16(u32 addr, u16 val)
     case 0x02000000:
         JIT.CheckAndInvalidate<0, ARMJIT_Memory::memregion_MainRAM>(addr);
         *(u16*)&MainRAM[addr & MainRAMMask] = val;
+        MarkMainRAMDirty(addr);
         return;
 
     case 0x03000000:
@@ -2120,6 +2362,7 @@ void NDS::ARM9Write16(u32 addr, u16 val)
         {
             JIT.CheckAndInvalidate<0, ARMJIT_Memory::memregion_SharedWRAM>(addr);
             *(u16*)&SWRAM_ARM9.Mem[addr & SWRAM_ARM9.Mask] = val;
+            MarkSharedWRAMDirty(SWRAM_ARM9, addr);
         }
         return;
 
@@ -2173,6 +2416,7 @@ void NDS::ARM9Write32(u32 addr, u32 val)
     case 0x02000000:
         JIT.CheckAndInvalidate<0, ARMJIT_Memory::memregion_MainRAM>(addr);
         *(u32*)&MainRAM[addr & MainRAMMask] = val;
+        MarkMainRAMDirty(addr);
         return ;
 
     case 0x03000000:
@@ -2180,6 +2424,7 @@ void NDS::ARM9Write32(u32 addr, u32 val)
         {
             JIT.CheckAndInvalidate<0, ARMJIT_Memory::memregion_SharedWRAM>(addr);
             *(u32*)&SWRAM_ARM9.Mem[addr & SWRAM_ARM9.Mask] = val;
+            MarkSharedWRAMDirty(SWRAM_ARM9, addr);
         }
         return;
 
@@ -2261,6 +2506,9 @@ bool NDS::ARM9GetMemRegion(u32 addr, bool write, MemRegion* region)
 
 u8 NDS::ARM7Read8(u32 addr)
 {
+    if (u8* page = GetARM7ReadPage(addr))
+        return *(u8*)&page[addr & 0x3FFF];
+
     if (addr < 0x00004000)
     {
         // TODO: check the boundary? is it 4000 or higher on regular DS?
@@ -2329,6 +2577,9 @@ u16 NDS::ARM7Read16(u32 addr)
 {
     addr &= ~0x1;
 
+    if (u8* page = GetARM7ReadPage(addr))
+        return *(u16*)&page[addr & 0x3FFF];
+
     if (addr < 0x00004000)
     {
         if (ARM7.R[15] >= 0x00004000)
@@ -2395,6 +2646,9 @@ u32 NDS::ARM7Read32(u32 addr)
 {
     addr &= ~0x3;
 
+    if (u8* page = GetARM7ReadPage(addr))
+        return *(u32*)&page[addr & 0x3FFF];
+
     if (addr < 0x00004000)
     {
         if (ARM7.R[15] >= 0x00004000)
@@ -2468,6 +2722,7 @@ void NDS::ARM7Write8(u32 addr, u8 val)
     case 0x02800000:
         JIT.CheckAndInvalidate<1, ARMJIT_Memory::memregion_MainRAM>(addr);
         *(u8*)&MainRAM[addr & MainRAMMask] = val;
+        MarkMainRAMDirty(addr);
         return;
 
     case 0x03000000:
@@ -2475,18 +2730,21 @@ void NDS::ARM7Write8(u32 addr, u8 val)
         {
             JIT.CheckAndInvalidate<1, ARMJIT_Memory::memregion_SharedWRAM>(addr);
             *(u8*)&SWRAM_ARM7.Mem[addr & SWRAM_ARM7.Mask] = val;
+            MarkSharedWRAMDirty(SWRAM_ARM7, addr);
             return;
         }
         else
         {
             JIT.CheckAndInvalidate<1, ARMJIT_Memory::memregion_WRAM7>(addr);
             *(u8*)&ARM7WRAM[addr & (ARM7WRAMSize - 1)] = val;
+            MarkARM7WRAMDirty(addr);
             return;
         }
 
     case 0x03800000:
         JIT.CheckAndInvalidate<1, ARMJIT_Memory::memregion_WRAM7>(addr);
         *(u8*)&ARM7WRAM[addr & (ARM7WRAMSize - 1)] = val;
+        MarkARM7WRAMDirty(addr);
         return;
 
     case 0x04000000:
@@ -2527,6 +2785,7 @@ void NDS::ARM7Write16(u32 addr, u16 val)
     case 0x02800000:
         JIT.CheckAndInvalidate<1, ARMJIT_Memory::memregion_MainRAM>(addr);
         *(u16*)&MainRAM[addr & MainRAMMask] = val;
+        MarkMainRAMDirty(addr);
         return;
 
     case 0x03000000:
@@ -2534,18 +2793,21 @@ void NDS::ARM7Write16(u32 addr, u16 val)
         {
             JIT.CheckAndInvalidate<1, ARMJIT_Memory::memregion_SharedWRAM>(addr);
             *(u16*)&SWRAM_ARM7.Mem[addr & SWRAM_ARM7.Mask] = val;
+            MarkSharedWRAMDirty(SWRAM_ARM7, addr);
             return;
         }
         else
         {
             JIT.CheckAndInvalidate<1, ARMJIT_Memory::memregion_WRAM7>(addr);
             *(u16*)&ARM7WRAM[addr & (ARM7WRAMSize - 1)] = val;
+            MarkARM7WRAMDirty(addr);
             return;
         }
 
     case 0x03800000:
         JIT.CheckAndInvalidate<1, ARMJIT_Memory::memregion_WRAM7>(addr);
         *(u16*)&ARM7WRAM[addr & (ARM7WRAMSize - 1)] = val;
+        MarkARM7WRAMDirty(addr);
         return;
 
     case 0x04000000:
@@ -2597,6 +2859,7 @@ void NDS::ARM7Write32(u32 addr, u32 val)
     case 0x02800000:
         JIT.CheckAndInvalidate<1, ARMJIT_Memory::memregion_MainRAM>(addr);
         *(u32*)&MainRAM[addr & MainRAMMask] = val;
+        MarkMainRAMDirty(addr);
         return;
 
     case 0x03000000:
@@ -2604,18 +2867,21 @@ void NDS::ARM7Write32(u32 addr, u32 val)
         {
             JIT.CheckAndInvalidate<1, ARMJIT_Memory::memregion_SharedWRAM>(addr);
             *(u32*)&SWRAM_ARM7.Mem[addr & SWRAM_ARM7.Mask] = val;
+            MarkSharedWRAMDirty(SWRAM_ARM7, addr);
             return;
         }
         else
         {
             JIT.CheckAndInvalidate<1, ARMJIT_Memory::memregion_WRAM7>(addr);
             *(u32*)&ARM7WRAM[addr & (ARM7WRAMSize - 1)] = val;
+            MarkARM7WRAMDirty(addr);
             return;
         }
 
     case 0x03800000:
         JIT.CheckAndInvalidate<1, ARMJIT_Memory::memregion_WRAM7>(addr);
         *(u32*)&ARM7WRAM[addr & (ARM7WRAMSize - 1)] = val;
+        MarkARM7WRAMDirty(addr);
         return;
 
     case 0x04000000:
@@ -2706,6 +2972,48 @@ bool NDS::ARM7GetMemRegion(u32 addr, bool write, MemRegion* region)
     return false;
 }
 
+u8* NDS::LookupARM9ReadPage(u32 addr)
+{
+    switch (addr & 0xFF000000)
+    {
+    case 0x02000000:
+        return &MainRAM[addr & MainRAMMask];
+
+    case 0x03000000:
+        return SWRAM_ARM9.Mem ? &SWRAM_ARM9.Mem[addr & SWRAM_ARM9.Mask] : NULL;
+
+    case 0x06000000:
+        return GPU.GetARM9VRAMPage(addr);
+    }
+
+    return NULL;
+}
+
+u8* NDS::LookupARM7ReadPage(u32 addr)
+{
+    switch (addr & 0xFF800000)
+    {
+    case 0x02000000:
+    case 0x02800000:
+        return &MainRAM[addr & MainRAMMask];
+
+    case 0x03000000:
+        if (SWRAM_ARM7.Mem)
+            return &SWRAM_ARM7.Mem[addr & SWRAM_ARM7.Mask];
+        return &ARM7WRAM[addr & (ARM7WRAMSize - 1)];
+
+    case 0x03800000:
+        return &ARM7WRAM[addr & (ARM7WRAMSize - 1)];
+
+    case 0x06000000:
+    case 0x06800000:
+        return GPU.GetARM7VRAMPage(addr);
+    }
+
+    // the BIOS is left out, it depends on where the ARM7 is running from
+    return NULL;
+}
+
 
 
 
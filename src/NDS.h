@@ -42,6 +42,7 @@
 #include "CRC32.h"
 #include "DMA.h"
 #include "FreeBIOS.h"
+#include "FrameProfiler.h"
 
 // when touching the main loop/timing code, pls test a lot of shit
 // with this enabled, to make sure it doesn't desync
@@ -73,14 +74,35 @@ enum
     Event_DSi_CamTransfer,
     Event_DSi_DSP,
 
+    // frontend hook, not saved in savestates
+    Event_InputHook,
+
     Event_MAX
 };
+static_assert(Event_MAX <= kProfMaxEvents, "FrameProfiler can't count all the events");
+
+// events fire tens of thousands of times per second (LCD, SPU, wifi),
+// so they're plain function pointers, called with the object they belong to
+typedef void (*EventFunc)(void* context, u32 param);
+struct EventHandler
+{
+    EventFunc Func;
+    void* Context;
+};
+
+template <typename T, void (T::*Func)(u32)>
+void CallMemberEventFunc(void* context, u32 param)
+{
+    (static_cast<T*>(context)->*Func)(param);
+}
+#define MemberEventFunc(cls,func) EventHandler{&CallMemberEventFunc<cls, &cls::func>, this}
+
+// an event has a handful of functions at most (see the funcid enums)
+constexpr u32 MaxEventFuncs = 4;
 
-typedef std::function<void(u32)> EventFunc;
-#define MemberEventFunc(cls,func) std::bind(&cls::func,this,std::placeholders::_1)
 struct SchedEvent
 {
-    std::map<u32, EventFunc> Funcs;
+    EventHandler Funcs[MaxEventFuncs];
     u64 Timestamp;
     u32 FuncID;
     u32 Param;
@@ -242,6 +264,8 @@ public: // TODO: Encapsulate the rest of these members
     u32 NumLagFrames;
     bool LagFrameFlag;
 
+    FrameProfiler Profiler;
+
     // no need to worry about those overflowing, they can keep going for atleast 4350 years
     u64 ARM9Timestamp, ARM9Target;
     u64 ARM7Timestamp, ARM7Target;
@@ -305,6 +329,11 @@ public: // TODO: Encapsulate the rest of these members
     const u32 ARM7WRAMSize = 0x10000;
     u8* ARM7WRAM;
 
+    // host pointers to the 16K pages below 0x10000000 that can be read straight
+    // from memory, null where reads have to go through ARM9Read*/ARM7Read*
+    u8* ARM9ReadMap[0x10000000 >> 14] {};
+    u8* ARM7ReadMap[0x10000000 >> 14] {};
+
     virtual void Reset();
     void Start();
 
@@ -313,6 +342,64 @@ public: // TODO: Encapsulate the rest of these members
 
     bool DoSavestate(Savestate* file);
 
+    /// Saves the whole console into a state that's kept around, for features
+    /// that go back in time (run-ahead, rewind). Snapshots are incremental:
+    /// large arrays are kept in pages, shared with \c base where they didn't change.
+    /// Writes to main RAM, WRAM and VRAM are tracked, so when \c base is the last
+    /// snapshot saved or loaded, the pages nothing wrote to aren't even compared.
+    /// @param base A snapshot saved earlier, \c nullptr to share pages with
+    /// what the state held before (so the same state can be reused every frame).
+    bool SaveSnapshot(Savestate& state, const Savestate* base = nullptr);
+
+    /// Restores a snapshot saved by SaveSnapshot().
+    /// Unlike loading a regular savestate, this keeps the JIT's compiled code,
+    /// only dropping the blocks whose code differs in the snapshot, and doesn't
+    /// rebuild the memory timing tables if they didn't change since.
+    /// If it's the last snapshot saved or loaded, only the pages written since are copied back.
+    bool LoadSnapshot(Savestate& state);
+
+    /// Set while SaveSnapshot() or LoadSnapshot() runs.
+    [[nodiscard]] bool IsInSnapshot() const noexcept { return InSnapshot; }
+    [[nodiscard]] bool SnapshotKeepsMemTimings() const noexcept;
+
+    /// While saving or loading a snapshot, whether the pages marked as written are
+    /// relative to the snapshot the state expects (see Savestate::DirtyPagesBase()).
+    [[nodiscard]] bool SnapshotDirtyPagesValid(const Savestate& file) const noexcept
+    {
+        return InSnapshot && DirtyPagesBase != 0 && DirtyPagesBase == file.DirtyPagesBase();
+    }
+
+    // mark the pages written since the last snapshot
+    void MarkMainRAMDirty(u32 addr) noexcept
+    {
+        u32 page = (addr & MainRAMMask) >> Savestate::PAGE_SHIFT;
+        MainRAMDirty[page >> 6] |= 1ULL << (page & 0x3F);
+    }
+    void MarkSharedWRAMDirty(const MemRegion& region, u32 addr) noexcept
+    {
+        u32 page = ((region.Mem - SharedWRAM) + (addr & region.Mask)) >> Savestate::PAGE_SHIFT;
+        SharedWRAMDirty |= 1ULL << page;
+    }
+    void MarkARM7WRAMDirty(u32 addr) noexcept
+    {
+        ARM7WRAMDirty |= 1ULL << ((addr & (ARM7WRAMSize - 1)) >> Savestate::PAGE_SHIFT);
+    }
+
+    u8* GetARM9ReadPage(u32 addr) const noexcept
+    {
+        return (addr < 0x10000000) ? ARM9ReadMap[addr >> 14] : nullptr;
+    }
+    u8* GetARM7ReadPage(u32 addr) const noexcept
+    {
+        return (addr < 0x10000000) ? ARM7ReadMap[addr >> 14] : nullptr;
+    }
+
+    // has to be called whenever the memory between start and end is remapped
+    void UpdateReadMap(u32 start, u32 end);
+
+    // bumped whenever the memory timing tables are rebuilt
+    u32 MemTimingsVersion = 0;
+
     void SetARM9RegionTimings(u32 addrstart, u32 addrend, u32 region, int buswidth, int nonseq, int seq);
     void SetARM7RegionTimings(u32 addrstart, u32 addrend, u32 region, int buswidth, int nonseq, int seq);
 
@@ -390,16 +477,23 @@ public: // TODO: Encapsulate the rest of these members
 
     void SetKeyMask(u32 mask);
 
+    /// Calls func once per frame when the display reaches the given scanline,
+    /// so the frontend can feed input right before the game reads it
+    /// instead of only between frames.
+    /// A negative line (or an empty func) disables the hook.
+    void SetInputHook(int line, std::function<void()> func);
+
     bool IsLidClosed() const;
     void SetLidClosed(bool closed);
 
     virtual void CamInputFrame(int cam, const u32* data, int width, int height, bool rgb) {}
     void MicInputFrame(s16* data, int samples);
 
-    void RegisterEventFunc(u32 id, u32 funcid, EventFunc func);
+    void RegisterEventFunc(u32 id, u32 funcid, EventHandler handler);
     void UnregisterEventFunc(u32 id, u32 funcid);
     void ScheduleEvent(u32 id, bool periodic, s32 delay, u32 funcid, u32 param);
     void CancelEvent(u32 id);
+    static const char* GetEventName(u32 id);
 
     void debug(u32 p);
 
@@ -449,6 +543,10 @@ public: // TODO: Encapsulate the rest of these members
 
     virtual bool ARM7GetMemRegion(u32 addr, bool write, MemRegion* region);
 
+    // the page for ARM9ReadMap/ARM7ReadMap, only plain memory without side effects
+    virtual u8* LookupARM9ReadPage(u32 addr);
+    virtual u8* LookupARM7ReadPage(u32 addr);
+
     virtual u8 ARM9IORead8(u32 addr);
     virtual u16 ARM9IORead16(u32 addr);
     virtual u32 ARM9IORead32(u32 addr);
@@ -463,6 +561,14 @@ public: // TODO: Encapsulate the rest of these members
     virtual void ARM7IOWrite16(u32 addr, u16 val);
     virtual void ARM7IOWrite32(u32 addr, u32 val);
 
+    /// Turns the interpreter's idle loop skipping on or off for both CPUs,
+    /// see NDSArgs::IdleLoopSkipping.
+    void SetIdleLoopSkipping(bool enable) noexcept
+    {
+        ARM9.SetIdleLoopSkipping(enable);
+        ARM7.SetIdleLoopSkipping(enable);
+    }
+
 #ifdef JIT_ENABLED
     [[nodiscard]] bool IsJITEnabled() const noexcept { return EnableJIT; }
     void SetJITArgs(std::optional<JITArgs> args) noexcept;
@@ -474,6 +580,10 @@ public: // TODO: Encapsulate the rest of these members
 private:
     void InitTimings();
     u32 SchedListMask;
+    // no scheduled event is due before this. exact unless SchedNextDirty,
+    // which is set when events are cancelled or run
+    u64 SchedNextTimestamp = 0;
+    bool SchedNextDirty = true;
     u64 SysTimestamp;
     u8 WRAMCnt;
     u8 PostFlag9;
@@ -501,6 +611,19 @@ private:
     bool RunningGame;
     u64 LastSysClockCycles;
     u64 FrameStartTimestamp;
+    int InputHookLine = -1;
+    std::function<void()> InputHookFunc;
+    bool InSnapshot = false;
+    bool SnapshotTimingsMatch = false;
+
+    // written pages, since the snapshot DirtyPagesBase (0 = none)
+    u64 MainRAMDirty[melonDS::MainRAMMaxSize / Savestate::PAGE_SIZE / 64] {};
+    u64 SharedWRAMDirty = 0;
+    u64 ARM7WRAMDirty = 0;
+    u64 DirtyPagesBase = 0;
+
+    void ResetDirtyPages(u64 base) noexcept;
+    void UpdateNextEvent();
     u64 NextTarget();
     u64 NextTargetSleep();
     void CheckKeyIRQ(u32 cpu, u32 oldkey, u32 newkey);
@@ -512,6 +635,7 @@ private:
     void TimerStart(u32 id, u16 cnt);
     void StartDiv();
     void DivDone(u32 param);
+    void InputHookDone(u32 param);
     void SqrtDone(u32 param);
     void StartSqrt();
     void RunTimer(u32 tid, s32 cycles);
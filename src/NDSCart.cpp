@@ -459,7 +459,7 @@ void CartRetail::DoSavestate(Savestate* file)
     }
     if (SRAMLength)
     {
-        file->VarArray(SRAM.get(), SRAMLength);
+        file->PagedArray(SRAM.get(), SRAMLength);
     }
 
     // SPI status shito
@@ -404,6 +404,16 @@ void TSC::SetTouchCoords(u16 x, u16 y)
     NDS.KeyInput &= ~(1 << (16+6));
 }
 
+bool TSC::GetTouchCoords(u16& x, u16& y) const
+{
+    if (TouchY == 0xFFF)
+        return false;
+
+    x = TouchX >> 4;
+    y = TouchY >> 4;
+    return true;
+}
+
 void TSC::MicInputFrame(const s16* data, int samples)
 {
     if (!data)
@@ -121,6 +121,8 @@ public:
     virtual void DoSavestate(Savestate* file) override;
 
     virtual void SetTouchCoords(u16 x, u16 y);
+    // returns false if the screen isn't touched
+    virtual bool GetTouchCoords(u16& x, u16& y) const;
     virtual void MicInputFrame(const s16* data, int samples);
 
     virtual void Write(u8 val) override;
@@ -763,6 +763,8 @@ void SPUCaptureUnit::Run(s32 sample)
 
 void SPU::Mix(u32 dummy)
 {
+    ProfileScope scope(NDS.Profiler, Prof_SPU);
+
     s32 left = 0, right = 0;
     s32 leftoutput = 0, rightoutput = 0;
 
@@ -909,6 +911,12 @@ void SPU::Mix(u32 dummy)
 
 void SPU::TransferOutput()
 {
+    if (!OutputEnabled)
+    {
+        OutputBackbufferWritePosition = 0;
+        return;
+    }
+
     Platform::Mutex_Lock(AudioLock);
     for (u32 i = 0; i < OutputBackbufferWritePosition; i += 2)
     {
@@ -242,6 +242,10 @@ public:
     int ReadOutput(s16* data, int samples);
     void TransferOutput();
 
+    // while disabled, the frame's samples are thrown away instead of being
+    // queued for the frontend (for frames that are run but not shown)
+    void SetOutputEnabled(bool enable) { OutputEnabled = enable; }
+
     u8 Read8(u32 addr);
     u16 Read16(u32 addr);
     u32 Read32(u32 addr);
@@ -258,6 +262,7 @@ private:
     s16 OutputFrontBuffer[2 * OutputBufferSize] {};
     u32 OutputFrontBufferWritePosition = 0;
     u32 OutputFrontBufferReadPosition = 0;
+    bool OutputEnabled = true;
 
     Platform::Mutex* AudioLock;
 
@@ -17,6 +17,8 @@
 */
 
 #include <stdio.h>
+#include <algorithm>
+#include <atomic>
 #include <cassert>
 #include <cstring>
 #include "Savestate.h"
@@ -29,6 +31,8 @@ using Platform::LogLevel;
 
 static const char* SAVESTATE_MAGIC = "MELN";
 
+static std::atomic<u64> LastSnapshotID = 0;
+
 /*
     Savestate format
 
@@ -45,6 +49,14 @@ static const char* SAVESTATE_MAGIC = "MELN";
     08 - reserved
     0C - reserved
 
+    savestate files ("MELZ") store this compressed, split in chunks
+    along the sections, see frontend/SavestateFile.cpp
+
+    snapshots (only kept in memory):
+    the arrays saved with PagedArray() are replaced by their length and the
+    index of their first page, pages are kept separately and shared between
+    snapshots
+
     Implementation details
 
     version difference:
@@ -164,6 +176,10 @@ void Savestate::Section(const char* magic)
 
         CurSection = buffer_offset;
 
+        u32 sectionMagic;
+        memcpy(&sectionMagic, magic, sizeof(sectionMagic));
+        Sections.push_back({sectionMagic, buffer_offset, 0});
+
         // Write the new section's magic number
         VarArray((void*)magic, 4);
 
@@ -207,7 +223,7 @@ void Savestate::Bool32(bool* var)
     }
 }
 
-void Savestate::VarArray(void* data, u32 len)
+void Savestate::VarArraySlow(void* data, u32 len)
 {
     if (Error || finished) return;
 
@@ -250,12 +266,143 @@ void Savestate::VarArray(void* data, u32 len)
     buffer_offset += len;
 }
 
+void Savestate::PagedArray(void* data, u32 len, const u64* dirtyPages, const PageLoadCallback& onLoadPage)
+{
+    if (!Paged)
+    {
+        if (onLoadPage && !Saving)
+        {
+            if (const u8* incoming = Peek(len))
+                onLoadPage(0, incoming, len);
+        }
+
+        VarArray(data, len);
+        return;
+    }
+
+    if (Error || finished) return;
+
+    if (Saving)
+        SavePages(static_cast<const u8*>(data), len, dirtyPages);
+    else
+        LoadPages(static_cast<u8*>(data), len, dirtyPages, onLoadPage);
+}
+
+void Savestate::SavePages(const u8* data, u32 len, const u64* dirtyPages)
+{
+    u32 firstPage = Pages.size();
+    Var32(&len);
+    Var32(&firstPage);
+
+    // the base only has a matching array if it saved the same ones, in the same order
+    const PagedArrayInfo* base = nullptr;
+    u32 index = Arrays.size();
+    if (BaseArrays && index < BaseArrays->size())
+    {
+        const PagedArrayInfo& info = (*BaseArrays)[index];
+        if (info.Data == data && info.Length == len)
+            base = &info;
+    }
+    Arrays.push_back({data, len, firstPage});
+
+    for (u32 offset = 0, i = 0; offset < len; offset += PAGE_SIZE, i++)
+    {
+        u32 pagelen = std::min(PAGE_SIZE, len - offset);
+        const u8* src = &data[offset];
+
+        if (base)
+        {
+            const std::shared_ptr<Page>& basePage = (*BasePages)[base->FirstPage + i];
+
+            bool dirty;
+            if (dirtyPages)
+                dirty = dirtyPages[i >> 6] & (1ULL << (i & 0x3F));
+            else
+                dirty = memcmp(basePage->Data, src, pagelen) != 0;
+
+            if (!dirty)
+            {
+                Pages.push_back(basePage);
+                continue;
+            }
+
+            // saving over the base: its page can be reused if no other snapshot has it
+            if (BasePages == &OldPages && basePage.use_count() == 1)
+            {
+                memcpy(basePage->Data, src, pagelen);
+                Pages.push_back(basePage);
+                CopiedPages++;
+                continue;
+            }
+        }
+
+        std::shared_ptr<Page> page(new Page);
+        memcpy(page->Data, src, pagelen);
+        Pages.push_back(std::move(page));
+        CopiedPages++;
+    }
+}
+
+void Savestate::LoadPages(u8* data, u32 len, const u64* dirtyPages, const PageLoadCallback& onLoadPage)
+{
+    u32 savedlen = 0, firstPage = 0;
+    Var32(&savedlen);
+    Var32(&firstPage);
+    if (Error) return;
+
+    u32 numPages = (len + PAGE_SIZE - 1) >> PAGE_SHIFT;
+    if (savedlen != len || firstPage + numPages > Pages.size())
+    {
+        Log(LogLevel::Error, "savestate: %u-byte paged array doesn't match the snapshot (%u bytes)\n", len, savedlen);
+        Error = true;
+        return;
+    }
+
+    for (u32 offset = 0, i = 0; offset < len; offset += PAGE_SIZE, i++)
+    {
+        // not written since this snapshot was saved or loaded, it's already there
+        if (dirtyPages && !(dirtyPages[i >> 6] & (1ULL << (i & 0x3F))))
+            continue;
+
+        u32 pagelen = std::min(PAGE_SIZE, len - offset);
+        const u8* src = Pages[firstPage + i]->Data;
+
+        if (onLoadPage)
+            onLoadPage(offset, src, pagelen);
+        memcpy(&data[offset], src, pagelen);
+    }
+}
+
+const u8* Savestate::Peek(u32 len) const
+{
+    if (Saving || Error || finished) return nullptr;
+    if (buffer_offset + len > buffer_length) return nullptr;
+
+    return buffer + buffer_offset;
+}
+
 void Savestate::Finish()
 {
+    if (Saving && Paged)
+    {
+        // the pages that weren't reused go away with the old snapshot
+        BaseID = 0;
+        BasePages = nullptr;
+        BaseArrays = nullptr;
+        OldPages.clear();
+        OldArrays.clear();
+    }
+
     if (Error || finished) return;
     CloseCurrentSection();
     WriteStateLength();
     finished = true;
+
+    if (Saving)
+        SectionsIndexed = true;
+
+    if (Saving && Paged)
+        SnapshotID = ++LastSnapshotID;
 }
 
 void Savestate::Rewind(bool save)
@@ -266,6 +413,103 @@ void Savestate::Rewind(bool save)
 
     buffer_offset = 0;
     finished = false;
+
+    if (Saving)
+    {
+        // a regular state from now on, until BeginSnapshot()
+        Paged = false;
+        SnapshotID = 0;
+        Pages.clear();
+        Arrays.clear();
+        Sections.clear();
+        SectionsIndexed = false;
+
+        // so the buffer can be reused for a new state
+        WriteSavestateHeader();
+    }
+}
+
+void Savestate::BeginSnapshot(const Savestate* base)
+{
+    u64 baseID = base ? base->SnapshotID : 0;
+
+    // keep what this state held, it might be the base
+    OldPages = std::move(Pages);
+    OldArrays = std::move(Arrays);
+
+    Rewind(true);
+    Paged = true;
+    CopiedPages = 0;
+
+    BaseID = baseID;
+    if (baseID == 0)
+    {
+        BasePages = nullptr;
+        BaseArrays = nullptr;
+    }
+    else if (base == this)
+    {
+        BasePages = &OldPages;
+        BaseArrays = &OldArrays;
+    }
+    else
+    {
+        BasePages = &base->Pages;
+        BaseArrays = &base->Arrays;
+    }
+
+    if (BasePages)
+    {
+        Pages.reserve(BasePages->size());
+        Arrays.reserve(BaseArrays->size());
+    }
+}
+
+u8* Savestate::EditPage(u32 index)
+{
+    std::shared_ptr<Page>& page = Pages[index];
+    if (page.use_count() > 1)
+        page = std::make_shared<Page>(*page);
+
+    return page->Data;
+}
+
+bool Savestate::CopySnapshot(const Savestate& other, u32 length, u32 numPages)
+{
+    if (!buffer_owned || length < 16)
+        return false;
+
+    if (length > buffer_length && !Resize(length))
+        return false;
+
+    u32 copylen = std::min(length, other.StateLength());
+    memcpy(buffer, other.buffer, copylen);
+    memset(buffer + copylen, 0, buffer_length - copylen);
+
+    Pages.assign(other.Pages.begin(), other.Pages.begin() + std::min<size_t>(numPages, other.Pages.size()));
+    while (Pages.size() < numPages)
+        Pages.push_back(std::make_shared<Page>());
+
+    // only describes our pages if the arrays are laid out the same,
+    // otherwise the next snapshot based on this one just can't share them
+    if (numPages == other.Pages.size())
+        Arrays = other.Arrays;
+    else
+        Arrays.clear();
+
+    // the buffer is about to be edited into another state
+    Sections.clear();
+    SectionsIndexed = false;
+
+    Error = false;
+    Saving = false;
+    CurSection = NO_SECTION;
+    buffer_offset = length;
+    finished = true;
+    Paged = true;
+    CopiedPages = 0;
+    SnapshotID = ++LastSnapshotID;
+    return true;
 }
 
 void Savestate::CloseCurrentSection()
@@ -280,6 +524,7 @@ void Savestate::CloseCurrentSection()
         // Write the length in the section's header
         // (specifically the first 4 bytes after the magic number)
         memcpy(buffer + CurSection + 4, &section_length, sizeof(section_length));
+        Sections.back().Length = section_length;
 
         CurSection = NO_SECTION;
     }
@@ -342,39 +587,54 @@ void Savestate::WriteStateLength()
     memcpy(buffer + 0x08, &state_length, sizeof(state_length));
 }
 
-u32 Savestate::FindSection(const char* magic) const
+const std::vector<Savestate::SectionInfo>& Savestate::GetSections()
 {
-    if (!magic) return NO_SECTION;
+    if (!SectionsIndexed && !Saving)
+        IndexSections();
 
-    // Start looking at the savestate's beginning, right after its global header
-    // (we can't start from the current offset because then we'd lose the ability to rearrange sections)
-
-    for (u32 offset = 0x10; offset < buffer_length;)
-    { // Until we've found the desired section...
+    return Sections;
+}
 
-        // Get this section's magic number
-        char read_magic[4] = {0};
-        memcpy(read_magic, buffer + offset, sizeof(read_magic));
+void Savestate::IndexSections()
+{
+    Sections.clear();
+    SectionsIndexed = true;
 
-        if (memcmp(read_magic, magic, sizeof(read_magic)) == 0)
-        { // If this is the right section...
-            return offset + 16; // ...return the offset of the first byte of the section after the header
+    // the sections start right after the savestate's global header, each with its length
+    u32 end = std::min(buffer_length, StateLength());
+    for (u32 offset = 0x10; offset + 16 <= end;)
+    {
+        SectionInfo info;
+        memcpy(&info.Magic, buffer + offset, sizeof(info.Magic));
+        memcpy(&info.Length, buffer + offset + 4, sizeof(info.Length));
+        info.Offset = offset;
+
+        if (info.Length < 16)
+        { // A section that short can't be skipped, the rest of the state is garbage
+            Log(LogLevel::Error, "savestate: bad length %u for section at %#x\n", info.Length, offset);
+            break;
         }
 
-        // Haven't found our section yet. Let's move on to the next one.
-
-        u32 section_length_offset = offset + sizeof(read_magic);
-        if (section_length_offset >= buffer_length)
-        { // If trying to read the section length would take us past the file's end...
+        Sections.push_back(info);
+        if (info.Length > end - offset)
             break;
-        }
 
-        // First we need to find out how big this section is...
-        u32 section_length = 0;
-        memcpy(&section_length, buffer + section_length_offset, sizeof(section_length));
+        offset += info.Length;
+    }
+}
 
-        // ...then skip it. (The section length includes the 16-byte header.)
-        offset += section_length;
+u32 Savestate::FindSection(const char* magic)
+{
+    if (!magic) return NO_SECTION;
+
+    // Sections can be in any order, so look them up from the start
+    u32 wanted;
+    memcpy(&wanted, magic, sizeof(wanted));
+
+    for (const SectionInfo& info : GetSections())
+    {
+        if (info.Magic == wanted)
+            return info.Offset + 16; // the first byte of the section after the header
     }
 
     // We've reached the end of the file without finding the requested section...
@@ -20,7 +20,10 @@
 #define SAVESTATE_H
 
 #include <cstring>
+#include <functional>
+#include <memory>
 #include <string>
+#include <vector>
 #include <stdio.h>
 #include "types.h"
 
@@ -33,6 +36,21 @@ class Savestate
 {
 public:
     static constexpr u32 DEFAULT_SIZE = 32 * 1024 * 1024; // 32 MB
+
+    // granularity at which snapshots share the arrays saved with PagedArray()
+    static constexpr u32 PAGE_SHIFT = 12;
+    static constexpr u32 PAGE_SIZE = 1 << PAGE_SHIFT; // 4 KB
+
+    // offset of the page in its array, incoming data, length
+    using PageLoadCallback = std::function<void(u32, const u8*, u32)>;
+
+    struct SectionInfo
+    {
+        u32 Magic;
+        u32 Offset; // of the section header
+        u32 Length; // header included
+    };
+
     Savestate(void* buffer, u32 size, bool save);
     explicit Savestate(u32 initial_size = DEFAULT_SIZE);
 
@@ -46,6 +64,10 @@ public:
 
     void Section(const char* magic);
 
+    /// The sections of the state, in the order they're stored in the buffer.
+    /// Recorded as they're saved, or read from the buffer when loading.
+    [[nodiscard]] const std::vector<SectionInfo>& GetSections();
+
     void Var8(u8* var)
     {
         VarArray(var, sizeof(*var));
@@ -68,13 +90,86 @@ public:
 
     void Bool32(bool* var);
 
-    void VarArray(void* data, u32 len);
+    void VarArray(void* data, u32 len)
+    {
+        // states are made of lots of small variables, keep the common case inline
+        if (!Error && !finished && buffer_offset + len <= buffer_length)
+        {
+            if (Saving)
+                memcpy(buffer + buffer_offset, data, len);
+            else
+                memcpy(data, buffer + buffer_offset, len);
+
+            buffer_offset += len;
+            return;
+        }
+
+        VarArraySlow(data, len);
+    }
+
+    /// Saves or loads a large array, like VarArray().
+    ///
+    /// In snapshots (see BeginSnapshot()) the array is kept as pages outside of
+    /// the buffer instead, and the pages that didn't change are shared with the
+    /// snapshot this one is based on rather than copied.
+    ///
+    /// @param dirtyPages One bit per page, set for the pages written since
+    /// the snapshot returned by DirtyPagesBase(), so the others don't have to be
+    /// compared or copied. \c nullptr if that isn't tracked.
+    /// @param onLoadPage Called before data is loaded into the array, with the
+    /// offset and length of what's about to be overwritten and the incoming data.
+    void PagedArray(void* data, u32 len, const u64* dirtyPages = nullptr,
+                    const PageLoadCallback& onLoadPage = nullptr);
+
+    /// When loading, returns the next \c len bytes VarArray() would read,
+    /// without consuming them.
+    /// @returns \c nullptr if saving, or if there aren't that many bytes left.
+    [[nodiscard]] const u8* Peek(u32 len) const;
 
     void Finish();
 
-    // TODO rewinds the stream
+    // rewinds the stream, to load what was saved in it or to save over it
     void Rewind(bool save);
 
+    /// Rewinds the state to save a snapshot over it, a state that's only kept
+    /// in memory. Its pages are shared with \c base where they didn't change.
+    /// @param base A snapshot saved earlier, which can be this same state.
+    /// \c nullptr to copy everything.
+    void BeginSnapshot(const Savestate* base);
+
+    /// @returns \c true if this holds a snapshot that was saved successfully.
+    [[nodiscard]] bool IsSnapshot() const { return SnapshotID != 0; }
+
+    /// Identifies the snapshot held by this state, unique within the process.
+    [[nodiscard]] u64 GetSnapshotID() const { return SnapshotID; }
+
+    /// The snapshot that \c dirtyPages passed to PagedArray() must be relative to:
+    /// the base snapshot while saving, this one while loading.
+    [[nodiscard]] u64 DirtyPagesBase() const { return Saving ? BaseID : SnapshotID; }
+
+    /// Number of pages the last snapshot saved into this state had to copy,
+    /// as opposed to sharing them with its base.
+    [[nodiscard]] u32 NumCopiedPages() const { return CopiedPages; }
+    [[nodiscard]] u32 NumPages() const { return Pages.size(); }
+
+    /// Direct access to a snapshot's pages, to store it some other way.
+    [[nodiscard]] const u8* GetPage(u32 index) const { return Pages[index]->Data; }
+    [[nodiscard]] bool SharesPage(u32 index, const Savestate& other) const
+    {
+        return index < other.Pages.size() && Pages[index] == other.Pages[index];
+    }
+
+    /// @returns The page, for writing. It's copied first if other snapshots have it too.
+    u8* EditPage(u32 index);
+
+    /// Turns this state into a copy of another snapshot, whose pages are
+    /// shared until EditPage(), to be edited into a different snapshot.
+    /// @param length Length of the new state, copied from \c other as far as
+    /// it goes and zero-filled after that.
+    /// @param numPages Number of pages, the ones \c other doesn't have are zero-filled.
+    /// @returns \c false if the buffer couldn't be allocated.
+    bool CopySnapshot(const Savestate& other, u32 length, u32 numPages);
+
     bool IsAtLeastVersion(u32 major, u32 minor)
     {
         u16 major_version = MajorVersion();
@@ -90,6 +185,15 @@ public:
 
     [[nodiscard]] u32 Length() const { return buffer_offset; }
 
+    /// Length of the state as written in its header, set once it's finished saving.
+    [[nodiscard]] u32 StateLength() const
+    {
+        // length is stored at offset 0x08
+        u32 length = 0;
+        memcpy(&length, buffer + 0x08, sizeof(length));
+        return length;
+    }
+
     [[nodiscard]] u16 MajorVersion() const
     {
         // major version is stored at offset 0x04
@@ -108,16 +212,52 @@ public:
 
 private:
     static constexpr u32 NO_SECTION = 0xffffffff;
+
+    struct Page
+    {
+        u8 Data[PAGE_SIZE];
+    };
+
+    struct PagedArrayInfo
+    {
+        const void* Data;
+        u32 Length;
+        u32 FirstPage;
+    };
+
+    void SavePages(const u8* data, u32 len, const u64* dirtyPages);
+    void LoadPages(u8* data, u32 len, const u64* dirtyPages, const PageLoadCallback& onLoadPage);
+
     void CloseCurrentSection();
+    void IndexSections();
+    void VarArraySlow(void* data, u32 len);
     bool Resize(u32 new_length);
     void WriteSavestateHeader();
     void WriteStateLength();
-    u32 FindSection(const char* magic) const;
+    u32 FindSection(const char* magic);
     u8* buffer;
     u32 buffer_offset;
     u32 buffer_length;
     bool buffer_owned;
     bool finished;
+
+    // so loading doesn't have to walk the buffer for every section
+    std::vector<SectionInfo> Sections;
+    bool SectionsIndexed = false;
+
+    bool Paged = false;
+    u64 SnapshotID = 0;
+    std::vector<std::shared_ptr<Page>> Pages;
+    std::vector<PagedArrayInfo> Arrays;
+    u32 CopiedPages = 0;
+
+    // only while saving a snapshot: what it's based on,
+    // and what this state held before, to reuse the pages
+    u64 BaseID = 0;
+    const std::vector<std::shared_ptr<Page>>* BasePages = nullptr;
+    const std::vector<PagedArrayInfo>* BaseArrays = nullptr;
+    std::vector<std::shared_ptr<Page>> OldPages;
+    std::vector<PagedArrayInfo> OldArrays;
 };
 }
 
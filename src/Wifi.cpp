@@ -228,7 +228,7 @@ void Wifi::DoSavestate(Savestate* file)
     // also: savestate and wifi can't fucking work together!!
     // or it can but you would be disconnected
 
-    file->VarArray(RAM, 0x2000);
+    file->PagedArray(RAM, 0x2000);
     file->VarArray(IO, 0x1000);
 
     file->Bool32(&Enabled);
@@ -0,0 +1,367 @@
+/*
+    Copyright 2016-2023 melonDS team
+
+    This file is part of melonDS.
+
+    melonDS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS. If not, see http://www.gnu.org/licenses/.
+*/
+
+#include <string.h>
+
+#include <algorithm>
+
+#include "InputMovie.h"
+#include "NDS.h"
+#include "Platform.h"
+#include "Savestate.h"
+
+#define XXH_STATIC_LINKING_ONLY
+#include "xxhash/xxhash.h"
+
+using namespace melonDS;
+using Platform::Log;
+using Platform::LogLevel;
+
+namespace Frontend
+{
+
+// file layout (little endian):
+//
+// header
+//   00  "MMOV"
+//   04  version
+//   08  number of frames
+//   0C  length of the starting savestate
+// starting savestate
+// frames, each:
+//   u8 flags (bit0 = screen touched, bit1 = memory writes follow)
+//   u16 key mask, same layout as NDS::SetKeyMask()
+//   [u8 touch X, u8 touch Y]
+//   [u8 number of writes, then each: s16 scanline, u8 size, u32 address, u32 value]
+//   u64 framebuffer hash
+
+const u32 kMovieMagic = 0x564F4D4D; // MMOV
+const u32 kMovieVersion = 1;
+
+enum
+{
+    frameFlag_Touching = (1<<0),
+    frameFlag_Writes = (1<<1),
+};
+
+
+InputMovie::InputMovie() noexcept
+{
+    CurStatus = status_Idle;
+    StartStateLength = 0;
+    CurFrame = 0;
+    DesyncFrame = 0;
+}
+
+bool InputMovie::StartRecording(NDS& nds, const std::string& path)
+{
+    Stop();
+
+    Savestate state;
+    if (state.Error)
+        return false;
+
+    nds.DoSavestate(&state);
+    if (state.Error)
+        return false;
+
+    StartStateLength = state.Length();
+    StartState = std::make_unique<u8[]>(StartStateLength);
+    memcpy(StartState.get(), state.Buffer(), StartStateLength);
+
+    RecordPath = path;
+    Frames.clear();
+    Current = {};
+    CurFrame = 0;
+    CurStatus = status_Recording;
+    return true;
+}
+
+bool InputMovie::StartPlayback(NDS& nds, const std::string& path)
+{
+    Stop();
+
+    if (!Load(path))
+        return false;
+
+    Savestate state(StartState.get(), StartStateLength, false);
+    if (state.Error || !nds.DoSavestate(&state) || state.Error)
+    {
+        Log(LogLevel::Error, "InputMovie: failed to load the starting state of %s\n", path.c_str());
+        return false;
+    }
+
+    CurFrame = 0;
+    DesyncFrame = 0;
+    CurStatus = Frames.empty() ? status_Finished : status_Playing;
+    return true;
+}
+
+bool InputMovie::Stop()
+{
+    bool ret = true;
+    if (CurStatus == status_Recording)
+        ret = Save(RecordPath);
+
+    if (CurStatus == status_Recording || CurStatus == status_Playing)
+        CurStatus = status_Idle;
+
+    return ret;
+}
+
+void InputMovie::RecordWrite(int line, u32 addr, u32 val, u8 size)
+{
+    if (CurStatus != status_Recording)
+        return;
+
+    Current.Writes.push_back({(s16)line, size, addr, val});
+}
+
+void InputMovie::BeginFrame(NDS& nds)
+{
+    if (CurStatus == status_Recording)
+    {
+        Current.Keys = (nds.KeyInput & 0x3FF) | (((nds.KeyInput >> 16) & 0x3) << 10);
+
+        u16 x, y;
+        Current.Touching = nds.SPI.GetTSC()->GetTouchCoords(x, y);
+        Current.TouchX = Current.Touching ? x : 0;
+        Current.TouchY = Current.Touching ? y : 0;
+    }
+    else if (CurStatus == status_Playing)
+    {
+        const Frame& frame = Frames[CurFrame];
+
+        nds.SetKeyMask(frame.Keys);
+        if (frame.Touching)
+            nds.TouchScreen(frame.TouchX, frame.TouchY);
+        else
+            nds.ReleaseScreen();
+
+        // the input hook only has one line per frame, which is all
+        // the frontend ever uses, so the first late write decides it
+        int hookLine = -1;
+        for (const MemWrite& write : frame.Writes)
+        {
+            if (write.Line < 0)
+                ApplyWrite(nds, write);
+            else if (hookLine < 0)
+                hookLine = write.Line;
+        }
+
+        if (hookLine >= 0)
+        {
+            nds.SetInputHook(hookLine, [this, &nds]()
+            {
+                for (const MemWrite& write : Frames[CurFrame].Writes)
+                {
+                    if (write.Line >= 0)
+                        ApplyWrite(nds, write);
+                }
+            });
+        }
+        else
+            nds.SetInputHook(-1, nullptr);
+    }
+}
+
+void InputMovie::EndFrame(NDS& nds)
+{
+    if (CurStatus == status_Recording)
+    {
+        Current.Hash = HashFramebuffers(nds);
+        Frames.push_back(std::move(Current));
+        Current = {};
+        CurFrame++;
+    }
+    else if (CurStatus == status_Playing)
+    {
+        if (HashFramebuffers(nds) != Frames[CurFrame].Hash)
+        {
+            Log(LogLevel::Warn, "InputMovie: desync at frame %u\n", CurFrame);
+            DesyncFrame = CurFrame;
+            CurStatus = status_Desync;
+        }
+        else if (++CurFrame >= Frames.size())
+            CurStatus = status_Finished;
+
+        if (CurStatus != status_Playing)
+            nds.SetInputHook(-1, nullptr);
+    }
+}
+
+u64 InputMovie::HashFramebuffers(NDS& nds)
+{
+    int fbsize;
+    if (nds.GPU.GPU3D.IsRendererAccelerated())
+        fbsize = (256*3 + 1) * 192;
+    else
+        fbsize = 256 * 192;
+
+    int front = nds.GPU.FrontBuffer;
+    u64 hash = XXH3_64bits(nds.GPU.Framebuffer[front][0].get(), fbsize*4);
+    return XXH3_64bits_withSeed(nds.GPU.Framebuffer[front][1].get(), fbsize*4, hash);
+}
+
+void InputMovie::ApplyWrite(NDS& nds, const MemWrite& write)
+{
+    switch (write.Size)
+    {
+    case 1: nds.ARM9Write8(write.Addr, write.Value); break;
+    case 2: nds.ARM9Write16(write.Addr, write.Value); break;
+    case 4: nds.ARM9Write32(write.Addr, write.Value); break;
+    }
+}
+
+bool InputMovie::Save(const std::string& path)
+{
+    std::vector<u8> data;
+    auto put = [&data](const void* ptr, size_t len)
+    {
+        const u8* bytes = (const u8*)ptr;
+        data.insert(data.end(), bytes, bytes + len);
+    };
+
+    u32 header[4] = {kMovieMagic, kMovieVersion, (u32)Frames.size(), StartStateLength};
+    put(header, sizeof(header));
+    put(StartState.get(), StartStateLength);
+
+    for (const Frame& frame : Frames)
+    {
+        u8 flags = 0;
+        if (frame.Touching) flags |= frameFlag_Touching;
+        if (!frame.Writes.empty()) flags |= frameFlag_Writes;
+
+        put(&flags, 1);
+        put(&frame.Keys, 2);
+
+        if (frame.Touching)
+        {
+            put(&frame.TouchX, 1);
+            put(&frame.TouchY, 1);
+        }
+
+        if (!frame.Writes.empty())
+        {
+            // the frontend writes a couple values per frame at most
+            u8 count = std::min<size_t>(frame.Writes.size(), 255);
+            put(&count, 1);
+            for (u32 i = 0; i < count; i++)
+            {
+                const MemWrite& write = frame.Writes[i];
+                put(&write.Line, 2);
+                put(&write.Size, 1);
+                put(&write.Addr, 4);
+                put(&write.Value, 4);
+            }
+        }
+
+        put(&frame.Hash, 8);
+    }
+
+    Platform::FileHandle* file = Platform::OpenFile(path, Platform::FileMode::Write);
+    if (!file)
+    {
+        Log(LogLevel::Error, "InputMovie: failed to open %s for writing\n", path.c_str());
+        return false;
+    }
+
+    bool ok = Platform::FileWrite(data.data(), data.size(), 1, file) == 1;
+    Platform::CloseFile(file);
+    return ok;
+}
+
+bool InputMovie::Load(const std::string& path)
+{
+    Platform::FileHandle* file = Platform::OpenFile(path, Platform::FileMode::Read);
+    if (!file)
+    {
+        Log(LogLevel::Error, "InputMovie: failed to open %s\n", path.c_str());
+        return false;
+    }
+
+    u64 len = Platform::FileLength(file);
+    std::vector<u8> data(len);
+    bool ok = len > 0 && Platform::FileRead(data.data(), len, 1, file) == 1;
+    Platform::CloseFile(file);
+    if (!ok)
+        return false;
+
+    size_t pos = 0;
+    auto get = [&](void* ptr, size_t n) -> bool
+    {
+        if (pos + n > data.size()) return false;
+        memcpy(ptr, &data[pos], n);
+        pos += n;
+        return true;
+    };
+
+    u32 header[4];
+    if (!get(header, sizeof(header)) || header[0] != kMovieMagic)
+    {
+        Log(LogLevel::Error, "InputMovie: %s is not a movie file\n", path.c_str());
+        return false;
+    }
+    if (header[1] != kMovieVersion)
+    {
+        Log(LogLevel::Error, "InputMovie: %s has unsupported version %u\n", path.c_str(), header[1]);
+        return false;
+    }
+
+    StartStateLength = header[3];
+    StartState = std::make_unique<u8[]>(StartStateLength);
+    if (!get(StartState.get(), StartStateLength))
+        return false;
+
+    Frames.clear();
+    Frames.reserve(header[2]);
+    for (u32 i = 0; i < header[2]; i++)
+    {
+        Frame frame {};
+        u8 flags;
+        ok = get(&flags, 1) && get(&frame.Keys, 2);
+
+        frame.Touching = flags & frameFlag_Touching;
+        if (ok && frame.Touching)
+            ok = get(&frame.TouchX, 1) && get(&frame.TouchY, 1);
+
+        if (ok && (flags & frameFlag_Writes))
+        {
+            u8 count;
+            ok = get(&count, 1);
+            for (u32 j = 0; ok && j < count; j++)
+            {
+                MemWrite write;
+                ok = get(&write.Line, 2) && get(&write.Size, 1) && get(&write.Addr, 4) && get(&write.Value, 4);
+                frame.Writes.push_back(write);
+            }
+        }
+
+        if (!ok || !get(&frame.Hash, 8))
+        {
+            Log(LogLevel::Error, "InputMovie: %s is truncated at frame %u\n", path.c_str(), i);
+            return false;
+        }
+
+        Frames.push_back(std::move(frame));
+    }
+
+    return true;
+}
+
+}
@@ -0,0 +1,130 @@
+/*
+    Copyright 2016-2023 melonDS team
+
+    This file is part of melonDS.
+
+    melonDS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS. If not, see http://www.gnu.org/licenses/.
+*/
+
+#ifndef INPUTMOVIE_H
+#define INPUTMOVIE_H
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "types.h"
+
+namespace melonDS
+{
+class NDS;
+}
+
+namespace Frontend
+{
+using namespace melonDS;
+
+// Per-frame input log, recorded from a savestate so it can be played back
+// bit-for-bit: key mask, touchscreen state, and the memory writes the
+// frontend injects (Metroid aim), along with the scanline they happened at.
+// Every frame also stores a hash of the displayed framebuffers, so playback
+// can tell exactly where it stopped matching.
+//
+// Usage, around every NDS::RunFrame():
+//   BeginFrame() right before, once the frame's keys and touch are set
+//   RecordWrite() for every injected write, before or during the frame
+//   EndFrame() right after
+//
+// Framebuffer hashes only match between runs using the same 3D renderer
+// (the software one is the only one that's deterministic across machines).
+class InputMovie
+{
+public:
+    enum Status
+    {
+        status_Idle,
+        status_Recording,
+        status_Playing,
+        status_Finished, // playback reached the end, all frames matched
+        status_Desync,   // playback produced a different frame
+    };
+
+    InputMovie() noexcept;
+
+    // snapshots the current state, the movie starts with the next frame
+    // and is written to path when stopped
+    bool StartRecording(NDS& nds, const std::string& path);
+
+    // loads the movie and its starting state into the console,
+    // which must be running the same game
+    bool StartPlayback(NDS& nds, const std::string& path);
+
+    // ends recording or playback, and writes the file if we were recording
+    bool Stop();
+
+    Status GetStatus() const { return CurStatus; }
+    bool IsRecording() const { return CurStatus == status_Recording; }
+    bool IsPlaying() const { return CurStatus == status_Playing; }
+
+    u32 GetNumFrames() const { return Frames.size(); }
+    u32 GetCurrentFrame() const { return CurFrame; }
+
+    // frame (relative to the movie start) that didn't match, if status_Desync
+    u32 GetDesyncFrame() const { return DesyncFrame; }
+
+    // line = scanline during which the write happened, -1 = before the frame
+    void RecordWrite(int line, u32 addr, u32 val, u8 size);
+
+    void BeginFrame(NDS& nds);
+    void EndFrame(NDS& nds);
+
+    static u64 HashFramebuffers(NDS& nds);
+
+private:
+    struct MemWrite
+    {
+        s16 Line;
+        u8 Size;
+        u32 Addr;
+        u32 Value;
+    };
+
+    struct Frame
+    {
+        u16 Keys;
+        bool Touching;
+        u8 TouchX, TouchY;
+        std::vector<MemWrite> Writes;
+        u64 Hash;
+    };
+
+    void ApplyWrite(NDS& nds, const MemWrite& write);
+
+    bool Save(const std::string& path);
+    bool Load(const std::string& path);
+
+    Status CurStatus;
+    std::string RecordPath;
+
+    std::unique_ptr<u8[]> StartState;
+    u32 StartStateLength;
+
+    std::vector<Frame> Frames;
+    Frame Current;
+    u32 CurFrame;
+    u32 DesyncFrame;
+};
+
+}
+
+#endif // INPUTMOVIE_H
@@ -0,0 +1,351 @@
+/*
+    Copyright 2016-2023 melonDS team
+
+    This file is part of melonDS.
+
+    melonDS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS. If not, see http://www.gnu.org/licenses/.
+*/
+
+#include <string.h>
+
+#include <algorithm>
+
+#include "RewindBuffer.h"
+#include "NDS.h"
+#include "Platform.h"
+#include "Savestate.h"
+
+using namespace melonDS;
+using Platform::Log;
+using Platform::LogLevel;
+
+namespace Frontend
+{
+
+// XOR deltas are mostly zeros: encoded as runs of
+//   varint number of zero bytes, varint number of literal bytes, literal bytes
+// until the expected length is covered. zero runs shorter than this
+// are cheaper to leave in the literals
+const u32 kMinZeroRun = 4;
+
+static void PutVarint(std::vector<u8>& out, u32 val)
+{
+    while (val >= 0x80)
+    {
+        out.push_back((val & 0x7F) | 0x80);
+        val >>= 7;
+    }
+    out.push_back(val);
+}
+
+static bool GetVarint(const u8*& in, const u8* end, u32& val)
+{
+    val = 0;
+    for (int shift = 0; shift < 35; shift += 7)
+    {
+        if (in >= end) return false;
+        u8 b = *in++;
+        val |= (u32)(b & 0x7F) << shift;
+        if (!(b & 0x80)) return true;
+    }
+    return false;
+}
+
+
+RewindBuffer::RewindBuffer() noexcept
+{
+    Interval = 30;
+    Budget = 64 * 1024 * 1024;
+    FramesSinceSnapshot = 0;
+
+    HistorySize = 0;
+    NewestSize = 0;
+    Busy = false;
+    Quit = false;
+}
+
+RewindBuffer::~RewindBuffer()
+{
+    if (Worker.joinable())
+    {
+        {
+            std::lock_guard<std::mutex> lock(Lock);
+            Jobs.clear();
+            Quit = true;
+        }
+        WorkCond.notify_one();
+        Worker.join();
+    }
+}
+
+void RewindBuffer::Update(NDS& nds)
+{
+    if (++FramesSinceSnapshot < Interval)
+        return;
+    FramesSinceSnapshot = 0;
+
+    // about the size of the last one, so the buffer doesn't have to grow
+    u32 size = Newest ? Newest->StateLength() + 0x10000 : Savestate::DEFAULT_SIZE;
+    auto state = std::make_shared<Savestate>(size);
+    if (state->Error)
+        return;
+
+    // pages that didn't change since the newest snapshot are shared with it
+    if (!nds.SaveSnapshot(*state, Newest.get()))
+    {
+        Log(LogLevel::Warn, "RewindBuffer: failed to snapshot the console\n");
+        return;
+    }
+
+    if (!Worker.joinable())
+        Worker = std::thread(&RewindBuffer::WorkerFunc, this);
+
+    {
+        std::lock_guard<std::mutex> lock(Lock);
+        if (Newest)
+            Jobs.push_back({std::move(Newest), state});
+
+        Newest = std::move(state);
+        NewestSize = RawSize(*Newest);
+    }
+    WorkCond.notify_one();
+}
+
+bool RewindBuffer::StepBack(NDS& nds)
+{
+    std::unique_lock<std::mutex> lock(Lock);
+    WaitIdle(lock);
+
+    if (!Newest)
+        return false;
+
+    if (!nds.LoadSnapshot(*Newest))
+    {
+        Log(LogLevel::Error, "RewindBuffer: failed to load snapshot\n");
+        History.clear();
+        HistorySize = 0;
+        Newest = nullptr;
+        NewestSize = 0;
+        return false;
+    }
+
+    FramesSinceSnapshot = 0;
+
+    // the oldest snapshot stays, going back again lands on it again
+    if (History.empty())
+        return true;
+
+    std::shared_ptr<Savestate> prev = Decode(History.back(), *Newest);
+    HistorySize -= History.back().Data.size();
+    History.pop_back();
+
+    if (!prev)
+    {
+        Log(LogLevel::Error, "RewindBuffer: failed to decode snapshot, history dropped\n");
+        History.clear();
+        HistorySize = 0;
+    }
+    else
+    {
+        Newest = std::move(prev);
+        NewestSize = RawSize(*Newest);
+    }
+
+    return true;
+}
+
+void RewindBuffer::Clear()
+{
+    std::unique_lock<std::mutex> lock(Lock);
+    Jobs.clear();
+    WaitIdle(lock);
+
+    History.clear();
+    HistorySize = 0;
+    Newest = nullptr;
+    NewestSize = 0;
+    FramesSinceSnapshot = 0;
+}
+
+bool RewindBuffer::IsEmpty()
+{
+    std::lock_guard<std::mutex> lock(Lock);
+    return !Newest;
+}
+
+u32 RewindBuffer::GetNumStates()
+{
+    std::lock_guard<std::mutex> lock(Lock);
+    if (!Newest) return 0;
+    return History.size() + Jobs.size() + (Busy ? 1 : 0) + 1;
+}
+
+u64 RewindBuffer::GetMemoryUsage()
+{
+    std::lock_guard<std::mutex> lock(Lock);
+    return HistorySize + NewestSize;
+}
+
+void RewindBuffer::WaitIdle(std::unique_lock<std::mutex>& lock)
+{
+    IdleCond.wait(lock, [this] { return Jobs.empty() && !Busy; });
+}
+
+void RewindBuffer::TrimHistory()
+{
+    while (!History.empty() && HistorySize + NewestSize > Budget)
+    {
+        HistorySize -= History.front().Data.size();
+        History.pop_front();
+    }
+}
+
+void RewindBuffer::WorkerFunc()
+{
+    std::unique_lock<std::mutex> lock(Lock);
+    for (;;)
+    {
+        WorkCond.wait(lock, [this] { return Quit || !Jobs.empty(); });
+        if (Quit) break;
+
+        Job job = std::move(Jobs.front());
+        Jobs.pop_front();
+        Busy = true;
+
+        lock.unlock();
+        Delta delta = Encode(*job.Older, *job.Newer);
+        job = {};
+        lock.lock();
+
+        HistorySize += delta.Data.size();
+        History.push_back(std::move(delta));
+        TrimHistory();
+
+        Busy = false;
+        if (Jobs.empty())
+            IdleCond.notify_all();
+    }
+}
+
+u64 RewindBuffer::RawSize(const Savestate& state)
+{
+    return state.StateLength() + (u64)state.NumPages() * Savestate::PAGE_SIZE;
+}
+
+RewindBuffer::Delta RewindBuffer::Encode(const Savestate& older, const Savestate& newer)
+{
+    Delta delta;
+    delta.Length = older.StateLength();
+    delta.NumPages = older.NumPages();
+
+    // mostly the 3D engine's state, it changes every frame
+    EncodeXOR(delta.Data, (const u8*)older.Buffer(), (const u8*)newer.Buffer(),
+              newer.StateLength(), delta.Length);
+
+    // pages the newer snapshot shares didn't change in between, which is most of them
+    for (u32 i = 0; i < delta.NumPages; i++)
+    {
+        if (older.SharesPage(i, newer))
+            continue;
+
+        bool inNewer = i < newer.NumPages();
+        delta.Pages.push_back(i);
+        EncodeXOR(delta.Data, older.GetPage(i), inNewer ? newer.GetPage(i) : nullptr,
+                  inNewer ? Savestate::PAGE_SIZE : 0, Savestate::PAGE_SIZE);
+    }
+
+    delta.Data.shrink_to_fit();
+    return delta;
+}
+
+std::shared_ptr<Savestate> RewindBuffer::Decode(const Delta& delta, const Savestate& newer)
+{
+    auto state = std::make_shared<Savestate>(delta.Length);
+    if (state->Error || !state->CopySnapshot(newer, delta.Length, delta.NumPages))
+        return nullptr;
+
+    const u8* in = delta.Data.data();
+    const u8* end = in + delta.Data.size();
+
+    if (!DecodeXOR((u8*)state->Buffer(), delta.Length, in, end))
+        return nullptr;
+
+    for (u32 index : delta.Pages)
+    {
+        if (!DecodeXOR(state->EditPage(index), Savestate::PAGE_SIZE, in, end))
+            return nullptr;
+    }
+
+    return state;
+}
+
+void RewindBuffer::EncodeXOR(std::vector<u8>& out, const u8* data, const u8* ref, u32 reflen, u32 len)
+{
+    auto delta = [=](u32 i) -> u8 { return i < reflen ? data[i] ^ ref[i] : data[i]; };
+
+    u32 i = 0;
+    while (i < len)
+    {
+        u32 zeroStart = i;
+        u32 common = std::min(len, reflen);
+        while (i + 8 <= common && !memcmp(&data[i], &ref[i], 8))
+            i += 8;
+        while (i < len && delta(i) == 0)
+            i++;
+
+        u32 litStart = i;
+        u32 zeros = 0;
+        while (i < len)
+        {
+            if (delta(i) != 0)
+                zeros = 0;
+            else if (++zeros >= kMinZeroRun)
+                break;
+            i++;
+        }
+        // the zeros at the end go into the next run
+        u32 litEnd = (i < len) ? i + 1 - zeros : i - zeros;
+
+        PutVarint(out, litStart - zeroStart);
+        PutVarint(out, litEnd - litStart);
+        for (u32 j = litStart; j < litEnd; j++)
+            out.push_back(delta(j));
+
+        i = litEnd;
+    }
+}
+
+bool RewindBuffer::DecodeXOR(u8* data, u32 len, const u8*& in, const u8* end)
+{
+    u32 pos = 0;
+    while (pos < len)
+    {
+        u32 zeros, literals;
+        if (!GetVarint(in, end, zeros) || !GetVarint(in, end, literals))
+            return false;
+
+        if (zeros > len - pos) return false;
+        pos += zeros;
+
+        if (literals > len - pos || literals > (u32)(end - in)) return false;
+        for (u32 j = 0; j < literals; j++)
+            data[pos + j] ^= in[j];
+
+        pos += literals;
+        in += literals;
+    }
+
+    return true;
+}
+
+}
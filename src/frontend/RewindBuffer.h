@@ -0,0 +1,128 @@
+/*
+    Copyright 2016-2023 melonDS team
+
+    This file is part of melonDS.
+
+    melonDS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS. If not, see http://www.gnu.org/licenses/.
+*/
+
+#ifndef REWINDBUFFER_H
+#define REWINDBUFFER_H
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "types.h"
+
+namespace melonDS
+{
+class NDS;
+class Savestate;
+}
+
+namespace Frontend
+{
+using namespace melonDS;
+
+// History of snapshots taken every few frames, to step back in time.
+//
+// Only the newest snapshot is kept as is. Every older one is stored as its
+// difference to the one after it: the snapshot buffer and the pages that
+// aren't shared between the two are XORed with their counterpart and the
+// runs of zeros dropped. That's done on a worker thread, so taking a snapshot
+// costs the emulator thread about as much as a run-ahead frame does.
+//
+// The oldest entries are dropped to stay within the memory budget.
+class RewindBuffer
+{
+public:
+    RewindBuffer() noexcept;
+    ~RewindBuffer();
+
+    RewindBuffer(const RewindBuffer&) = delete;
+    RewindBuffer& operator=(const RewindBuffer&) = delete;
+
+    void SetInterval(u32 frames) { Interval = frames ? frames : 1; }
+    void SetBudget(u64 bytes) { Budget = bytes; }
+
+    // call after every frame, snapshots every Interval frames
+    void Update(NDS& nds);
+
+    // loads the newest snapshot, the one before it becomes the newest
+    // @returns false if there's nothing to go back to
+    bool StepBack(NDS& nds);
+
+    // drops everything, eg. when the console was reset or a state loaded
+    void Clear();
+
+    [[nodiscard]] bool IsEmpty();
+
+    // snapshots that can be stepped back to, the newest one included
+    [[nodiscard]] u32 GetNumStates();
+
+    // encoded history plus the newest snapshot, in bytes
+    [[nodiscard]] u64 GetMemoryUsage();
+
+private:
+    struct Delta
+    {
+        u32 Length;    // of the snapshot buffer
+        u32 NumPages;
+        std::vector<u32> Pages; // the ones that differ from the newer snapshot
+        std::vector<u8> Data;   // buffer, then each of those pages
+    };
+
+    struct Job
+    {
+        std::shared_ptr<Savestate> Older;
+        std::shared_ptr<Savestate> Newer;
+    };
+
+    void WorkerFunc();
+    void WaitIdle(std::unique_lock<std::mutex>& lock);
+    void TrimHistory();
+
+    static Delta Encode(const Savestate& older, const Savestate& newer);
+    static std::shared_ptr<Savestate> Decode(const Delta& delta, const Savestate& newer);
+
+    static void EncodeXOR(std::vector<u8>& out, const u8* data, const u8* ref, u32 reflen, u32 len);
+    static bool DecodeXOR(u8* data, u32 len, const u8*& in, const u8* end);
+
+    static u64 RawSize(const Savestate& state);
+
+    u32 Interval;
+    u64 Budget;
+    u32 FramesSinceSnapshot;
+
+    std::shared_ptr<Savestate> Newest;
+
+    // shared with the worker
+    std::mutex Lock;
+    std::condition_variable WorkCond;
+    std::condition_variable IdleCond;
+    std::deque<Job> Jobs;
+    std::deque<Delta> History; // oldest first
+    u64 HistorySize;
+    u64 NewestSize;
+    bool Busy;
+    bool Quit;
+    std::thread Worker;
+};
+
+}
+
+#endif // REWINDBUFFER_H
@@ -0,0 +1,278 @@
+/*
+    Copyright 2016-2023 melonDS team
+
+    This file is part of melonDS.
+
+    melonDS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS. If not, see http://www.gnu.org/licenses/.
+*/
+
+#include <string.h>
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+#include <zstd.h>
+
+#include "SavestateFile.h"
+#include "Platform.h"
+#include "Savestate.h"
+
+using namespace melonDS;
+using Platform::Log;
+using Platform::LogLevel;
+
+namespace Frontend
+{
+
+// file layout (little endian):
+//
+// header
+//   00  "MELZ"
+//   04  version major (1), minor
+//   08  length of the state once decompressed
+//   0C  number of chunks
+// directory, for each chunk:
+//   00  magic of the section it's part of ("MELN" for the state's own header)
+//   04  offset in the decompressed state
+//   08  length
+//   0C  compressed length
+// chunks, back to back, each a zstd frame
+//
+// the chunks cover the decompressed state in order, which is a regular
+// savestate buffer. That one starts with "MELN" and has its own version,
+// so the file needs a magic of its own to be told apart from a raw state
+
+const u32 kFileMagic = 0x5A4C454D; // MELZ
+const u32 kStateMagic = 0x4E4C454D; // MELN
+const u16 kFileMajor = 1;
+const u16 kFileMinor = 0;
+
+// small enough that the big sections (main RAM, VRAM, 3D) are spread over several cores
+const u32 kChunkSize = 256 * 1024;
+
+// zstd's fastest levels already get most of the size down, the rest is mostly zeros
+const int kCompressionLevel = 1;
+
+struct ChunkInfo
+{
+    u32 Magic;
+    u32 Offset;
+    u32 Length;
+    u32 CompLength;
+};
+
+// runs func(0) to func(count-1) spread over the available cores
+template <typename F>
+static void ParallelFor(u32 count, F&& func)
+{
+    u32 numThreads = std::min<u32>(count, std::max(1u, std::thread::hardware_concurrency()));
+    std::atomic<u32> next = 0;
+    auto worker = [&]()
+    {
+        for (u32 i; (i = next++) < count;)
+            func(i);
+    };
+
+    std::vector<std::thread> threads;
+    for (u32 i = 1; i < numThreads; i++)
+        threads.emplace_back(worker);
+
+    worker();
+    for (std::thread& thread : threads)
+        thread.join();
+}
+
+bool WriteSavestateFile(const std::string& path, Savestate& state)
+{
+    if (state.Error || !state.Saving)
+        return false;
+
+    const u8* src = (const u8*)state.Buffer();
+    u32 length = state.Length();
+
+    std::vector<ChunkInfo> chunks;
+    chunks.push_back({kStateMagic, 0, 0x10, 0});
+    u32 end = 0x10;
+    for (const Savestate::SectionInfo& section : state.GetSections())
+    {
+        if (section.Offset != end)
+            break;
+
+        for (u32 offset = 0; offset < section.Length; offset += kChunkSize)
+        {
+            u32 len = std::min(kChunkSize, section.Length - offset);
+            chunks.push_back({section.Magic, section.Offset + offset, len, 0});
+        }
+        end += section.Length;
+    }
+
+    if (end != length)
+    {
+        Log(LogLevel::Error, "SavestateFile: sections don't cover the %u-byte state\n", length);
+        return false;
+    }
+
+    std::vector<std::vector<u8>> compressed(chunks.size());
+    std::atomic<bool> failed = false;
+    ParallelFor(chunks.size(), [&](u32 i)
+    {
+        ChunkInfo& chunk = chunks[i];
+        std::vector<u8>& out = compressed[i];
+
+        out.resize(ZSTD_compressBound(chunk.Length));
+        size_t len = ZSTD_compress(out.data(), out.size(), &src[chunk.Offset], chunk.Length, kCompressionLevel);
+        if (ZSTD_isError(len))
+        {
+            failed = true;
+            return;
+        }
+
+        out.resize(len);
+        chunk.CompLength = len;
+    });
+
+    if (failed)
+    {
+        Log(LogLevel::Error, "SavestateFile: failed to compress the state\n");
+        return false;
+    }
+
+    u16 version[2] = {kFileMajor, kFileMinor};
+    u32 numChunks = chunks.size();
+
+    std::vector<u8> data;
+    auto put = [&data](const void* ptr, size_t len)
+    {
+        const u8* bytes = (const u8*)ptr;
+        data.insert(data.end(), bytes, bytes + len);
+    };
+
+    put(&kFileMagic, 4);
+    put(version, 4);
+    put(&length, 4);
+    put(&numChunks, 4);
+    for (const ChunkInfo& chunk : chunks)
+        put(&chunk, sizeof(chunk));
+    for (const std::vector<u8>& chunk : compressed)
+        put(chunk.data(), chunk.size());
+
+    Platform::FileHandle* file = Platform::OpenFile(path, Platform::FileMode::Write);
+    if (!file)
+    {
+        Log(LogLevel::Error, "SavestateFile: failed to open %s for writing\n", path.c_str());
+        return false;
+    }
+
+    bool ok = Platform::FileWrite(data.data(), data.size(), 1, file) == 1;
+    Platform::CloseFile(file);
+    if (!ok)
+        Log(LogLevel::Error, "SavestateFile: failed to write %zu bytes to %s\n", data.size(), path.c_str());
+
+    return ok;
+}
+
+bool ReadSavestateFile(const std::string& path, std::vector<u8>& state)
+{
+    Platform::FileHandle* file = Platform::OpenFile(path, Platform::FileMode::Read);
+    if (!file)
+    {
+        Log(LogLevel::Error, "SavestateFile: failed to open %s\n", path.c_str());
+        return false;
+    }
+
+    u64 filelen = Platform::FileLength(file);
+    std::vector<u8> data(filelen);
+    bool ok = filelen >= 0x10 && Platform::FileRead(data.data(), filelen, 1, file) == 1;
+    Platform::CloseFile(file);
+    if (!ok)
+    {
+        Log(LogLevel::Error, "SavestateFile: failed to read %s\n", path.c_str());
+        return false;
+    }
+
+    u32 magic, length, numChunks;
+    u16 major;
+    memcpy(&magic, &data[0], 4);
+    memcpy(&major, &data[4], 2);
+    memcpy(&length, &data[8], 4);
+    memcpy(&numChunks, &data[12], 4);
+
+    // a raw state, as they were saved before, Savestate checks it like any other
+    if (magic != kFileMagic)
+    {
+        state = std::move(data);
+        return true;
+    }
+
+    if (major != kFileMajor)
+    {
+        Log(LogLevel::Error, "SavestateFile: %s has version %d, expecting %d\n", path.c_str(), major, kFileMajor);
+        return false;
+    }
+
+    u64 dirEnd = 0x10 + (u64)numChunks * sizeof(ChunkInfo);
+    if (dirEnd > filelen)
+    {
+        Log(LogLevel::Error, "SavestateFile: %s is truncated\n", path.c_str());
+        return false;
+    }
+
+    std::vector<ChunkInfo> chunks(numChunks);
+    memcpy(chunks.data(), &data[0x10], numChunks * sizeof(ChunkInfo));
+
+    // the chunks have to cover the state exactly, and be in the file
+    std::vector<u64> fileOffsets(numChunks);
+    u64 fileOffset = dirEnd;
+    u32 stateOffset = 0;
+    for (u32 i = 0; i < numChunks; i++)
+    {
+        const ChunkInfo& chunk = chunks[i];
+        if (chunk.Offset != stateOffset || chunk.Length > length - stateOffset
+            || chunk.CompLength > filelen - fileOffset)
+        {
+            Log(LogLevel::Error, "SavestateFile: bad directory entry %u in %s\n", i, path.c_str());
+            return false;
+        }
+
+        fileOffsets[i] = fileOffset;
+        fileOffset += chunk.CompLength;
+        stateOffset += chunk.Length;
+    }
+    if (stateOffset != length)
+    {
+        Log(LogLevel::Error, "SavestateFile: %s doesn't have the whole state\n", path.c_str());
+        return false;
+    }
+
+    state.resize(length);
+    std::atomic<bool> failed = false;
+    ParallelFor(numChunks, [&](u32 i)
+    {
+        const ChunkInfo& chunk = chunks[i];
+        size_t len = ZSTD_decompress(&state[chunk.Offset], chunk.Length,
+                                     &data[fileOffsets[i]], chunk.CompLength);
+        if (ZSTD_isError(len) || len != chunk.Length)
+            failed = true;
+    });
+
+    if (failed)
+    {
+        Log(LogLevel::Error, "SavestateFile: %s is corrupted\n", path.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+}
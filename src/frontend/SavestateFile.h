@@ -0,0 +1,50 @@
+/*
+    Copyright 2016-2023 melonDS team
+
+    This file is part of melonDS.
+
+    melonDS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS. If not, see http://www.gnu.org/licenses/.
+*/
+
+#ifndef SAVESTATEFILE_H
+#define SAVESTATEFILE_H
+
+#include <string>
+#include <vector>
+
+#include "types.h"
+
+namespace melonDS
+{
+class Savestate;
+}
+
+namespace Frontend
+{
+using namespace melonDS;
+
+// Savestate files: the state is split along its sections into chunks that
+// are compressed with zstd, on as many threads as there are cores, behind
+// a directory so they can be found and decompressed independently.
+//
+// Files from before that (the raw state buffer) can still be read.
+
+// writes a finished savestate
+bool WriteSavestateFile(const std::string& path, Savestate& state);
+
+// reads a savestate file into a buffer, to be loaded with Savestate(buffer, size, false)
+bool ReadSavestateFile(const std::string& path, std::vector<u8>& state);
+
+}
+
+#endif // SAVESTATEFILE_H
@@ -0,0 +1,340 @@
+/*
+    Copyright 2016-2023 melonDS team
+
+    This file is part of melonDS.
+
+    melonDS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS. If not, see http://www.gnu.org/licenses/.
+*/
+
+// Platform implementation for the benchmark: plain C/C++ standard library,
+// no saving, no networking, no cameras.
+
+#include <stdio.h>
+#include <stdarg.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "Platform.h"
+
+#ifdef __WIN32__
+#define fseek _fseeki64
+#define ftell _ftelli64
+#endif // __WIN32__
+
+namespace melonDS::Platform
+{
+
+// only warnings and errors by default, the core is chatty
+LogLevel MinLogLevel = LogLevel::Warn;
+
+void Init(int argc, char** argv)
+{
+}
+
+void DeInit()
+{
+}
+
+void SignalStop(StopReason reason)
+{
+    Log(LogLevel::Warn, "Emulation stopped (reason %d)\n", (int)reason);
+}
+
+int InstanceID()
+{
+    return 0;
+}
+
+std::string InstanceFileSuffix()
+{
+    return "";
+}
+
+static std::string GetModeString(FileMode mode, bool file_exists)
+{
+    std::string modeString;
+
+    if (!(mode & FileMode::Write))
+        modeString += 'r';
+    else if ((mode & FileMode::NoCreate) || ((mode & FileMode::Preserve) && file_exists))
+        modeString += 'r';
+    else
+        modeString += 'w';
+
+    if ((mode & FileMode::ReadWrite) == FileMode::ReadWrite)
+        modeString += '+';
+
+    if (!(mode & FileMode::Text))
+        modeString += 'b';
+
+    return modeString;
+}
+
+FileHandle* OpenFile(const std::string& path, FileMode mode)
+{
+    if ((mode & FileMode::ReadWrite) == FileMode::None)
+    {
+        Log(LogLevel::Error, "Attempted to open \"%s\" in neither read nor write mode (FileMode 0x%x)\n", path.c_str(), mode);
+        return nullptr;
+    }
+
+    FILE* test = fopen(path.c_str(), "rb");
+    bool file_exists = test != nullptr;
+    if (test) fclose(test);
+
+    FILE* file = fopen(path.c_str(), GetModeString(mode, file_exists).c_str());
+    if (!file)
+        Log(LogLevel::Debug, "Failed to open \"%s\" with FileMode 0x%x\n", path.c_str(), mode);
+
+    return reinterpret_cast<FileHandle *>(file);
+}
+
+FileHandle* OpenLocalFile(const std::string& path, FileMode mode)
+{
+    // everything is relative to the working directory
+    return OpenFile(path, mode);
+}
+
+bool CloseFile(FileHandle* file)
+{
+    return fclose(reinterpret_cast<FILE *>(file)) == 0;
+}
+
+bool IsEndOfFile(FileHandle* file)
+{
+    return feof(reinterpret_cast<FILE *>(file)) != 0;
+}
+
+bool FileReadLine(char* str, int count, FileHandle* file)
+{
+    return fgets(str, count, reinterpret_cast<FILE *>(file)) != nullptr;
+}
+
+bool FileExists(const std::string& name)
+{
+    FileHandle* f = OpenFile(name, FileMode::Read);
+    if (!f) return false;
+    CloseFile(f);
+    return true;
+}
+
+bool LocalFileExists(const std::string& name)
+{
+    return FileExists(name);
+}
+
+bool FileSeek(FileHandle* file, s64 offset, FileSeekOrigin origin)
+{
+    int stdorigin;
+    switch (origin)
+    {
+        case FileSeekOrigin::Start: stdorigin = SEEK_SET; break;
+        case FileSeekOrigin::Current: stdorigin = SEEK_CUR; break;
+        case FileSeekOrigin::End: stdorigin = SEEK_END; break;
+    }
+
+    return fseek(reinterpret_cast<FILE *>(file), offset, stdorigin) == 0;
+}
+
+void FileRewind(FileHandle* file)
+{
+    rewind(reinterpret_cast<FILE *>(file));
+}
+
+u64 FileRead(void* data, u64 size, u64 count, FileHandle* file)
+{
+    return fread(data, size, count, reinterpret_cast<FILE *>(file));
+}
+
+bool FileFlush(FileHandle* file)
+{
+    return fflush(reinterpret_cast<FILE *>(file)) == 0;
+}
+
+u64 FileWrite(const void* data, u64 size, u64 count, FileHandle* file)
+{
+    return fwrite(data, size, count, reinterpret_cast<FILE *>(file));
+}
+
+u64 FileWriteFormatted(FileHandle* file, const char* fmt, ...)
+{
+    if (fmt == nullptr)
+        return 0;
+
+    va_list args;
+    va_start(args, fmt);
+    u64 ret = vfprintf(reinterpret_cast<FILE *>(file), fmt, args);
+    va_end(args);
+    return ret;
+}
+
+u64 FileLength(FileHandle* file)
+{
+    FILE* stdfile = reinterpret_cast<FILE *>(file);
+    long pos = ftell(stdfile);
+    fseek(stdfile, 0, SEEK_END);
+    long len = ftell(stdfile);
+    fseek(stdfile, pos, SEEK_SET);
+    return len;
+}
+
+void Log(LogLevel level, const char* fmt, ...)
+{
+    if (fmt == nullptr || level < MinLogLevel)
+        return;
+
+    va_list args;
+    va_start(args, fmt);
+    vfprintf(stderr, fmt, args);
+    va_end(args);
+}
+
+
+struct Semaphore
+{
+    std::mutex Lock;
+    std::condition_variable Cond;
+    int Count = 0;
+};
+
+Thread* Thread_Create(std::function<void()> func)
+{
+    return (Thread*) new std::thread(std::move(func));
+}
+
+void Thread_Free(Thread* thread)
+{
+    std::thread* t = (std::thread*) thread;
+    if (t->joinable())
+        t->detach();
+    delete t;
+}
+
+void Thread_Wait(Thread* thread)
+{
+    std::thread* t = (std::thread*) thread;
+    if (t->joinable())
+        t->join();
+}
+
+Semaphore* Semaphore_Create()
+{
+    return new Semaphore();
+}
+
+void Semaphore_Free(Semaphore* sema)
+{
+    delete sema;
+}
+
+void Semaphore_Reset(Semaphore* sema)
+{
+    std::lock_guard<std::mutex> lock(sema->Lock);
+    sema->Count = 0;
+}
+
+void Semaphore_Wait(Semaphore* sema)
+{
+    std::unique_lock<std::mutex> lock(sema->Lock);
+    sema->Cond.wait(lock, [sema] { return sema->Count > 0; });
+    sema->Count--;
+}
+
+void Semaphore_Post(Semaphore* sema, int count)
+{
+    {
+        std::lock_guard<std::mutex> lock(sema->Lock);
+        sema->Count += count;
+    }
+    sema->Cond.notify_all();
+}
+
+Mutex* Mutex_Create()
+{
+    return (Mutex*) new std::mutex();
+}
+
+void Mutex_Free(Mutex* mutex)
+{
+    delete (std::mutex*) mutex;
+}
+
+void Mutex_Lock(Mutex* mutex)
+{
+    ((std::mutex*) mutex)->lock();
+}
+
+void Mutex_Unlock(Mutex* mutex)
+{
+    ((std::mutex*) mutex)->unlock();
+}
+
+bool Mutex_TryLock(Mutex* mutex)
+{
+    return ((std::mutex*) mutex)->try_lock();
+}
+
+void Sleep(u64 usecs)
+{
+    std::this_thread::sleep_for(std::chrono::microseconds(usecs));
+}
+
+
+// runs are meant to be reproducible, so nothing gets written back
+
+void WriteNDSSave(const u8* savedata, u32 savelen, u32 writeoffset, u32 writelen)
+{
+}
+
+void WriteGBASave(const u8* savedata, u32 savelen, u32 writeoffset, u32 writelen)
+{
+}
+
+void WriteFirmware(const Firmware& firmware, u32 writeoffset, u32 writelen)
+{
+}
+
+void WriteDateTime(int year, int month, int day, int hour, int minute, int second)
+{
+}
+
+bool MP_Init() { return false; }
+void MP_DeInit() {}
+void MP_Begin() {}
+void MP_End() {}
+int MP_SendPacket(u8* data, int len, u64 timestamp) { return 0; }
+int MP_RecvPacket(u8* data, u64* timestamp) { return 0; }
+int MP_SendCmd(u8* data, int len, u64 timestamp) { return 0; }
+int MP_SendReply(u8* data, int len, u64 timestamp, u16 aid) { return 0; }
+int MP_SendAck(u8* data, int len, u64 timestamp) { return 0; }
+int MP_RecvHostPacket(u8* data, u64* timestamp) { return 0; }
+u16 MP_RecvReplies(u8* data, u64 timestamp, u16 aidmask) { return 0; }
+
+bool LAN_Init() { return false; }
+void LAN_DeInit() {}
+int LAN_SendPacket(u8* data, int len) { return 0; }
+int LAN_RecvPacket(u8* data) { return 0; }
+
+void Camera_Start(int num) {}
+void Camera_Stop(int num) {}
+void Camera_CaptureFrame(int num, u32* frame, int width, int height, bool yuv) {}
+
+DynamicLibrary* DynamicLibrary_Load(const char* lib) { return nullptr; }
+void DynamicLibrary_Unload(DynamicLibrary* lib) {}
+void* DynamicLibrary_LoadFunction(DynamicLibrary* lib, const char* name) { return nullptr; }
+
+}
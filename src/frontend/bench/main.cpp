@@ -0,0 +1,665 @@
+/*
+    Copyright 2016-2023 melonDS team
+
+    This file is part of melonDS.
+
+    melonDS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS. If not, see http://www.gnu.org/licenses/.
+*/
+
+// Headless benchmark: boots a ROM (optionally loads a savestate), runs a fixed
+// number of frames as fast as possible and reports the frame rate, and
+// optionally how the time was split between the emulated subsystems.
+//
+// Without a movie no input is given to the game, so a run is only reproducible
+// from the same savestate (or from boot). With a movie, the recorded input is
+// played back and every frame is checked against the recorded framebuffers.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "NDS.h"
+#include "NDSCart.h"
+#include "Args.h"
+#include "GPU3D_Soft.h"
+#include "Savestate.h"
+#include "Platform.h"
+#include "InputMovie.h"
+#include "RewindBuffer.h"
+#include "SavestateFile.h"
+
+#ifdef OGLRENDERER_ENABLED
+#include "GPU3D_OpenGL.h"
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+using namespace melonDS;
+
+namespace melonDS::Platform
+{
+extern LogLevel MinLogLevel;
+}
+
+enum class BenchRenderer
+{
+    Soft,
+    SoftThreaded,
+    OpenGL,
+};
+
+struct BenchOptions
+{
+    std::string ROMPath;
+    std::string StatePath;
+    std::string MoviePath;
+    std::string RecordPath;
+    std::string SaveStatePath;
+    u32 Frames = 3600;
+    u32 WarmupFrames = 60;
+    u32 RunAhead = 0;
+    u32 RewindInterval = 0;
+    u32 RewindBudget = 64; // MB
+    bool JIT = true;
+    bool JITBackground = false;
+    u32 JITThreshold = 0;
+    bool JITFastVRAM = false;
+    bool IdleLoopSkipping = true;
+    BenchRenderer Renderer = BenchRenderer::Soft;
+    int GLScale = 1;
+    bool Profile = false;
+};
+
+static void PrintUsage(const char* exe)
+{
+    printf("usage: %s [options] <rom.nds>\n"
+           "\n"
+           "  --state <file>     load this savestate after booting the ROM\n"
+           "  --movie <file>     play back this input movie, checking every frame\n"
+           "                     (runs the whole movie unless --frames is given)\n"
+           "  --save-state <file> write a savestate once the run is done\n"
+           "  --record <file>    record the run (warmup included) as a movie, eg. to\n"
+           "                     check that the JIT plays back an interpreter run\n"
+           "  --frames <n>       number of frames to time (default 3600)\n"
+           "  --warmup <n>       frames to run before timing starts (default 60)\n"
+           "  --run-ahead <n>    run n frames ahead every frame and go back, like the\n"
+           "                     frontend's run-ahead (a movie still has to match)\n"
+           "  --rewind <n>       keep a rewind history, snapshotting every n frames,\n"
+           "                     then step back through it once timing is done\n"
+           "  --rewind-mb <n>    memory budget for the rewind history (default 64)\n"
+           "  --jit, --no-jit    run with or without the JIT recompiler (default on)\n"
+           "  --jit-background   compile JIT blocks on a separate thread\n"
+           "  --jit-threshold <n> interpret code n times before compiling it (default 0)\n"
+           "  --jit-fast-vram    let the JIT's fast memory write to VRAM, tracking writes\n"
+           "                     by write-protecting it\n"
+           "  --no-idle-skip     don't skip idle loops in the interpreter\n"
+           "  --renderer <r>     3D renderer: soft, soft-threaded or gl (default soft)\n"
+           "                     gl renders offscreen through EGL, its frames differ from\n"
+           "                     the software renderer's so movies only match their own\n"
+           "  --gl-scale <n>     internal resolution of the gl renderer (default 1)\n"
+           "  --profile          report the time spent in each subsystem and scheduler event\n"
+           "                     (and the most run JIT blocks with ENABLE_JIT_PERF_MAP)\n"
+           "  --verbose          show the core's log messages\n",
+           exe);
+}
+
+static bool ParseArgs(int argc, char** argv, BenchOptions& opt)
+{
+    bool framesGiven = false;
+
+    for (int i = 1; i < argc; i++)
+    {
+        const char* arg = argv[i];
+        bool hasValue = i+1 < argc;
+
+        if (!strcmp(arg, "--state") && hasValue)
+            opt.StatePath = argv[++i];
+        else if (!strcmp(arg, "--movie") && hasValue)
+            opt.MoviePath = argv[++i];
+        else if (!strcmp(arg, "--save-state") && hasValue)
+            opt.SaveStatePath = argv[++i];
+        else if (!strcmp(arg, "--record") && hasValue)
+            opt.RecordPath = argv[++i];
+        else if (!strcmp(arg, "--frames") && hasValue)
+        {
+            opt.Frames = strtoul(argv[++i], nullptr, 0);
+            framesGiven = true;
+        }
+        else if (!strcmp(arg, "--warmup") && hasValue)
+            opt.WarmupFrames = strtoul(argv[++i], nullptr, 0);
+        else if (!strcmp(arg, "--run-ahead") && hasValue)
+            opt.RunAhead = strtoul(argv[++i], nullptr, 0);
+        else if (!strcmp(arg, "--rewind") && hasValue)
+            opt.RewindInterval = strtoul(argv[++i], nullptr, 0);
+        else if (!strcmp(arg, "--rewind-mb") && hasValue)
+            opt.RewindBudget = strtoul(argv[++i], nullptr, 0);
+        else if (!strcmp(arg, "--jit"))
+            opt.JIT = true;
+        else if (!strcmp(arg, "--no-jit"))
+            opt.JIT = false;
+        else if (!strcmp(arg, "--jit-background"))
+            opt.JIT = opt.JITBackground = true;
+        else if (!strcmp(arg, "--jit-threshold") && hasValue)
+        {
+            opt.JIT = true;
+            // strtoul() would take a negative count as a huge one
+            long threshold = strtol(argv[++i], nullptr, 0);
+            opt.JITThreshold = threshold > 0 ? threshold : 0;
+        }
+        else if (!strcmp(arg, "--jit-fast-vram"))
+            opt.JIT = opt.JITFastVRAM = true;
+        else if (!strcmp(arg, "--no-idle-skip"))
+            opt.IdleLoopSkipping = false;
+        else if (!strcmp(arg, "--renderer") && hasValue)
+        {
+            const char* renderer = argv[++i];
+            if (!strcmp(renderer, "soft"))
+                opt.Renderer = BenchRenderer::Soft;
+            else if (!strcmp(renderer, "soft-threaded"))
+                opt.Renderer = BenchRenderer::SoftThreaded;
+#ifdef OGLRENDERER_ENABLED
+            else if (!strcmp(renderer, "gl"))
+                opt.Renderer = BenchRenderer::OpenGL;
+#endif
+            else
+            {
+                fprintf(stderr, "unknown renderer: %s\n", renderer);
+                return false;
+            }
+        }
+        else if (!strcmp(arg, "--gl-scale") && hasValue)
+        {
+            long scale = strtol(argv[++i], nullptr, 0);
+            opt.GLScale = scale < 1 ? 1 : (scale > 16 ? 16 : (int)scale);
+        }
+        else if (!strcmp(arg, "--profile"))
+            opt.Profile = true;
+        else if (!strcmp(arg, "--verbose"))
+            Platform::MinLogLevel = Platform::LogLevel::Debug;
+        else if (arg[0] == '-')
+        {
+            fprintf(stderr, "unknown option: %s\n", arg);
+            return false;
+        }
+        else
+            opt.ROMPath = arg;
+    }
+
+    if (!opt.StatePath.empty() && !opt.MoviePath.empty())
+    {
+        fprintf(stderr, "--state and --movie can't be used together, movies have their own state\n");
+        return false;
+    }
+
+    if (!opt.RecordPath.empty() && !opt.MoviePath.empty())
+    {
+        fprintf(stderr, "--record and --movie can't be used together\n");
+        return false;
+    }
+
+    // 0 = as long as the movie
+    if (!opt.MoviePath.empty() && !framesGiven)
+        opt.Frames = 0;
+
+    return !opt.ROMPath.empty() && (opt.Frames > 0 || !opt.MoviePath.empty());
+}
+
+static const char* RendererName(BenchRenderer renderer)
+{
+    switch (renderer)
+    {
+    case BenchRenderer::Soft: return "soft";
+    case BenchRenderer::SoftThreaded: return "soft-threaded";
+    case BenchRenderer::OpenGL: return "gl";
+    }
+    return "?";
+}
+
+#ifdef OGLRENDERER_ENABLED
+// there's no window to render into, so the GL renderer gets a surfaceless
+// context, it only ever draws into its own framebuffers and reads them back
+struct OffscreenGL
+{
+    EGLDisplay Display = EGL_NO_DISPLAY;
+    EGLContext Context = EGL_NO_CONTEXT;
+
+    ~OffscreenGL()
+    {
+        if (Context != EGL_NO_CONTEXT)
+        {
+            eglMakeCurrent(Display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+            eglDestroyContext(Display, Context);
+        }
+        if (Display != EGL_NO_DISPLAY)
+            eglTerminate(Display);
+    }
+
+    bool Init()
+    {
+        // prefer Mesa's surfaceless platform, it works without any display server
+        auto getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+        if (getPlatformDisplay)
+            Display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+        if (Display == EGL_NO_DISPLAY)
+            Display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+        if (Display == EGL_NO_DISPLAY || !eglInitialize(Display, nullptr, nullptr))
+        {
+            fprintf(stderr, "EGL: no display\n");
+            Display = EGL_NO_DISPLAY;
+            return false;
+        }
+
+        if (!eglBindAPI(EGL_OPENGL_API))
+        {
+            fprintf(stderr, "EGL: desktop OpenGL isn't supported\n");
+            return false;
+        }
+
+        const EGLint configAttribs[] =
+        {
+            EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+            EGL_NONE
+        };
+        EGLConfig config;
+        EGLint numConfigs = 0;
+        // without EGL_KHR_no_config_context there has to be some config
+        if (!eglChooseConfig(Display, configAttribs, &config, 1, &numConfigs) || numConfigs < 1)
+            config = nullptr;
+
+        // same version as the frontend asks for
+        const EGLint contextAttribs[] =
+        {
+            EGL_CONTEXT_MAJOR_VERSION, 3,
+            EGL_CONTEXT_MINOR_VERSION, 2,
+            EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+            EGL_NONE
+        };
+        Context = eglCreateContext(Display, config, EGL_NO_CONTEXT, contextAttribs);
+        if (Context == EGL_NO_CONTEXT)
+        {
+            fprintf(stderr, "EGL: couldn't create an OpenGL 3.2 core context\n");
+            return false;
+        }
+
+        if (!eglMakeCurrent(Display, EGL_NO_SURFACE, EGL_NO_SURFACE, Context))
+        {
+            fprintf(stderr, "EGL: surfaceless contexts aren't supported\n");
+            return false;
+        }
+
+        if (!gladLoadGLLoader((GLADloadproc)eglGetProcAddress))
+        {
+            fprintf(stderr, "failed to load the OpenGL functions\n");
+            return false;
+        }
+
+        return true;
+    }
+};
+#endif
+
+static std::unique_ptr<u8[]> ReadWholeFile(const std::string& path, u32& len)
+{
+    Platform::FileHandle* file = Platform::OpenFile(path, Platform::FileMode::Read);
+    if (!file)
+        return nullptr;
+
+    len = (u32)Platform::FileLength(file);
+    auto data = std::make_unique<u8[]>(len);
+    u64 read = Platform::FileRead(data.get(), len, 1, file);
+    Platform::CloseFile(file);
+
+    if (read != 1)
+        return nullptr;
+
+    return data;
+}
+
+int main(int argc, char** argv)
+{
+    BenchOptions opt;
+    if (!ParseArgs(argc, argv, opt))
+    {
+        PrintUsage(argv[0]);
+        return 1;
+    }
+
+    Platform::Init(argc, argv);
+
+    u32 romlen = 0;
+    auto romdata = ReadWholeFile(opt.ROMPath, romlen);
+    if (!romdata)
+    {
+        fprintf(stderr, "failed to read ROM %s\n", opt.ROMPath.c_str());
+        return 1;
+    }
+
+    auto cart = NDSCart::ParseROM(std::move(romdata), romlen);
+    if (!cart)
+    {
+        fprintf(stderr, "failed to parse ROM %s\n", opt.ROMPath.c_str());
+        return 1;
+    }
+
+#ifndef JIT_ENABLED
+    if (opt.JIT)
+    {
+        fprintf(stderr, "this build has no JIT, running the interpreter\n");
+        opt.JIT = false;
+    }
+#endif
+
+    NDSArgs args {};
+    args.NDSROM = std::move(cart);
+    if (opt.JIT)
+    {
+        args.JIT = std::make_optional<JITArgs>();
+        args.JIT->BackgroundCompile = opt.JITBackground;
+        args.JIT->CompileThreshold = opt.JITThreshold;
+        args.JIT->FastVRAM = opt.JITFastVRAM;
+    }
+#ifdef OGLRENDERER_ENABLED
+    // declared before the console so the context outlives the renderer
+    OffscreenGL gl;
+    if (opt.Renderer == BenchRenderer::OpenGL)
+    {
+        if (!gl.Init())
+            return 1;
+
+        auto glrenderer = GLRenderer::New();
+        if (!glrenderer)
+        {
+            fprintf(stderr, "failed to initialize the OpenGL renderer\n");
+            return 1;
+        }
+        glrenderer->SetRenderSettings(false, opt.GLScale);
+        args.Renderer3D = std::move(glrenderer);
+    }
+    else
+#endif
+        args.Renderer3D = std::make_unique<SoftRenderer>(opt.Renderer == BenchRenderer::SoftThreaded);
+    args.IdleLoopSkipping = opt.IdleLoopSkipping;
+
+    auto nds = std::make_unique<NDS>(std::move(args));
+    // the JIT's fastmem fault handler finds the console through this,
+    // there's no other way to tell it yet
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wdeprecated-declarations"
+    NDS::Current = nds.get();
+#pragma GCC diagnostic pop
+    nds->Reset();
+    if (nds->NeedsDirectBoot())
+        nds->SetupDirectBoot(opt.ROMPath);
+    nds->Start();
+
+    if (!opt.StatePath.empty())
+    {
+        std::vector<u8> statedata;
+        if (!Frontend::ReadSavestateFile(opt.StatePath, statedata))
+        {
+            fprintf(stderr, "failed to read savestate %s\n", opt.StatePath.c_str());
+            return 1;
+        }
+
+        Savestate state(statedata.data(), statedata.size(), false);
+        if (state.Error || !nds->DoSavestate(&state) || state.Error)
+        {
+            fprintf(stderr, "failed to load savestate %s\n", opt.StatePath.c_str());
+            return 1;
+        }
+    }
+
+    Frontend::InputMovie movie;
+    if (!opt.MoviePath.empty())
+    {
+        if (!movie.StartPlayback(*nds, opt.MoviePath))
+        {
+            fprintf(stderr, "failed to load movie %s\n", opt.MoviePath.c_str());
+            return 1;
+        }
+
+        // the warmup frames come out of the movie too
+        u32 length = movie.GetNumFrames();
+        if (opt.WarmupFrames >= length)
+        {
+            fprintf(stderr, "movie is too short (%u frames) for %u warmup frames\n", length, opt.WarmupFrames);
+            return 1;
+        }
+        if (opt.Frames == 0 || opt.Frames > length - opt.WarmupFrames)
+            opt.Frames = length - opt.WarmupFrames;
+    }
+    else if (!opt.RecordPath.empty())
+    {
+        if (!movie.StartRecording(*nds, opt.RecordPath))
+        {
+            fprintf(stderr, "failed to start recording\n");
+            return 1;
+        }
+    }
+
+    Savestate runAheadState;
+    if (runAheadState.Error)
+    {
+        fprintf(stderr, "failed to allocate the run-ahead state\n");
+        return 1;
+    }
+
+    Frontend::RewindBuffer rewind;
+    rewind.SetInterval(opt.RewindInterval);
+    rewind.SetBudget((u64)opt.RewindBudget << 20);
+
+    u64 copiedPages = 0;
+    u32 snapshots = 0;
+
+    FrameStats slowest {};
+    u32 slowestFrame = 0;
+
+    auto runFrame = [&]()
+    {
+        movie.BeginFrame(*nds);
+        nds->RunFrame();
+        movie.EndFrame(*nds);
+
+        if (nds->Profiler.IsEnabled() && nds->Profiler.GetLastFrame().TotalTime > slowest.TotalTime)
+        {
+            slowest = nds->Profiler.GetLastFrame();
+            slowestFrame = nds->NumFrames;
+        }
+
+        if (opt.RunAhead > 0 && nds->SaveSnapshot(runAheadState))
+        {
+            copiedPages += runAheadState.NumCopiedPages();
+            snapshots++;
+
+            // the movie's input hook would apply this frame's writes again
+            nds->SetInputHook(-1, nullptr);
+            nds->SPU.SetOutputEnabled(false);
+            for (u32 i = 0; i < opt.RunAhead; i++)
+                nds->RunFrame();
+            nds->SPU.SetOutputEnabled(true);
+
+            if (!nds->LoadSnapshot(runAheadState))
+            {
+                fprintf(stderr, "failed to restore the run-ahead state\n");
+                exit(1);
+            }
+        }
+
+        if (opt.RewindInterval > 0)
+            rewind.Update(*nds);
+    };
+
+    for (u32 i = 0; i < opt.WarmupFrames; i++)
+        runFrame();
+
+    nds->Profiler.Reset();
+    nds->Profiler.SetEnabled(opt.Profile);
+
+    auto start = std::chrono::steady_clock::now();
+    for (u32 i = 0; i < opt.Frames; i++)
+        runFrame();
+    auto end = std::chrono::steady_clock::now();
+
+    nds->Profiler.SetEnabled(false);
+
+    u32 rewindStates = 0;
+    u64 rewindMemory = 0;
+    double rewindSeconds = 0;
+    if (opt.RewindInterval > 0)
+    {
+        rewindStates = rewind.GetNumStates();
+        rewindMemory = rewind.GetMemoryUsage();
+
+        // waits for the worker first, like the frontend would
+        auto rewindStart = std::chrono::steady_clock::now();
+        for (u32 i = 0; i < rewindStates; i++)
+        {
+            if (!rewind.StepBack(*nds))
+            {
+                fprintf(stderr, "failed to step back through the rewind history\n");
+                return 1;
+            }
+        }
+        rewindSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - rewindStart).count();
+    }
+
+    if (movie.IsRecording() && !movie.Stop())
+        fprintf(stderr, "failed to write movie %s\n", opt.RecordPath.c_str());
+
+    double saveSeconds = 0;
+    u32 saveLength = 0;
+    if (!opt.SaveStatePath.empty())
+    {
+        auto saveStart = std::chrono::steady_clock::now();
+        Savestate state;
+        if (state.Error || !nds->DoSavestate(&state) || !Frontend::WriteSavestateFile(opt.SaveStatePath, state))
+        {
+            fprintf(stderr, "failed to write savestate %s\n", opt.SaveStatePath.c_str());
+            return 1;
+        }
+        saveSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - saveStart).count();
+        saveLength = state.Length();
+    }
+
+    double seconds = std::chrono::duration<double>(end - start).count();
+
+    printf("rom: %s%s%s%s%s\n", opt.ROMPath.c_str(),
+           opt.StatePath.empty() ? "" : ", state: ",
+           opt.StatePath.c_str(),
+           opt.MoviePath.empty() ? "" : ", movie: ",
+           opt.MoviePath.c_str());
+    printf("jit: %s, renderer: %s, run-ahead: %u\n",
+           opt.JIT ? (opt.JITBackground ? "on (background)" : "on") : "off",
+           RendererName(opt.Renderer),
+           opt.RunAhead);
+    printf("%u frames in %.3f s: %.1f FPS (%.3f ms/frame)\n",
+           opt.Frames, seconds, opt.Frames / seconds, seconds * 1000.0 / opt.Frames);
+    if (snapshots > 0)
+    {
+        // warmup included, the first snapshot copies everything
+        printf("snapshots copied %.1f of %u pages on average\n",
+               (double)copiedPages / snapshots, runAheadState.NumPages());
+    }
+
+#ifdef JIT_ENABLED
+    if (opt.JIT)
+    {
+        printf("jit block lookup tables: %.1f KB\n", nds->JIT.GetLookupMemoryUsage() / 1024.0);
+
+        size_t hugeMemory, hugeViews, hugeCode;
+        nds->JIT.GetHugePageUsage(hugeMemory, hugeViews, hugeCode);
+        printf("huge pages: %.1f MB of guest memory, %.1f MB of fast memory views, %.1f MB of jit code\n",
+               hugeMemory / (1024.0 * 1024.0), hugeViews / (1024.0 * 1024.0), hugeCode / (1024.0 * 1024.0));
+    }
+#endif
+    if (!opt.SaveStatePath.empty())
+        printf("savestate: %u KB, saved in %.1f ms\n", saveLength / 1024, saveSeconds * 1000.0);
+    if (opt.RewindInterval > 0)
+    {
+        printf("rewind: %u states (%.1f s of history) in %.1f MB, stepping back through them took %.1f ms\n",
+               rewindStates, rewindStates * opt.RewindInterval / 60.0,
+               rewindMemory / (1024.0 * 1024.0), rewindSeconds * 1000.0);
+    }
+
+    if (opt.Profile)
+    {
+        // measuring adds some overhead of its own, so compare FPS between runs
+        // that have the same --profile setting
+        u64 total = nds->Profiler.GetTotalTime();
+
+        printf("\n%-12s %10s %7s %10s\n", "section", "ms/frame", "%", "slowest");
+        for (int i = Prof_None+1; i < Prof_MAX; i++)
+        {
+            ProfSection section = (ProfSection)i;
+            u64 time = nds->Profiler.GetTime(section);
+
+            printf("%-12s %10.3f %7.1f %10.3f\n",
+                   FrameProfiler::GetSectionName(section),
+                   time / 1000000.0 / opt.Frames,
+                   total ? (time * 100.0 / total) : 0.0,
+                   slowest.Time[section] / 1000000.0);
+        }
+
+        // handlers include what they spend in other sections, eg. LCD events draw scanlines
+        FrameStats totals = nds->Profiler.GetTotals();
+        printf("\n%-18s %10s %10s\n", "event", "per frame", "ms/frame");
+        for (u32 i = 0; i < Event_MAX; i++)
+        {
+            if (!totals.EventCount[i]) continue;
+
+            printf("%-18s %10.1f %10.3f\n", NDS::GetEventName(i),
+                   (double)totals.EventCount[i] / opt.Frames,
+                   totals.EventTime[i] / 1000000.0 / opt.Frames);
+        }
+
+        printf("\nGX FIFO stalls: %.1f%% of the ARM9's time\n",
+               totals.Cycles ? (totals.GXStallCycles * 100.0 / totals.Cycles) : 0.0);
+        printf("slowest frame: #%u, %.3f ms\n", slowestFrame, slowest.TotalTime / 1000000.0);
+
+#ifdef JIT_PERF_MAP_ENABLED
+        // warmup included, blocks thrown away in the meantime aren't
+        if (opt.JIT)
+        {
+            printf("\n%-22s %12s %10s\n", "jit block", "entries", "per frame");
+            for (const ARMJIT::HotBlock& block : nds->JIT.GetHotBlocks(20))
+            {
+                printf("ARM%d %-5s %08X    %12llu %10.1f\n",
+                       block.Num ? 7 : 9, block.Thumb ? "Thumb" : "ARM", block.Addr,
+                       (unsigned long long)block.EntryCount,
+                       (double)block.EntryCount / (opt.WarmupFrames + opt.Frames));
+            }
+        }
+#endif
+    }
+
+    int ret = 0;
+    if (movie.GetStatus() == Frontend::InputMovie::status_Desync)
+    {
+        // timings past that point aren't comparable with other runs
+        printf("\nDESYNC at movie frame %u\n", movie.GetDesyncFrame());
+        ret = 2;
+    }
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wdeprecated-declarations"
+    NDS::Current = nullptr;
+#pragma GCC diagnostic pop
+    nds = nullptr;
+    Platform::DeInit();
+    return ret;
+}
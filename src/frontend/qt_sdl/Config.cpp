@@ -65,9 +65,12 @@ bool GL_BetterPolygons;
 bool LimitFPS;
 bool AudioSync;
 bool ShowOSD;
+bool ShowLatencyStats;
+bool ShowPerfStats;
 
 int ConsoleType;
 bool DirectBoot;
+bool IdleLoopSkipping;
 
 #ifdef JIT_ENABLED
 bool JIT_Enable = false;
@@ -75,6 +78,9 @@ int JIT_MaxBlockSize = 32;
 bool JIT_BranchOptimisations = true;
 bool JIT_LiteralOptimisations = true;
 bool JIT_FastMemory = true;
+bool JIT_BackgroundCompile = false;
+int JIT_CompileThreshold = 0;
+bool JIT_FastVRAM = false;
 #endif
 
 bool ExternalBIOSEnable;
@@ -120,6 +126,10 @@ bool DirectLAN;
 
 bool SavestateRelocSRAM;
 
+bool RewindEnabled;
+int RewindInterval;
+int RewindBufferSize;
+
 int AudioInterp;
 int AudioBitDepth;
 int AudioVolume;
@@ -162,6 +172,12 @@ bool GdbARM9BreakOnStartup;
 
 int MetroidAimSensitivity;
 int MetroidVirtualStylusSensitivity;
+bool MetroidLateAim;
+int MetroidLateAimScanline;
+int MetroidRunAhead;
+#ifdef RAWINPUT_ENABLED
+bool MetroidRawInput;
+#endif
 
 CameraConfig Camera[2];
 
@@ -209,6 +225,7 @@ ConfigEntry ConfigFile[] =
     // {"HKKey_SolarSensorDecrease", 0, &HKKeyMapping[HK_SolarSensorDecrease], -1, true},
     // {"HKKey_SolarSensorIncrease", 0, &HKKeyMapping[HK_SolarSensorIncrease], -1, true},
     {"HKKey_FrameStep",           0, &HKKeyMapping[HK_FrameStep],           -1, true},
+    {"HKKey_Rewind",              0, &HKKeyMapping[HK_Rewind],              -1, true},
     {"HKKey_PowerButton",         0, &HKKeyMapping[HK_PowerButton],         -1, true},
     {"HKKey_VolumeUp",            0, &HKKeyMapping[HK_VolumeUp],            -1, true},
     {"HKKey_VolumeDown",          0, &HKKeyMapping[HK_VolumeDown],          -1, true},
@@ -262,6 +279,7 @@ ConfigEntry ConfigFile[] =
     // not metroid
 
     {"HKJoy_FrameStep",           0, &HKJoyMapping[HK_FrameStep],           -1, true},
+    {"HKJoy_Rewind",              0, &HKJoyMapping[HK_Rewind],              -1, true},
     {"HKJoy_PowerButton",         0, &HKJoyMapping[HK_PowerButton],         -1, true},
     {"HKJoy_VolumeUp",            0, &HKJoyMapping[HK_VolumeUp],            -1, true},
     {"HKJoy_VolumeDown",          0, &HKJoyMapping[HK_VolumeDown],          -1, true},
@@ -295,9 +313,12 @@ ConfigEntry ConfigFile[] =
     {"LimitFPS", 1, &LimitFPS, true, false},
     {"AudioSync", 1, &AudioSync, false},
     {"ShowOSD", 1, &ShowOSD, true, false},
+    {"ShowLatencyStats", 1, &ShowLatencyStats, false, false},
+    {"ShowPerfStats", 1, &ShowPerfStats, false, false},
 
     {"ConsoleType", 0, &ConsoleType, 0, false},
     {"DirectBoot", 1, &DirectBoot, true, false},
+    {"IdleLoopSkipping", 1, &IdleLoopSkipping, true, false},
 
 #ifdef JIT_ENABLED
     {"JIT_Enable", 1, &JIT_Enable, true, false},
@@ -309,6 +330,9 @@ ConfigEntry ConfigFile[] =
     #else
         {"JIT_FastMemory", 1, &JIT_FastMemory, true, false},
     #endif
+    {"JIT_BackgroundCompile", 1, &JIT_BackgroundCompile, false, false},
+    {"JIT_CompileThreshold", 0, &JIT_CompileThreshold, 0, false},
+    {"JIT_FastVRAM", 1, &JIT_FastVRAM, false, false},
 #endif
 
     {"ExternalBIOSEnable", 1, &ExternalBIOSEnable, false, false},
@@ -353,6 +377,10 @@ ConfigEntry ConfigFile[] =
 
     {"SavStaRelocSRAM", 1, &SavestateRelocSRAM, false, false},
 
+    {"RewindEnabled", 1, &RewindEnabled, false, false},
+    {"RewindInterval", 0, &RewindInterval, 30, false},
+    {"RewindBufferSize", 0, &RewindBufferSize, 64, false},
+
     {"AudioInterp", 0, &AudioInterp, 0, false},
     {"AudioBitDepth", 0, &AudioBitDepth, 0, false},
     {"AudioVolume", 0, &AudioVolume, 256, true},
@@ -404,6 +432,12 @@ ConfigEntry ConfigFile[] =
 
     {"MetroidAimSensitivity", 0, &MetroidAimSensitivity, MetroidAimSensitivityDefault, false},
     {"MetroidVirtualStylusSensitivity", 0, &MetroidVirtualStylusSensitivity, MetroidVirtualStylusSensitivityDefault, false},
+    {"MetroidLateAim", 1, &MetroidLateAim, false, false},
+    {"MetroidLateAimScanline", 0, &MetroidLateAimScanline, MetroidLateAimScanlineDefault, false},
+    {"MetroidRunAhead", 0, &MetroidRunAhead, 0, false},
+#ifdef RAWINPUT_ENABLED
+    {"MetroidRawInput", 1, &MetroidRawInput, false, false},
+#endif
 
     // TODO!!
     // we need a more elegant way to deal with this
@@ -37,6 +37,7 @@ Hotkey
     // HK_SolarSensorDecrease,
     // HK_SolarSensorIncrease,
     HK_FrameStep,
+    HK_Rewind,
     HK_PowerButton,
     HK_VolumeUp,
     HK_VolumeDown,
@@ -140,9 +141,12 @@ extern bool GL_BetterPolygons;
 extern bool LimitFPS;
 extern bool AudioSync;
 extern bool ShowOSD;
+extern bool ShowLatencyStats;
+extern bool ShowPerfStats;
 
 extern int ConsoleType;
 extern bool DirectBoot;
+extern bool IdleLoopSkipping;
 
 #ifdef JIT_ENABLED
 extern bool JIT_Enable;
@@ -150,6 +154,9 @@ extern int JIT_MaxBlockSize;
 extern bool JIT_BranchOptimisations;
 extern bool JIT_LiteralOptimisations;
 extern bool JIT_FastMemory;
+extern bool JIT_BackgroundCompile;
+extern int JIT_CompileThreshold;
+extern bool JIT_FastVRAM;
 #endif
 
 extern bool ExternalBIOSEnable;
@@ -195,6 +202,10 @@ extern bool DirectLAN;
 
 extern bool SavestateRelocSRAM;
 
+extern bool RewindEnabled;
+extern int RewindInterval;
+extern int RewindBufferSize;
+
 extern int AudioInterp;
 extern int AudioBitDepth;
 extern int AudioVolume;
@@ -236,9 +247,17 @@ extern bool GdbARM9BreakOnStartup;
 
 extern int MetroidAimSensitivity;
 extern int MetroidVirtualStylusSensitivity;
+extern bool MetroidLateAim;
+extern int MetroidLateAimScanline;
+extern int MetroidRunAhead;
+#ifdef RAWINPUT_ENABLED
+extern bool MetroidRawInput;
+#endif
 
 const int MetroidAimSensitivityDefault = 30;
 const int MetroidVirtualStylusSensitivityDefault = 20;
+const int MetroidLateAimScanlineDefault = 191;
+const int MetroidRunAheadMax = 4;
 
 void Load();
 void Save();
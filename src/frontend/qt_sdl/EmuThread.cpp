@@ -56,12 +56,15 @@
 #include "Savestate.h"
 
 #include "ROMManager.h"
+#include "LatencyTrace.h"
 //#include "ArchiveUtil.h"
 //#include "CameraManager.h"
 
 //#include "CLI.h"
 
-// #include "RawInputThread.h"
+#ifdef RAWINPUT_ENABLED
+#include "RawInputThread.h"
+#endif
 #include "overlay_shaders.h"
 
 // TODO: uniform variable spelling
@@ -74,6 +77,43 @@ extern int autoScreenSizing;
 extern int videoRenderer;
 extern bool videoSettingsDirty;
 
+// lines of the performance stats panel, averaged over the given frames
+static std::vector<std::string> PerfStatsLines(const FrameStats& stats, u32 frames)
+{
+    std::vector<std::string> lines;
+    char buf[256];
+    auto ms = [frames](u64 ns) { return ns / 1000000.0 / frames; };
+
+    snprintf(buf, sizeof(buf), "emulation %.2f ms/frame: ARM9 %.2f, ARM7 %.2f, 3D %.2f, 2D %.2f, SPU %.2f, DMA %.2f, sched %.2f, misc %.2f",
+             ms(stats.TotalTime),
+             ms(stats.Time[Prof_ARM9]), ms(stats.Time[Prof_ARM7]),
+             ms(stats.Time[Prof_GPU3D]), ms(stats.Time[Prof_GPU2D]),
+             ms(stats.Time[Prof_SPU]), ms(stats.Time[Prof_DMA]),
+             ms(stats.Time[Prof_Scheduler]), ms(stats.Time[Prof_Misc]));
+    lines.push_back(buf);
+
+    // the costliest events, with how often they fire
+    std::vector<u32> events;
+    for (u32 i = 0; i < Event_MAX; i++)
+    {
+        if (stats.EventCount[i]) events.push_back(i);
+    }
+    std::sort(events.begin(), events.end(), [&stats](u32 a, u32 b) { return stats.EventTime[a] > stats.EventTime[b]; });
+    if (events.size() > 4) events.resize(4);
+
+    int len = snprintf(buf, sizeof(buf), "GX FIFO stall %.1f%%, events:",
+                       stats.Cycles ? (stats.GXStallCycles * 100.0 / stats.Cycles) : 0.0);
+    for (u32 i : events)
+    {
+        if (len >= (int)sizeof(buf)) break;
+        len += snprintf(&buf[len], sizeof(buf) - len, " %s %.0fx %.2f ms",
+                        NDS::GetEventName(i), (double)stats.EventCount[i] / frames, ms(stats.EventTime[i]));
+    }
+    lines.push_back(buf);
+
+    return lines;
+}
+
 
 EmuThread::EmuThread(QObject* parent) : QThread(parent)
 {
@@ -119,6 +159,9 @@ std::unique_ptr<NDS> EmuThread::CreateConsole(
         Config::JIT_LiteralOptimisations,
         Config::JIT_BranchOptimisations,
         Config::JIT_FastMemory,
+        Config::JIT_BackgroundCompile,
+        static_cast<unsigned>(std::max(0, Config::JIT_CompileThreshold)),
+        Config::JIT_FastVRAM,
     };
 #endif
 
@@ -150,6 +193,7 @@ std::unique_ptr<NDS> EmuThread::CreateConsole(
         std::nullopt,
 #endif
     };
+    ndsargs.IdleLoopSkipping = Config::IdleLoopSkipping;
 
     if (Config::ConsoleType == 1)
     {
@@ -287,6 +331,9 @@ bool EmuThread::UpdateConsole(UpdateConsoleNDSArgs&& ndsargs, UpdateConsoleGBAAr
         Config::JIT_LiteralOptimisations,
         Config::JIT_BranchOptimisations,
         Config::JIT_FastMemory,
+        Config::JIT_BackgroundCompile,
+        static_cast<unsigned>(std::max(0, Config::JIT_CompileThreshold)),
+        Config::JIT_FastVRAM,
     };
     NDS->SetJITArgs(Config::JIT_Enable ? std::make_optional(jitargs) : std::nullopt);
 #endif
@@ -296,6 +343,7 @@ bool EmuThread::UpdateConsole(UpdateConsoleNDSArgs&& ndsargs, UpdateConsoleGBAAr
     NDS->SetNDSCart(std::move(nextndscart));
     NDS->SPU.SetInterpolation(static_cast<AudioInterpolation>(Config::AudioInterp));
     NDS->SPU.SetDegrade10Bit(static_cast<AudioBitDepth>(Config::AudioBitDepth));
+    NDS->SetIdleLoopSkipping(Config::IdleLoopSkipping);
 
     NDS::Current = NDS.get();
 
@@ -348,6 +396,21 @@ void EmuThread::run()
     double frameLimitError = 0.0;
     double lastMeasureTime = lastTime;
 
+    // how much later than the start of the frame the aim was sampled (late aim)
+    double lateAimDelaySum = 0.0;
+    u32 lateAimDelayCount = 0;
+
+    // run-ahead: where each frame is snapshotted before running ahead,
+    // kept across frames so the buffer is only allocated once
+    std::unique_ptr<Savestate> runAheadState;
+
+    // aim written for the current frame (address, value), which the
+    // frames run ahead get too
+    std::vector<std::pair<u32, s32>> frameAimWrites;
+
+    // the performance stats are shown for the frames since this one
+    u32 perfStatsStart = 0;
+
     u32 winUpdateCount = 0, winUpdateFreq = 1;
     u8 dsiVolumeLevel = 0x1F;
 
@@ -516,8 +579,74 @@ void EmuThread::run()
             }
 
 
+            // rewind: go back to the newest snapshot, this frame runs from there.
+            // a movie can't be rewound, its input comes from the file
+            bool canRewind = Config::RewindEnabled && !Movie.IsRecording() && !Movie.IsPlaying();
+            if (canRewind && Input::HotkeyPressed(HK_Rewind))
+            {
+                if (Rewind.StepBack(*NDS))
+                    mainWindow->osdAddMessage(0, "Rewound");
+                else
+                    mainWindow->osdAddMessage(0xFFA0A0, "Nothing to rewind");
+            }
+
             // emulate
+            auto movieStatus = Movie.GetStatus();
+            Movie.BeginFrame(*NDS);
             u32 nlines = NDS->RunFrame();
+            Movie.EndFrame(*NDS);
+
+            // run-ahead: snapshot the frame we just ran, then run a few more with
+            // the same input, muted, and show the last one instead. the game
+            // responds to input that many frames sooner on screen. once it's
+            // displayed we go back to the snapshot, the next frame continues
+            // from there as if nothing happened
+            bool ranAhead = false;
+            int runAheadFrames = std::clamp(Config::MetroidRunAhead, 0, Config::MetroidRunAheadMax);
+            if (runAheadFrames > 0 && !Movie.IsRecording() && !Movie.IsPlaying())
+            {
+                if (!runAheadState)
+                {
+                    runAheadState = std::make_unique<Savestate>();
+                    if (runAheadState->Error)
+                        runAheadState = nullptr;
+                }
+
+                if (runAheadState && NDS->SaveSnapshot(*runAheadState))
+                {
+                    // the aim for the frames ahead is written beforehand
+                    NDS->SetInputHook(-1, nullptr);
+                    NDS->SPU.SetOutputEnabled(false);
+                    ROMManager::DropCartSaveWrites = true;
+
+                    for (int i = 0; i < runAheadFrames; i++)
+                    {
+                        for (const auto& write : frameAimWrites)
+                            NDS->ARM9Write32(write.first, write.second);
+
+                        // every other frame now goes to the buffer that's on screen,
+                        // don't let the UI thread copy it while it's being drawn
+                        bool lockFrontBuffer = !screenGL && NDS->GPU.FrontBuffer != FrontBuffer;
+                        if (lockFrontBuffer) FrontBufferLock.lock();
+                        NDS->RunFrame();
+                        if (lockFrontBuffer) FrontBufferLock.unlock();
+                    }
+
+                    ROMManager::DropCartSaveWrites = false;
+                    NDS->SPU.SetOutputEnabled(true);
+                    ranAhead = true;
+                }
+            }
+
+            LatencyTrace::Mark(LatencyTrace::Point_FrameDone);
+
+            if (movieStatus == Frontend::InputMovie::status_Playing)
+            {
+                if (Movie.GetStatus() == Frontend::InputMovie::status_Desync)
+                    mainWindow->osdAddMessage(0xFFA0A0, "Movie desynced at frame %u", Movie.GetDesyncFrame());
+                else if (Movie.GetStatus() == Frontend::InputMovie::status_Finished)
+                    mainWindow->osdAddMessage(0, "Movie playback finished");
+            }
 
             if (ROMManager::NDSSave)
                 ROMManager::NDSSave->CheckFlush();
@@ -533,13 +662,74 @@ void EmuThread::run()
                 FrontBufferLock.lock();
                 FrontBuffer = NDS->GPU.FrontBuffer;
                 FrontBufferLock.unlock();
+                LatencyTrace::Mark(LatencyTrace::Point_Handoff);
             }
             else
             {
                 FrontBuffer = NDS->GPU.FrontBuffer;
+                LatencyTrace::Mark(LatencyTrace::Point_Handoff);
                 screenGL->drawScreenGL();
             }
 
+            if (ranAhead && !NDS->LoadSnapshot(*runAheadState))
+            {
+                // we're somewhere ahead now, better not make it worse
+                Config::MetroidRunAhead = 0;
+
+                // the save memory stays where it got to as well, catch the save files up with it
+                if (ROMManager::NDSSave && NDS->GetNDSSave())
+                {
+                    u32 len = NDS->GetNDSSaveLength();
+                    ROMManager::NDSSave->RequestFlush(NDS->GetNDSSave(), len, 0, len);
+                }
+                if (ROMManager::GBASave && NDS->GetGBASave())
+                {
+                    u32 len = NDS->GetGBASaveLength();
+                    ROMManager::GBASave->RequestFlush(NDS->GetGBASave(), len, 0, len);
+                }
+                mainWindow->osdAddMessage(0xFFA0A0, "Run-ahead failed, disabled");
+            }
+
+            if (canRewind)
+            {
+                Rewind.SetInterval(std::max(Config::RewindInterval, 1));
+                Rewind.SetBudget((u64)std::max(Config::RewindBufferSize, 1) << 20);
+                Rewind.Update(*NDS);
+            }
+            else if (!Rewind.IsEmpty())
+                Rewind.Clear();
+
+            LatencyTrace::EndFrame();
+            if (LatencyTrace::IsEnabled() && (NDS->NumFrames % 120) == 0)
+            {
+                std::string summary = LatencyTrace::Summary();
+                if (!summary.empty())
+                    mainWindow->osdAddMessage(0, "%s", summary.c_str());
+            }
+
+            if (Config::ShowPerfStats)
+            {
+                // a new console starts counting frames over
+                if (!NDS->Profiler.IsEnabled() || NDS->NumFrames < perfStatsStart)
+                {
+                    NDS->Profiler.Reset();
+                    NDS->Profiler.SetEnabled(true);
+                    perfStatsStart = NDS->NumFrames;
+                }
+                else if (NDS->NumFrames - perfStatsStart >= 60)
+                {
+                    // run-ahead frames included, they're part of what it takes to show one
+                    mainWindow->osdSetPanel(0, PerfStatsLines(NDS->Profiler.GetTotals(), NDS->NumFrames - perfStatsStart));
+                    NDS->Profiler.Reset();
+                    perfStatsStart = NDS->NumFrames;
+                }
+            }
+            else if (NDS->Profiler.IsEnabled())
+            {
+                NDS->Profiler.SetEnabled(false);
+                mainWindow->osdSetPanel(0, {});
+            }
+
 #ifdef MELONCAP
             MelonCap::Update();
 #endif // MELONCAP
@@ -618,11 +808,17 @@ void EmuThread::run()
                 if (winUpdateFreq < 1)
                     winUpdateFreq = 1;
 
+                char lateAimStat[24] = "";
+                if (Config::MetroidLateAim && lateAimDelayCount > 0)
+                    sprintf(lateAimStat, "[aim -%.1fms] ", (lateAimDelaySum / lateAimDelayCount) * 1000.0);
+                lateAimDelaySum = 0.0;
+                lateAimDelayCount = 0;
+
                 int inst = Platform::InstanceID();
                 if (inst == 0)
-                    sprintf(melontitle, "[%d/%.0f] melonPrimeDS " MELONPRIMEDS_VERSION " (" MELONDS_VERSION ")", fps, fpstarget);
+                    sprintf(melontitle, "[%d/%.0f] %smelonPrimeDS " MELONPRIMEDS_VERSION " (" MELONDS_VERSION ")", fps, fpstarget, lateAimStat);
                 else
-                    sprintf(melontitle, "[%d/%.0f] melonPrimeDS " MELONPRIMEDS_VERSION " (" MELONDS_VERSION ") (%d)", fps, fpstarget, inst+1);
+                    sprintf(melontitle, "[%d/%.0f] %smelonPrimeDS " MELONPRIMEDS_VERSION " (" MELONDS_VERSION ") (%d)", fps, fpstarget, lateAimStat, inst+1);
                 changeWindowTitle(melontitle);
             }
         }
@@ -666,13 +862,6 @@ void EmuThread::run()
     }
     };
 
-    auto frameAdvance {
-    [&](int n)
-    {
-        for (int i = 0; i < n; i++) frameAdvanceOnce();
-    }
-    };
-
     // metroid prime hunters code
     // adapted from https://forums.desmume.org/viewtopic.php?id=11715
 
@@ -722,8 +911,122 @@ void EmuThread::run()
     const float dsAspectRatio = 256.0 / 192.0; 
     const float aimAspectRatio = 6.0 / 4.0; // i have no idea
 
-    // RawInputThread* rawInputThread = new RawInputThread(parent());
-    // rawInputThread->start();
+#ifdef RAWINPUT_ENABLED
+    // read mouse motion from the devices directly instead of
+    // measuring how far the cursor moved from the window center
+    std::unique_ptr<RawInputThread> rawInputThread;
+    if (Config::MetroidRawInput) {
+        rawInputThread = std::make_unique<RawInputThread>();
+        if (rawInputThread->hasDevices()) {
+            rawInputThread->start();
+        } else {
+            // most likely no permission to read /dev/input, use the cursor
+            rawInputThread = nullptr;
+        }
+    }
+#endif
+
+    // the cursor is only moved back to the window center once it got this far
+    // away from it, so it normally isn't warped at all. without raw input
+    // motion is measured from where it was the last time
+    QPoint lastCursorPos;
+    int cursorMargin = 0;
+
+    auto recenterCursor
+    {
+    [&](QPoint center, bool force) {
+        QPoint offset = QCursor::pos() - center;
+        if (force || abs(offset.x()) > cursorMargin || abs(offset.y()) > cursorMargin) {
+            QCursor::setPos(center);
+            lastCursorPos = center;
+        }
+    }
+    };
+
+    auto fetchMouseRel
+    {
+    [&]() -> QPoint {
+        QPoint rel;
+        LatencyTrace::Mark(LatencyTrace::Point_Consume);
+#ifdef RAWINPUT_ENABLED
+        if (rawInputThread) {
+            auto delta = rawInputThread->fetchMouseDelta();
+            rel = QPoint(delta.first, delta.second);
+
+            melonDS::u64 eventTime = rawInputThread->fetchFirstEventTime();
+            if (eventTime) LatencyTrace::Mark(LatencyTrace::Point_MouseEvent, eventTime);
+            return rel;
+        }
+#endif
+        QPoint pos = QCursor::pos();
+        rel = pos - lastCursorPos;
+        lastCursorPos = pos;
+
+        // we can't know when the cursor actually moved, so this is the best we have
+        if (!rel.isNull()) LatencyTrace::Mark(LatencyTrace::Point_MouseEvent);
+        return rel;
+    }
+    };
+
+    // fractions of an aim unit left over from previous writes,
+    // so slow mouse movements don't get rounded away
+    float aimRemainderX = 0;
+    float aimRemainderY = 0;
+
+    // scanline the aim is being written at, for movie recording (-1 = before the frame)
+    int aimWriteLine = -1;
+
+    auto writeAim
+    {
+    [&](QPoint rel) {
+        if (abs(rel.x()) > 0) {
+            float aimX = rel.x() * Config::MetroidAimSensitivity * 0.01f + aimRemainderX;
+            aimRemainderX = aimX - (int32_t)aimX;
+            NDS->ARM9Write32(aimXAddr, (int32_t)aimX);
+            Movie.RecordWrite(aimWriteLine, aimXAddr, (int32_t)aimX, 4);
+            frameAimWrites.push_back({aimXAddr, (int32_t)aimX});
+            LatencyTrace::Mark(LatencyTrace::Point_AimWrite);
+            enableAim = true;
+        }
+
+        if (abs(rel.y()) > 0) {
+            float aimY = rel.y() * aimAspectRatio * Config::MetroidAimSensitivity * 0.01f + aimRemainderY;
+            aimRemainderY = aimY - (int32_t)aimY;
+            NDS->ARM9Write32(aimYAddr, (int32_t)aimY);
+            Movie.RecordWrite(aimWriteLine, aimYAddr, (int32_t)aimY, 4);
+            frameAimWrites.push_back({aimYAddr, (int32_t)aimY});
+            LatencyTrace::Mark(LatencyTrace::Point_AimWrite);
+            enableAim = true;
+        }
+    }
+    };
+
+    // late aim: instead of writing the aim before the frame starts,
+    // the core calls us back at a configurable scanline, right before
+    // the game reads it. mouse motion that came in since the start of
+    // the frame gets in this frame instead of the next one
+    bool lateAimPending = false;
+    QPoint lateAimRel;
+    QPoint lateAimCenter;
+    double lateAimSampleTime = 0.0;
+
+    auto lateAimHook
+    {
+    [&]() {
+        if (!lateAimPending) return;
+        lateAimPending = false;
+
+        QPoint rel = lateAimRel + fetchMouseRel();
+        recenterCursor(lateAimCenter, false);
+
+        aimWriteLine = Config::MetroidLateAimScanline;
+        writeAim(rel);
+        aimWriteLine = -1;
+
+        lateAimDelaySum += SDL_GetPerformanceCounter() * perfCountsSec - lateAimSampleTime;
+        lateAimDelayCount++;
+    }
+    };
 
     auto processMoveInput
     {
@@ -755,26 +1058,45 @@ void EmuThread::run()
     };
 
     while (EmuRunning != emuStatus_Exit) {
-        // auto mouseRel = rawInputThread->fetchMouseDelta();
         QPoint mouseRel;
 
+        if (MacroClearRequest.exchange(false))
+            Macro.Clear();
+
+        LatencyTrace::SetEnabled(Config::ShowLatencyStats);
+        frameAimWrites.clear();
+
+        // the movie provides all the input, and sets the input hook itself
+        if (Movie.IsPlaying()) {
+            frameAdvanceOnce();
+            continue;
+        }
+
         auto isFocused = mainWindow->panel->getFocused();
 
         if (isFocused) {
             auto windowCenterX = mainWindow->pos().x() + mainWindow->size().width() / 2;
             auto windowCenterY = mainWindow->pos().y() + mainWindow->size().height() / 2;
-            // if (!focusedLastFrame) {
-            //     // fetch will flush but discard values
-            //     mouseRel.first = 0;
-            //     mouseRel.second = 0;
-            // }
+            lateAimCenter = QPoint(windowCenterX, windowCenterY);
+            cursorMargin = std::min(mainWindow->size().width(), mainWindow->size().height()) / 4;
             if (focusedLastFrame) {
-                mouseRel = QCursor::pos() - QPoint(windowCenterX, windowCenterY);
+                mouseRel = fetchMouseRel();
             }
-            QCursor::setPos(windowCenterX, windowCenterY);
+#ifdef RAWINPUT_ENABLED
+            else if (rawInputThread) {
+                // drop whatever happened while we weren't focused
+                rawInputThread->fetchMouseDelta();
+            }
+#endif
+            // with raw input this only keeps the cursor (and clicks) inside the window
+            recenterCursor(lateAimCenter, !focusedLastFrame);
         }
 
         focusedLastFrame = isFocused;
+        if (!isFocused) lateAimPending = false;
+
+        // the console can be recreated at any time, so this is set every frame
+        NDS->SetInputHook(Config::MetroidLateAim ? Config::MetroidLateAimScanline : -1, lateAimHook);
 
         bool drawVCur = false;
 
@@ -822,87 +1144,50 @@ void EmuThread::run()
         } else if (isFocused) {
             drawVCur = false;
 
+            // sequences queue up behind each other, but one that is
+            // already queued isn't added again, so mashing a hotkey doesn't pile them up
+
             // morph ball
-            if (Input::HotkeyPressed(HK_MetroidMorphBall)) {
+            if (Input::HotkeyPressed(HK_MetroidMorphBall) && !Macro.IsQueued(HK_MetroidMorphBall)) {
                 enableAim = false; // in case inBall isnt immediately true
-                NDS->ReleaseScreen();
-                frameAdvance(2);
-                NDS->TouchScreen(231, 167);
                 // boost ball doesnt work unless i release screen late enough
-                for (int i = 0; i < 4; i++) {
-                    frameAdvance(2);
-                    NDS->ReleaseScreen();
-                }
+                Macro.Begin(HK_MetroidMorphBall).Release(2).Touch(231, 167, 2).Release(6);
             }
 
             // scan visor
-            if (Input::HotkeyPressed(HK_MetroidScanVisor)) {
-                NDS->ReleaseScreen();
-                frameAdvance(2);
-
-                bool inVisor = NDS->ARM9Read8(inVisorOrMapAddr) == 0x1;
-                // mainWindow->osdAddMessage(0, "in visor %d", inVisor);
-
-                NDS->TouchScreen(128, 173);
-
-                if (inVisor) {
-                    frameAdvance(2);
-                } else {
-                    for (int i = 0; i < 30; i++) {
-                        // still allow movement whilst we're enabling scan visor
-                        processMoveInput();
-                        NDS->SetKeyMask(Input::GetInputMask());
-                        
-                        frameAdvanceOnce();
-                    }
-                }
-                
-                NDS->ReleaseScreen();
-                frameAdvance(2);
+            if (Input::HotkeyPressed(HK_MetroidScanVisor) && !Macro.IsQueued(HK_MetroidScanVisor)) {
+                Macro.Begin(HK_MetroidScanVisor).Release(2).Call([this, inVisorOrMapAddr](InputMacro& macro) {
+                    bool inVisor = NDS->ARM9Read8(inVisorOrMapAddr) == 0x1;
+                    // mainWindow->osdAddMessage(0, "in visor %d", inVisor);
+
+                    // movement keeps going whilst we're enabling scan visor
+                    macro.Touch(128, 173, inVisor ? 2 : 30).Release(2);
+                });
             }
 
             // ok (in scans and messages)
-            if (Input::HotkeyPressed(HK_MetroidUIOk)) {
-                NDS->ReleaseScreen();
-                frameAdvance(2);
-                NDS->TouchScreen(128, 142);
-                frameAdvance(2);
+            if (Input::HotkeyPressed(HK_MetroidUIOk) && !Macro.IsQueued(HK_MetroidUIOk)) {
+                Macro.Begin(HK_MetroidUIOk).Release(2).Touch(128, 142, 2);
             }
 
             // left arrow (in scans and messages)
-            if (Input::HotkeyPressed(HK_MetroidUILeft)) {
-                NDS->ReleaseScreen();
-                frameAdvance(2);
-                NDS->TouchScreen(71, 141);
-                frameAdvance(2);
+            if (Input::HotkeyPressed(HK_MetroidUILeft) && !Macro.IsQueued(HK_MetroidUILeft)) {
+                Macro.Begin(HK_MetroidUILeft).Release(2).Touch(71, 141, 2);
             }
 
             // right arrow (in scans and messages)
-            if (Input::HotkeyPressed(HK_MetroidUIRight)) {
-                NDS->ReleaseScreen();
-                frameAdvance(2);
-                NDS->TouchScreen(185, 141);
-                frameAdvance(2);
+            if (Input::HotkeyPressed(HK_MetroidUIRight) && !Macro.IsQueued(HK_MetroidUIRight)) {
+                Macro.Begin(HK_MetroidUIRight).Release(2).Touch(185, 141, 2);
             }
 
             // switch to beam
-            if (Input::HotkeyPressed(HK_MetroidWeaponBeam)) {
-                NDS->ReleaseScreen();
-                frameAdvance(2);
-                NDS->TouchScreen(85 + 40 * 0, 32);
-                frameAdvance(2);
-                NDS->ReleaseScreen();
-                frameAdvance(2);
+            if (Input::HotkeyPressed(HK_MetroidWeaponBeam) && !Macro.IsQueued(HK_MetroidWeaponBeam)) {
+                Macro.Begin(HK_MetroidWeaponBeam).Release(2).Touch(85 + 40 * 0, 32, 2).Release(2);
             }
 
             // switch to missiles
-            if (Input::HotkeyPressed(HK_MetroidWeaponMissile)) {
-                NDS->ReleaseScreen();
-                frameAdvance(2);
-                NDS->TouchScreen(85 + 40 * 1, 32);
-                frameAdvance(2);
-                NDS->ReleaseScreen();
-                frameAdvance(2);
+            if (Input::HotkeyPressed(HK_MetroidWeaponMissile) && !Macro.IsQueued(HK_MetroidWeaponMissile)) {
+                Macro.Begin(HK_MetroidWeaponMissile).Release(2).Touch(85 + 40 * 1, 32, 2).Release(2);
             }
 
             // switch subweapon
@@ -917,18 +1202,11 @@ void EmuThread::run()
             };
 
             for (int i = 0; i < 6; i++) {
-                if (Input::HotkeyPressed(weaponHotkeys[i])) {
+                if (Input::HotkeyPressed(weaponHotkeys[i]) && !Macro.IsQueued(weaponHotkeys[i])) {
                     melonDS::u16 subX = 93 + 25 * i;
                     melonDS::u16 subY = 48 + 25 * i;
 
-                    NDS->ReleaseScreen();
-                    frameAdvance(2);
-                    NDS->TouchScreen(232, 34);
-                    frameAdvance(2);
-                    NDS->TouchScreen(subX, subY);
-                    frameAdvance(2);
-                    NDS->ReleaseScreen();
-                    frameAdvance(2);
+                    Macro.Begin(weaponHotkeys[i]).Release(2).Touch(232, 34, 2).Touch(subX, subY, 2).Release(2);
                 }
             }
 
@@ -937,21 +1215,14 @@ void EmuThread::run()
             processMoveInput();
 
             // cursor looking
-            
-            if (abs(mouseRel.x()) > 0) {
-                NDS->ARM9Write32(
-                    aimXAddr, 
-                    (int32_t)(mouseRel.x() * Config::MetroidAimSensitivity * 0.01f)
-                );
-                enableAim = true;
-            }
 
-            if (abs(mouseRel.y()) > 0) {
-                NDS->ARM9Write32(
-                    aimYAddr, 
-                    (int32_t)(mouseRel.y() * aimAspectRatio * Config::MetroidAimSensitivity * 0.01f)
-                );
-                enableAim = true;
+            if (Config::MetroidLateAim) {
+                // written by lateAimHook during the frame
+                lateAimPending = true;
+                lateAimRel = mouseRel;
+                lateAimSampleTime = SDL_GetPerformanceCounter() * perfCountsSec;
+            } else {
+                writeAim(mouseRel);
             }
 
             // morph ball boost, map zoom out, imperialist zoom
@@ -991,9 +1262,15 @@ void EmuThread::run()
         
         }
 
+        // hotkey sequences play out one frame at a time,
+        // the touchscreen belongs to them until they're done
+        bool macroActive = false;
+        if (EmuRunning == emuStatus_Running || EmuRunning == emuStatus_FrameStep)
+            macroActive = Macro.Process(*NDS);
+
         // is this a good way of detecting morph ball status?
         bool inBall = NDS->ARM9Read8(inBallAddr) == 0x02;
-        if (!inBall && enableAim) {
+        if (!inBall && enableAim && !macroActive) {
             // mainWindow->osdAddMessage(0,"touching screen for aim");
             NDS->TouchScreen(128, 96); // required for aiming
         }
@@ -1040,6 +1317,12 @@ void EmuThread::run()
         frameAdvanceOnce();
     }
 
+    // otherwise it was written when the emulation was stopped
+    if (RunningSomething && LatencyTrace::IsEnabled())
+        LatencyTrace::DumpCSV("latency.csv");
+
+    Movie.Stop();
+
     file = Platform::OpenLocalFile("rtc.bin", Platform::FileMode::Write);
     if (file)
     {
@@ -1049,8 +1332,6 @@ void EmuThread::run()
         Platform::CloseFile(file);
     }
 
-    // rawInputThread->quit();
-
     EmuStatus = emuStatus_Exit;
 
     NDS::Current = nullptr;
@@ -1064,6 +1345,11 @@ void EmuThread::changeWindowTitle(char* title)
 
 void EmuThread::emuRun()
 {
+    // booted or reset, there's nothing to go back to
+    // (still paused here, the history is ours to touch)
+    Rewind.Clear();
+    clearMacro();
+
     EmuRunning = emuStatus_Running;
     EmuPauseStack = EmuPauseStackRunning;
     RunningSomething = true;
@@ -1117,6 +1403,11 @@ void EmuThread::emuStop()
     AudioInOut::Disable();
 }
 
+void EmuThread::clearMacro()
+{
+    MacroClearRequest = true;
+}
+
 void EmuThread::emuFrameStep()
 {
     if (EmuPauseStack < EmuPauseStackPauseThreshold) emit windowEmuPause();
@@ -28,6 +28,9 @@
 
 #include "NDSCart.h"
 #include "GBACart.h"
+#include "InputMovie.h"
+#include "RewindBuffer.h"
+#include "InputMacro.h"
 
 using Keep = std::monostate;
 using UpdateConsoleNDSArgs = std::variant<Keep, std::unique_ptr<melonDS::NDSCart::CartCommon>>;
@@ -56,6 +59,11 @@ public:
     void emuStop();
     void emuFrameStep();
 
+    /// Drops the Metroid hotkey sequences still queued, so they don't play
+    /// into whatever runs next (boot, reset, stop, state loads).
+    /// The emu thread does the clearing before it handles the next frame's input.
+    void clearMacro();
+
     bool emuIsRunning();
     bool emuIsActive();
 
@@ -72,6 +80,12 @@ public:
     /// If this returns \c false, then the existing NDS console is not modified.
     bool UpdateConsole(UpdateConsoleNDSArgs&& ndsargs, UpdateConsoleGBAArgs&& gbaargs) noexcept;
     std::unique_ptr<melonDS::NDS> NDS; // TODO: Proper encapsulation and synchronization
+
+    // only to be started or stopped while the emulator is paused
+    Frontend::InputMovie Movie;
+
+    // cleared while paused whenever the console jumps somewhere else (reset, state load...)
+    Frontend::RewindBuffer Rewind;
 signals:
     void windowUpdate();
     void windowTitleChange(QString title);
@@ -123,6 +137,10 @@ private:
     };
     std::atomic<ContextRequestKind> ContextRequest = contextRequest_None;
 
+    // Metroid hotkey sequences, only touched by the emu thread
+    InputMacro Macro;
+    std::atomic<bool> MacroClearRequest = false;
+
     ScreenPanelGL* screenGL;
 
     int autoScreenSizing;
@@ -94,6 +94,12 @@ InputConfigDialog::InputConfigDialog(QWidget* parent) : QDialog(parent), ui(new
 
     ui->metroidAimSensitvitySpinBox->setValue(Config::MetroidAimSensitivity);
     ui->metroidVirtualStylusSensitvitySpinBox->setValue(Config::MetroidVirtualStylusSensitivity);
+    ui->metroidLateAimCheckBox->setChecked(Config::MetroidLateAim);
+    ui->metroidLateAimScanlineSpinBox->setValue(Config::MetroidLateAimScanline);
+    ui->metroidLateAimScanlineSpinBox->setEnabled(Config::MetroidLateAim);
+    ui->metroidLatencyStatsCheckBox->setChecked(Config::ShowLatencyStats);
+    ui->metroidRunAheadSpinBox->setMaximum(Config::MetroidRunAheadMax);
+    ui->metroidRunAheadSpinBox->setValue(Config::MetroidRunAhead);
 }
 
 void InputConfigDialog::switchTabToAddons() {
@@ -215,6 +221,10 @@ void InputConfigDialog::on_InputConfigDialog_accepted()
 
     Config::MetroidAimSensitivity = ui->metroidAimSensitvitySpinBox->value();
     Config::MetroidVirtualStylusSensitivity = ui->metroidVirtualStylusSensitvitySpinBox->value();
+    Config::MetroidLateAim = ui->metroidLateAimCheckBox->isChecked();
+    Config::MetroidLateAimScanline = ui->metroidLateAimScanlineSpinBox->value();
+    Config::ShowLatencyStats = ui->metroidLatencyStatsCheckBox->isChecked();
+    Config::MetroidRunAhead = ui->metroidRunAheadSpinBox->value();
 
     Config::Save();
 
@@ -257,3 +267,8 @@ void InputConfigDialog::on_metroidResetSensitivityValues_clicked()
     ui->metroidAimSensitvitySpinBox->setValue(Config::MetroidAimSensitivity);
     ui->metroidVirtualStylusSensitvitySpinBox->setValue(Config::MetroidVirtualStylusSensitivity);
 }
+
+void InputConfigDialog::on_metroidLateAimCheckBox_toggled(bool checked)
+{
+    ui->metroidLateAimScanlineSpinBox->setEnabled(checked);
+}
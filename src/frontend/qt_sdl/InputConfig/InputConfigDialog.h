@@ -108,6 +108,7 @@ static constexpr std::initializer_list<int> hk_general =
     HK_Pause,
     HK_Reset,
     HK_FrameStep,
+    HK_Rewind,
     HK_FastForward,
     HK_FastForwardToggle,
     HK_FullscreenToggle,
@@ -125,6 +126,7 @@ static constexpr std::initializer_list<const char*> hk_general_labels =
     "Pause/resume",
     "Reset",
     "Frame step",
+    "Rewind",
     "Fast forward",
     "Toggle FPS limit",
     "Toggle fullscreen",
@@ -181,6 +183,7 @@ private slots:
     void on_cbxJoystick_currentIndexChanged(int id);
 
     void on_metroidResetSensitivityValues_clicked();
+    void on_metroidLateAimCheckBox_toggled(bool checked);
 
 private:
     void populatePage(QWidget* page,
@@ -0,0 +1,132 @@
+/*
+    Copyright 2016-2023 melonDS team
+
+    This file is part of melonDS.
+
+    melonDS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS. If not, see http://www.gnu.org/licenses/.
+*/
+
+#include <iterator>
+
+#include "InputMacro.h"
+#include "NDS.h"
+
+using namespace melonDS;
+
+InputMacro::InputMacro()
+{
+    Clear();
+}
+
+InputMacro& InputMacro::Begin(int id)
+{
+    Steps.push_back({step_Begin, 0, 0, id, 0, nullptr});
+    return *this;
+}
+
+InputMacro& InputMacro::Touch(u16 x, u16 y, int frames)
+{
+    Steps.push_back({step_Touch, x, y, 0, frames, nullptr});
+    return *this;
+}
+
+InputMacro& InputMacro::Release(int frames)
+{
+    Steps.push_back({step_Release, 0, 0, 0, frames, nullptr});
+    return *this;
+}
+
+InputMacro& InputMacro::Call(std::function<void(InputMacro&)> func)
+{
+    Steps.push_back({step_Call, 0, 0, 0, 0, std::move(func)});
+    return *this;
+}
+
+void InputMacro::Clear()
+{
+    Steps.clear();
+    FramesLeft = 0;
+    CurrentID = -1;
+
+    Touching = false;
+    TouchX = 0;
+    TouchY = 0;
+}
+
+bool InputMacro::IsQueued(int id) const
+{
+    // the current sequence is over once only other sequences are left
+    if (CurrentID == id && (FramesLeft > 0 || (!Steps.empty() && Steps.front().Kind != step_Begin)))
+        return true;
+
+    for (const Step& step : Steps)
+    {
+        if (step.Kind == step_Begin && step.ID == id)
+            return true;
+    }
+
+    return false;
+}
+
+bool InputMacro::Process(NDS& nds)
+{
+    while (FramesLeft == 0 && !Steps.empty())
+    {
+        Step step = std::move(Steps.front());
+        Steps.pop_front();
+
+        switch (step.Kind)
+        {
+        case step_Begin:
+            CurrentID = step.ID;
+            break;
+
+        case step_Touch:
+            Touching = true;
+            TouchX = step.X;
+            TouchY = step.Y;
+            break;
+
+        case step_Release:
+            Touching = false;
+            break;
+
+        case step_Call:
+            {
+                // steps queued by the callback go in front of the remaining ones
+                std::deque<Step> rest;
+                rest.swap(Steps);
+                step.Func(*this);
+                Steps.insert(Steps.end(), std::make_move_iterator(rest.begin()), std::make_move_iterator(rest.end()));
+            }
+            break;
+        }
+
+        FramesLeft = step.Frames;
+    }
+
+    if (FramesLeft == 0)
+    {
+        // macro is over, hand the touchscreen back
+        CurrentID = -1;
+        return false;
+    }
+
+    if (Touching)
+        nds.TouchScreen(TouchX, TouchY);
+    else
+        nds.ReleaseScreen();
+
+    FramesLeft--;
+    return true;
+}
@@ -0,0 +1,92 @@
+/*
+    Copyright 2016-2023 melonDS team
+
+    This file is part of melonDS.
+
+    melonDS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS. If not, see http://www.gnu.org/licenses/.
+*/
+
+#ifndef INPUTMACRO_H
+#define INPUTMACRO_H
+
+#include <deque>
+#include <functional>
+
+#include "types.h"
+
+namespace melonDS
+{
+class NDS;
+}
+
+/// Queue of timed touchscreen steps, played back one emulated frame at a time.
+/// This replaces the old approach of running the emulator in a nested loop
+/// for every hotkey sequence, which stalled aiming and movement until the
+/// sequence was over.
+class InputMacro
+{
+public:
+    InputMacro();
+
+    /// Starts a new sequence, the steps appended after this belong to it.
+    /// id identifies the sequence for IsQueued().
+    InputMacro& Begin(int id);
+
+    // all of these append a step to the queue.
+    // frames is how many emulated frames the step is held for
+    // before the next one is applied (0 = apply the next one in the same frame)
+    InputMacro& Touch(melonDS::u16 x, melonDS::u16 y, int frames);
+    InputMacro& Release(int frames);
+
+    /// Runs func when the step is reached. Any steps func queues are
+    /// played right after it, before the rest of the queue.
+    InputMacro& Call(std::function<void(InputMacro&)> func);
+
+    void Clear();
+    bool IsActive() const { return FramesLeft > 0 || !Steps.empty(); }
+
+    /// @return \c true if the sequence id is still playing or waiting to.
+    bool IsQueued(int id) const;
+
+    /// Advances the macro by one frame. To be called once per emulated frame,
+    /// after the regular input handling and before the frame is run.
+    /// @return \c true if the macro is driving the touchscreen this frame.
+    bool Process(melonDS::NDS& nds);
+
+private:
+    enum StepKind
+    {
+        step_Begin,
+        step_Touch,
+        step_Release,
+        step_Call,
+    };
+
+    struct Step
+    {
+        StepKind Kind;
+        melonDS::u16 X, Y;
+        int ID;
+        int Frames;
+        std::function<void(InputMacro&)> Func;
+    };
+
+    std::deque<Step> Steps;
+    int FramesLeft;
+    int CurrentID;
+
+    bool Touching;
+    melonDS::u16 TouchX, TouchY;
+};
+
+#endif // INPUTMACRO_H
@@ -0,0 +1,202 @@
+/*
+    Copyright 2016-2023 melonDS team
+
+    This file is part of melonDS.
+
+    melonDS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS. If not, see http://www.gnu.org/licenses/.
+*/
+
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+#include "LatencyTrace.h"
+#include "Platform.h"
+
+using namespace melonDS;
+
+namespace LatencyTrace
+{
+
+// frames kept for the CSV dump (10 minutes at 60 FPS)
+const u32 kMaxFrames = 60 * 60 * 10;
+// frames the OSD percentiles are taken over
+const u32 kSummaryFrames = 60 * 5;
+
+struct Frame
+{
+    u32 Num;
+    u64 Time[Point_MAX]; // 0 = not reached this frame
+};
+
+bool Enabled = false;
+
+u64 StartTime;
+u32 FrameNum;
+Frame Current;
+
+// ring buffer, FramesPos is where the next frame goes
+std::vector<Frame> Frames;
+u32 FramesPos;
+
+
+u64 Now()
+{
+    using namespace std::chrono;
+    return duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+void SetEnabled(bool enable)
+{
+    if (enable && !Enabled)
+        Reset();
+
+    Enabled = enable;
+}
+
+bool IsEnabled()
+{
+    return Enabled;
+}
+
+void Reset()
+{
+    StartTime = Now();
+    FrameNum = 0;
+    memset(&Current, 0, sizeof(Current));
+
+    Frames.clear();
+    FramesPos = 0;
+}
+
+void Mark(Point point)
+{
+    if (!Enabled) return;
+    Mark(point, Now());
+}
+
+void Mark(Point point, u64 time)
+{
+    if (!Enabled) return;
+
+    // the first time a point is reached in a frame is the one that counts
+    // (ie. the aim is written once per axis)
+    if (Current.Time[point] == 0)
+        Current.Time[point] = time;
+}
+
+void EndFrame()
+{
+    if (!Enabled) return;
+
+    Current.Num = FrameNum++;
+
+    if (Frames.size() < kMaxFrames)
+        Frames.push_back(Current);
+    else
+        Frames[FramesPos] = Current;
+    FramesPos = (FramesPos + 1) % kMaxFrames;
+
+    memset(&Current, 0, sizeof(Current));
+}
+
+static u64 DisplayTime(const Frame& frame)
+{
+    // without the OpenGL display, the handoff is the last point we can see
+    return frame.Time[Point_Swap] ? frame.Time[Point_Swap] : frame.Time[Point_Handoff];
+}
+
+struct Segment
+{
+    const char* Name;
+    std::vector<double> Samples;
+
+    void Add(u64 start, u64 end)
+    {
+        if (start && end && end >= start)
+            Samples.push_back((end - start) / 1000000.0);
+    }
+
+    double Percentile(double p)
+    {
+        size_t n = (size_t)(p * (Samples.size() - 1));
+        std::nth_element(Samples.begin(), Samples.begin() + n, Samples.end());
+        return Samples[n];
+    }
+};
+
+std::string Summary()
+{
+    if (!Enabled || Frames.empty()) return "";
+
+    Segment total {"total"};
+    Segment toAim {"in>aim"};
+    Segment toFrame {"aim>frame"};
+    Segment toDisplay {"frame>disp"};
+
+    u32 count = std::min((u32)Frames.size(), kSummaryFrames);
+    for (u32 i = 0; i < count; i++)
+    {
+        const Frame& frame = Frames[(FramesPos + Frames.size() - 1 - i) % Frames.size()];
+
+        total.Add(frame.Time[Point_MouseEvent], DisplayTime(frame));
+        toAim.Add(frame.Time[Point_MouseEvent], frame.Time[Point_AimWrite]);
+        toFrame.Add(frame.Time[Point_AimWrite], frame.Time[Point_FrameDone]);
+        toDisplay.Add(frame.Time[Point_FrameDone], DisplayTime(frame));
+    }
+
+    std::string ret = "Latency p50/p99 (ms):";
+    for (Segment* seg : {&total, &toAim, &toFrame, &toDisplay})
+    {
+        if (seg->Samples.empty()) continue;
+
+        char buf[64];
+        snprintf(buf, sizeof(buf), " %s %.1f/%.1f", seg->Name, seg->Percentile(0.5), seg->Percentile(0.99));
+        ret += buf;
+    }
+
+    return ret;
+}
+
+bool DumpCSV(const std::string& path)
+{
+    Platform::FileHandle* file = Platform::OpenLocalFile(path, Platform::FileMode::WriteText);
+    if (!file)
+        return false;
+
+    // times are in microseconds since tracing was enabled
+    Platform::FileWriteFormatted(file, "frame,mouse_event,consume,aim_write,frame_done,handoff,swap\n");
+
+    for (u32 i = 0; i < Frames.size(); i++)
+    {
+        const Frame& frame = Frames[(FramesPos + i) % Frames.size()];
+
+        Platform::FileWriteFormatted(file, "%u", frame.Num);
+        for (int p = 0; p < Point_MAX; p++)
+        {
+            if (frame.Time[p] >= StartTime)
+                Platform::FileWriteFormatted(file, ",%.1f", (frame.Time[p] - StartTime) / 1000.0);
+            else
+                Platform::FileWriteFormatted(file, ",");
+        }
+        Platform::FileWriteFormatted(file, "\n");
+    }
+
+    Platform::CloseFile(file);
+    return true;
+}
+
+}
@@ -0,0 +1,68 @@
+/*
+    Copyright 2016-2023 melonDS team
+
+    This file is part of melonDS.
+
+    melonDS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS. If not, see http://www.gnu.org/licenses/.
+*/
+
+#ifndef LATENCYTRACE_H
+#define LATENCYTRACE_H
+
+#include <string>
+
+#include "types.h"
+
+// Timestamps along the aim path, from the mouse event to the buffer swap,
+// recorded once per emulated frame. Everything except Now() is meant to be
+// called from the emu thread, or while it is paused.
+namespace LatencyTrace
+{
+
+enum Point
+{
+    Point_MouseEvent = 0,   // first mouse event that went into this frame's aim
+    Point_Consume,          // mouse delta picked up by the main loop
+    Point_AimWrite,         // aim written to emulated memory
+    Point_FrameDone,        // NDS::RunFrame() returned
+    Point_Handoff,          // new FrontBuffer handed to the display
+    Point_Swap,             // buffer swap done (OpenGL display only)
+
+    Point_MAX
+};
+
+// monotonic time in nanoseconds, safe to call from any thread
+melonDS::u64 Now();
+
+void SetEnabled(bool enable);
+bool IsEnabled();
+
+// clears the recorded frames and statistics
+void Reset();
+
+void Mark(Point point);
+void Mark(Point point, melonDS::u64 time);
+
+// commits the current frame's timestamps and starts a new frame
+void EndFrame();
+
+// p50/p99 over the last few seconds, for the OSD
+// returns an empty string when there's nothing to report yet
+std::string Summary();
+
+// writes every recorded frame to a CSV file
+bool DumpCSV(const std::string& path);
+
+}
+
+#endif // LATENCYTRACE_H
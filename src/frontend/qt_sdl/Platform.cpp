@@ -474,13 +474,13 @@ void Sleep(u64 usecs)
 
 void WriteNDSSave(const u8* savedata, u32 savelen, u32 writeoffset, u32 writelen)
 {
-    if (ROMManager::NDSSave)
+    if (ROMManager::NDSSave && !ROMManager::DropCartSaveWrites)
         ROMManager::NDSSave->RequestFlush(savedata, savelen, writeoffset, writelen);
 }
 
 void WriteGBASave(const u8* savedata, u32 savelen, u32 writeoffset, u32 writelen)
 {
-    if (ROMManager::GBASave)
+    if (ROMManager::GBASave && !ROMManager::DropCartSaveWrites)
         ROMManager::GBASave->RequestFlush(savedata, savelen, writeoffset, writelen);
 }
 
@@ -38,6 +38,7 @@
 #include "ROMManager.h"
 #include "Config.h"
 #include "Platform.h"
+#include "SavestateFile.h"
 
 #include "NDS.h"
 #include "DSi.h"
@@ -72,6 +73,7 @@ std::string BaseGBAAssetName = "";
 std::unique_ptr<SaveManager> NDSSave = nullptr;
 std::unique_ptr<SaveManager> GBASave = nullptr;
 std::unique_ptr<SaveManager> FirmwareSave = nullptr;
+bool DropCartSaveWrites = false;
 
 std::unique_ptr<Savestate> BackupState = nullptr;
 bool SavestateLoaded = false;
@@ -342,10 +344,11 @@ bool SavestateExists(int slot)
 
 bool LoadState(NDS& nds, const std::string& filename)
 {
-    FILE* file = fopen(filename.c_str(), "rb");
-    if (file == nullptr)
-    { // If we couldn't open the state file...
-        Platform::Log(Platform::LogLevel::Error, "Failed to open state file \"%s\"\n", filename.c_str());
+    // Read (and decompress) the state file first
+    std::vector<u8> buffer;
+    if (!Frontend::ReadSavestateFile(filename, buffer))
+    { // If we couldn't read the state file...
+        Platform::Log(Platform::LogLevel::Error, "Failed to read state file \"%s\"\n", filename.c_str());
         return false;
     }
 
@@ -353,41 +356,19 @@ bool LoadState(NDS& nds, const std::string& filename)
     if (backup->Error)
     { // If we couldn't allocate memory for the backup...
         Platform::Log(Platform::LogLevel::Error, "Failed to allocate memory for state backup\n");
-        fclose(file);
         return false;
     }
 
     if (!nds.DoSavestate(backup.get()) || backup->Error)
     { // Back up the emulator's state. If that failed...
         Platform::Log(Platform::LogLevel::Error, "Failed to back up state, aborting load (from \"%s\")\n", filename.c_str());
-        fclose(file);
         return false;
     }
     // We'll store the backup once we're sure that the state was loaded.
     // Now that we know the file and backup are both good, let's load the new state.
 
-    // Get the size of the file that we opened
-    if (fseek(file, 0, SEEK_END) != 0)
-    {
-        Platform::Log(Platform::LogLevel::Error, "Failed to seek to end of state file \"%s\"\n", filename.c_str());
-        fclose(file);
-        return false;
-    }
-    size_t size = ftell(file);
-    rewind(file); // reset the filebuf's position
-
-    // Allocate exactly as much memory as we need for the savestate
-    std::vector<u8> buffer(size);
-    if (fread(buffer.data(), size, 1, file) == 0)
-    { // Read the state file into the buffer. If that failed...
-        Platform::Log(Platform::LogLevel::Error, "Failed to read %u-byte state file \"%s\"\n", size, filename.c_str());
-        fclose(file);
-        return false;
-    }
-    fclose(file); // done with the file now
-
     // Get ready to load the state from the buffer into the emulator
-    std::unique_ptr<Savestate> state = std::make_unique<Savestate>(buffer.data(), size, false);
+    std::unique_ptr<Savestate> state = std::make_unique<Savestate>(buffer.data(), buffer.size(), false);
 
     if (!nds.DoSavestate(state.get()) || state->Error)
     { // If we couldn't load the savestate from the buffer...
@@ -416,17 +397,9 @@ bool LoadState(NDS& nds, const std::string& filename)
 
 bool SaveState(NDS& nds, const std::string& filename)
 {
-    FILE* file = fopen(filename.c_str(), "wb");
-
-    if (file == nullptr)
-    { // If the file couldn't be opened...
-        return false;
-    }
-
     Savestate state;
     if (state.Error)
     { // If there was an error creating the state (and allocating its memory)...
-        fclose(file);
         return false;
     }
 
@@ -435,23 +408,19 @@ bool SaveState(NDS& nds, const std::string& filename)
 
     if (state.Error)
     {
-        fclose(file);
         return false;
     }
 
-    if (fwrite(state.Buffer(), state.Length(), 1, file) == 0)
-    { // Write the Savestate buffer to the file. If that fails...
+    if (!Frontend::WriteSavestateFile(filename, state))
+    { // Compress the Savestate buffer into the file. If that fails...
         Platform::Log(Platform::Error,
             "Failed to write %d-byte savestate to %s\n",
             state.Length(),
             filename.c_str()
         );
-        fclose(file);
         return false;
     }
 
-    fclose(file);
-
     if (Config::SavestateRelocSRAM && NDSSave)
     {
         std::string savefile = filename.substr(LastSep(filename)+1);
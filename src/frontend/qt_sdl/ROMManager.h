@@ -46,6 +46,11 @@ extern std::unique_ptr<SaveManager> NDSSave;
 extern std::unique_ptr<SaveManager> GBASave;
 extern std::unique_ptr<SaveManager> FirmwareSave;
 
+// set by the emu thread while it runs ahead. the cart's save memory is restored
+// along with the rest of the console afterwards, so what's written meanwhile
+// never happened and mustn't reach the save files
+extern bool DropCartSaveWrites;
+
 QString VerifySetup();
 void Reset(EmuThread* thread);
 
@@ -1,64 +1,97 @@
+#include <stdint.h>
+
 #include "RawInputThread.h"
+#include "LatencyTrace.h"
+#include "Platform.h"
+
+using namespace melonDS;
 
-void sample_on_rel(void* tag, Raw_Axis axis, int delta, RawInputThread* rawInputThread) {
+static void sample_on_rel(void* tag, Raw_Axis axis, int delta, void* user_data) {
+	RawInputThread* rawInputThread = (RawInputThread*)user_data;
 	if (rawInputThread == nullptr) return;
 	rawInputThread->internalReceiveDelta(axis, delta);
 }
 
-void sample_on_plug(int idx, void* _) {
-    int *next_tag = (int*)_;
-    int tag = *next_tag;
-    *next_tag = tag + 1;
-
-    raw_open(idx, (void*)tag);
-    printf("Device %d at idx %d plugged.\n", (int)tag, idx);
+static void sample_on_plug(int idx, void* user_data) {
+	RawInputThread* rawInputThread = (RawInputThread*)user_data;
+	if (rawInputThread == nullptr) return;
+	rawInputThread->internalPlug(idx);
 }
 
-void sample_on_unplug(void* tag, void* _) {
-    raw_close(tag);
-    printf("Device %d unplugged.\n", (intptr_t)tag);
+static void sample_on_unplug(void* tag, void* user_data) {
+	RawInputThread* rawInputThread = (RawInputThread*)user_data;
+	if (rawInputThread == nullptr) return;
+	rawInputThread->internalUnplug(tag);
 }
 
 RawInputThread::RawInputThread(QObject* parent): QThread(parent)
 {
+	mouseDeltaX = 0;
+	mouseDeltaY = 0;
+	firstEventTime = 0;
+
 	raw_init();
 
-	int dev_cnt = raw_dev_cnt();
-	printf("Detected %d devices.\n", dev_cnt);
+	deviceCount = raw_dev_cnt();
+	Platform::Log(Platform::LogLevel::Info, "Raw input: detected %d devices\n", (int)deviceCount);
 
-	int next_tag = 0;
-	for (int i=0; i<dev_cnt; ++i) {
-		raw_open(i, (void*)(next_tag++));
+	// tags start at 1, 0 means no tag to the rawinput backend
+	nextTag = 1;
+	for (int i=0; i<deviceCount; ++i) {
+		raw_open(i, (void*)(nextTag++));
 	}
 
-	raw_on_rel((Raw_On_Rel)sample_on_rel, this);
-	raw_on_unplug(sample_on_unplug, 0);
-    raw_on_plug(sample_on_plug, &next_tag);
+	raw_on_rel(sample_on_rel, this);
+	raw_on_unplug(sample_on_unplug, this);
+	raw_on_plug(sample_on_plug, this);
+
+	running = true;
 }
 
 RawInputThread::~RawInputThread() {
+	running = false;
+	wait();
+
 	raw_quit();
 }
 
 void RawInputThread::internalReceiveDelta(Raw_Axis axis, int delta) {
-	mouseDeltaLock.lock();
-	if (axis == Raw_Axis::RA_X) mouseDeltaX += delta;
-	else if (axis == Raw_Axis::RA_Y) mouseDeltaY += delta;
-	mouseDeltaLock.unlock();
+	if (firstEventTime.load(std::memory_order_relaxed) == 0)
+		firstEventTime.store(LatencyTrace::Now(), std::memory_order_relaxed);
+
+	if (axis == Raw_Axis::RA_X) mouseDeltaX.fetch_add(delta, std::memory_order_relaxed);
+	else if (axis == Raw_Axis::RA_Y) mouseDeltaY.fetch_add(delta, std::memory_order_relaxed);
 }
 
-QPair<int ,int> RawInputThread::fetchMouseDelta() {
-	mouseDeltaLock.lock();
-	QPair<int, int> value = QPair(mouseDeltaX, mouseDeltaY);
-	mouseDeltaX = 0;
-	mouseDeltaY = 0;
-	mouseDeltaLock.unlock();
-	return value;
+void RawInputThread::internalPlug(int idx) {
+	intptr_t tag = nextTag++;
+	raw_open(idx, (void*)tag);
+	deviceCount++;
+	Platform::Log(Platform::LogLevel::Debug, "Raw input: device %d at idx %d plugged\n", (int)tag, idx);
+}
+
+void RawInputThread::internalUnplug(void* tag) {
+	raw_close(tag);
+	deviceCount--;
+	Platform::Log(Platform::LogLevel::Debug, "Raw input: device %d unplugged\n", (int)(intptr_t)tag);
+}
+
+QPair<int, int> RawInputThread::fetchMouseDelta() {
+	return QPair<int, int>(
+		mouseDeltaX.exchange(0, std::memory_order_relaxed),
+		mouseDeltaY.exchange(0, std::memory_order_relaxed)
+	);
+}
+
+quint64 RawInputThread::fetchFirstEventTime() {
+	return firstEventTime.exchange(0, std::memory_order_relaxed);
 }
 
 void RawInputThread::run()
 {
-	while (isRunning()) {
+	while (running) {
+		// the timeout only bounds how long quitting can take
+		raw_wait(50);
 		raw_poll();
 	}
-}
\ No newline at end of file
+}
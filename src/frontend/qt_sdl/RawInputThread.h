@@ -2,13 +2,20 @@
 #define RAWINPUTTHREAD_H
 
 #include <QThread>
-#include <QMutex>
+
+#include <atomic>
 
 extern "C"
 {
 #include "rawinput/rawinput.h"
 }
 
+// Reads relative mouse motion straight from the input devices (evdev on Linux)
+// on its own thread, so motion isn't quantised to emulated frames and
+// the emulator doesn't need to warp the cursor around to measure it.
+//
+// Deltas are summed into atomics: the input thread is the only producer
+// and the emu thread the only consumer, so no lock is needed.
 class RawInputThread : public QThread
 {
     Q_OBJECT
@@ -16,18 +23,32 @@ class RawInputThread : public QThread
 	void run() override;
 
 public:
-	explicit RawInputThread(QObject* parent);
+	explicit RawInputThread(QObject* parent = nullptr);
 	~RawInputThread();
 
+	// whether any mouse could be opened
+	// (on Linux the user needs read access to /dev/input/event*)
+	bool hasDevices() { return deviceCount > 0; }
+
 	void internalReceiveDelta(Raw_Axis axis, int delta);
+	void internalPlug(int idx);
+	void internalUnplug(void* tag);
 
+	// returns the motion accumulated since the last call and resets it
 	QPair<int, int> fetchMouseDelta();
+	// returns when the first event since the last call arrived (0 = none) and resets it
+	quint64 fetchFirstEventTime();
 
 private:
-	QMutex mouseDeltaLock;
+	std::atomic_bool running;
+
+	std::atomic<int> deviceCount;
+	intptr_t nextTag;
+
+	std::atomic<int> mouseDeltaX;
+	std::atomic<int> mouseDeltaY;
 
-	int mouseDeltaX;
-	int mouseDeltaY;
+	std::atomic<quint64> firstEventTime;
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -49,6 +49,7 @@
 #include "Platform.h"
 #include "Config.h"
 #include "Input.h"
+#include "LatencyTrace.h"
 
 #include "main_shaders.h"
 #include "OSD_shaders.h"
@@ -573,6 +574,7 @@ void ScreenPanel::osdAddMessage(unsigned int color, const char* text)
     item.timestamp = QDateTime::currentMSecsSinceEpoch();
     strncpy(item.text, text, 255); item.text[255] = '\0';
     item.color = color;
+    item.persistent = false;
     item.rendered = false;
 
     osdItems.push_back(item);
@@ -580,6 +582,40 @@ void ScreenPanel::osdAddMessage(unsigned int color, const char* text)
     osdMutex.unlock();
 }
 
+void ScreenPanel::osdSetPanel(unsigned int color, const std::vector<std::string>& lines)
+{
+    osdMutex.lock();
+
+    // the old lines are deleted by the next update, which may need the GL context
+    for (OSDItem& item : osdItems)
+    {
+        if (!item.persistent) continue;
+        item.persistent = false;
+        item.timestamp = 0;
+    }
+
+    if (osdEnabled)
+    {
+        // above the messages
+        qint64 now = QDateTime::currentMSecsSinceEpoch();
+        for (auto it = lines.rbegin(); it != lines.rend(); it++)
+        {
+            OSDItem item;
+
+            item.id = osdID++;
+            item.timestamp = now;
+            strncpy(item.text, it->c_str(), 255); item.text[255] = '\0';
+            item.color = color;
+            item.persistent = true;
+            item.rendered = false;
+
+            osdItems.push_front(item);
+        }
+    }
+
+    osdMutex.unlock();
+}
+
 void ScreenPanel::osdUpdate()
 {
     osdMutex.lock();
@@ -591,7 +627,7 @@ void ScreenPanel::osdUpdate()
     {
         OSDItem& item = *it;
 
-        if ((!osdEnabled) || (item.timestamp < tick_min))
+        if ((!osdEnabled) || (item.timestamp < tick_min && !item.persistent))
         {
             osdDeleteItem(&item);
             it = osdItems.erase(it);
@@ -1087,6 +1123,8 @@ void ScreenPanelGL::drawScreenGL()
     }
 
     glContext->SwapBuffers();
+
+    LatencyTrace::Mark(LatencyTrace::Point_Swap);
 }
 
 qreal ScreenPanelGL::devicePixelRatioFromScreen() const
@@ -22,6 +22,8 @@
 #include <optional>
 #include <deque>
 #include <map>
+#include <string>
+#include <vector>
 
 #include <QWidget>
 #include <QImage>
@@ -64,6 +66,7 @@ public:
 
     void osdSetEnabled(bool enabled);
     void osdAddMessage(unsigned int color, const char* msg);
+    void osdSetPanel(unsigned int color, const std::vector<std::string>& lines);
 
     bool getFocused() { return isFocused; }
     void unfocus();
@@ -79,6 +82,7 @@ protected:
 
         char text[256];
         unsigned int color;
+        bool persistent; // panel line, stays until the panel is replaced
 
         bool rendered;
         QImage bitmap;
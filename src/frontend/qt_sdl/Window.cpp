@@ -80,6 +80,7 @@
 #include "ROMManager.h"
 #include "ArchiveUtil.h"
 #include "CameraManager.h"
+#include "LatencyTrace.h"
 
 using namespace melonDS;
 
@@ -326,6 +327,19 @@ MainWindow::MainWindow(QWidget* parent) : QMainWindow(parent)
         actUndoStateLoad->setShortcut(QKeySequence(Qt::Key_F12));
         connect(actUndoStateLoad, &QAction::triggered, this, &MainWindow::onUndoStateLoad);
 
+        {
+            QMenu* submenu = menu->addMenu("Input movie");
+
+            actMovieRecord = submenu->addAction("Record...");
+            connect(actMovieRecord, &QAction::triggered, this, &MainWindow::onMovieRecord);
+
+            actMoviePlay = submenu->addAction("Play...");
+            connect(actMoviePlay, &QAction::triggered, this, &MainWindow::onMoviePlay);
+
+            actMovieStop = submenu->addAction("Stop");
+            connect(actMovieStop, &QAction::triggered, this, &MainWindow::onMovieStop);
+        }
+
         menu->addSeparator();
 
         actQuit = menu->addAction("Quit");
@@ -377,6 +391,11 @@ MainWindow::MainWindow(QWidget* parent) : QMainWindow(parent)
 
             actTitleManager = menu->addAction("Manage DSi titles");
             connect(actTitleManager, &QAction::triggered, this, &MainWindow::onOpenTitleManager);
+
+#ifdef JIT_PERF_MAP_ENABLED
+            actLogHotJITBlocks = menu->addAction("Log most run JIT blocks");
+            connect(actLogHotJITBlocks, &QAction::triggered, this, &MainWindow::onLogHotJITBlocks);
+#endif
         }
 
         {
@@ -432,6 +451,10 @@ MainWindow::MainWindow(QWidget* parent) : QMainWindow(parent)
             actSavestateSRAMReloc = submenu->addAction("Separate savefiles");
             actSavestateSRAMReloc->setCheckable(true);
             connect(actSavestateSRAMReloc, &QAction::triggered, this, &MainWindow::onChangeSavestateSRAMReloc);
+
+            actRewindEnabled = submenu->addAction("Enable rewind");
+            actRewindEnabled->setCheckable(true);
+            connect(actRewindEnabled, &QAction::triggered, this, &MainWindow::onChangeRewindEnabled);
         }
 
         menu->addSeparator();
@@ -564,6 +587,10 @@ MainWindow::MainWindow(QWidget* parent) : QMainWindow(parent)
         actShowOSD->setCheckable(true);
         connect(actShowOSD, &QAction::triggered, this, &MainWindow::onChangeShowOSD);
 
+        actShowPerfStats = menu->addAction("Show performance stats");
+        actShowPerfStats->setCheckable(true);
+        connect(actShowPerfStats, &QAction::triggered, this, &MainWindow::onChangeShowPerfStats);
+
         menu->addSeparator();
 
         actLimitFramerate = menu->addAction("Limit framerate");
@@ -621,6 +648,9 @@ MainWindow::MainWindow(QWidget* parent) : QMainWindow(parent)
     }
     actUndoStateLoad->setEnabled(false);
     actImportSavefile->setEnabled(false);
+    actMovieRecord->setEnabled(false);
+    actMoviePlay->setEnabled(false);
+    actMovieStop->setEnabled(false);
 
     actPause->setEnabled(false);
     actReset->setEnabled(false);
@@ -637,8 +667,12 @@ MainWindow::MainWindow(QWidget* parent) : QMainWindow(parent)
 
     actROMInfo->setEnabled(false);
     actRAMInfo->setEnabled(false);
+#ifdef JIT_PERF_MAP_ENABLED
+    actLogHotJITBlocks->setEnabled(false);
+#endif
 
     actSavestateSRAMReloc->setChecked(Config::SavestateRelocSRAM);
+    actRewindEnabled->setChecked(Config::RewindEnabled);
 
     actScreenRotation[Config::ScreenRotation]->setChecked(true);
 
@@ -667,6 +701,7 @@ MainWindow::MainWindow(QWidget* parent) : QMainWindow(parent)
 
     actScreenFiltering->setChecked(Config::ScreenFilter);
     actShowOSD->setChecked(Config::ShowOSD);
+    actShowPerfStats->setChecked(Config::ShowPerfStats);
 
     actLimitFramerate->setChecked(Config::LimitFPS);
     actAudioSync->setChecked(Config::AudioSync);
@@ -705,6 +740,11 @@ void MainWindow::osdAddMessage(unsigned int color, const char* fmt, ...)
     panel->osdAddMessage(color, msg);
 }
 
+void MainWindow::osdSetPanel(unsigned int color, const std::vector<std::string>& lines)
+{
+    panel->osdSetPanel(color, lines);
+}
+
 void MainWindow::closeEvent(QCloseEvent* event)
 {
     if (hasOGL)
@@ -1492,6 +1532,9 @@ void MainWindow::onLoadState()
 
     if (ROMManager::LoadState(*emuThread->NDS, filename))
     {
+        emuThread->Rewind.Clear();
+        emuThread->clearMacro();
+
         if (slot > 0) osdAddMessage(0, "State loaded from slot %d", slot);
         else          osdAddMessage(0, "State loaded from file");
 
@@ -1509,11 +1552,73 @@ void MainWindow::onUndoStateLoad()
 {
     emuThread->emuPause();
     ROMManager::UndoStateLoad(*emuThread->NDS);
+    emuThread->Rewind.Clear();
+    emuThread->clearMacro();
     emuThread->emuUnpause();
 
     osdAddMessage(0, "State load undone");
 }
 
+void MainWindow::onMovieRecord()
+{
+    emuThread->emuPause();
+
+    QString path = QFileDialog::getSaveFileName(this,
+                                                "Record input movie",
+                                                QString::fromStdString(Config::LastROMFolder),
+                                                "melonDS input movies (*.mmov);;Any file (*.*)");
+    if (!path.isEmpty())
+    {
+        if (emuThread->Movie.StartRecording(*emuThread->NDS, path.toStdString()))
+        {
+            osdAddMessage(0, "Recording input movie");
+            actMovieStop->setEnabled(true);
+        }
+        else
+            osdAddMessage(0xFFA0A0, "Failed to start recording");
+    }
+
+    emuThread->emuUnpause();
+}
+
+void MainWindow::onMoviePlay()
+{
+    emuThread->emuPause();
+
+    QString path = QFileDialog::getOpenFileName(this,
+                                                "Play input movie",
+                                                QString::fromStdString(Config::LastROMFolder),
+                                                "melonDS input movies (*.mmov);;Any file (*.*)");
+    if (!path.isEmpty())
+    {
+        if (emuThread->Movie.StartPlayback(*emuThread->NDS, path.toStdString()))
+        {
+            osdAddMessage(0, "Playing input movie (%u frames)", emuThread->Movie.GetNumFrames());
+            actMovieStop->setEnabled(true);
+        }
+        else
+            osdAddMessage(0xFFA0A0, "Failed to load input movie");
+    }
+
+    emuThread->emuUnpause();
+}
+
+void MainWindow::onMovieStop()
+{
+    emuThread->emuPause();
+
+    bool recording = emuThread->Movie.IsRecording();
+    if (emuThread->Movie.Stop())
+    {
+        if (recording) osdAddMessage(0, "Input movie saved");
+    }
+    else
+        osdAddMessage(0xFFA0A0, "Failed to save input movie");
+
+    actMovieStop->setEnabled(false);
+    emuThread->emuUnpause();
+}
+
 void MainWindow::onImportSavefile()
 {
     emuThread->emuPause();
@@ -1660,6 +1765,32 @@ void MainWindow::onRAMInfo()
     RAMInfoDialog* dlg = RAMInfoDialog::openDlg(this, emuThread);
 }
 
+#ifdef JIT_PERF_MAP_ENABLED
+void MainWindow::onLogHotJITBlocks()
+{
+    emuThread->emuPause();
+
+    melonDS::NDS* nds = emuThread->NDS.get();
+    if (nds->IsJITEnabled())
+    {
+        // counts are since the last block cache reset
+        Platform::Log(Platform::LogLevel::Info, "%-22s %12s\n", "jit block", "entries");
+        for (const ARMJIT::HotBlock& block : nds->JIT.GetHotBlocks(20))
+        {
+            Platform::Log(Platform::LogLevel::Info, "ARM%d %-5s %08X    %12llu\n",
+                          block.Num ? 7 : 9, block.Thumb ? "Thumb" : "ARM", block.Addr,
+                          (unsigned long long)block.EntryCount);
+        }
+    }
+    else
+    {
+        Platform::Log(Platform::LogLevel::Info, "the JIT isn't enabled, no blocks to log\n");
+    }
+
+    emuThread->emuUnpause();
+}
+#endif
+
 void MainWindow::onOpenTitleManager()
 {
     TitleManagerDialog* dlg = TitleManagerDialog::openDlg(this);
@@ -1873,6 +2004,12 @@ void MainWindow::onChangeSavestateSRAMReloc(bool checked)
     Config::SavestateRelocSRAM = checked?1:0;
 }
 
+void MainWindow::onChangeRewindEnabled(bool checked)
+{
+    // the emu thread drops the history once it sees it disabled
+    Config::RewindEnabled = checked;
+}
+
 void MainWindow::onChangeScreenSize()
 {
     int factor = ((QAction*)sender())->data().toInt();
@@ -1972,6 +2109,11 @@ void MainWindow::onChangeShowOSD(bool checked)
     panel->osdSetEnabled(Config::ShowOSD);
 }
 
+void MainWindow::onChangeShowPerfStats(bool checked)
+{
+    Config::ShowPerfStats = checked?1:0;
+}
+
 void MainWindow::onChangeLimitFramerate(bool checked)
 {
     Config::LimitFPS = checked?1:0;
@@ -2033,6 +2175,8 @@ void MainWindow::onEmuStart()
     actSaveState[0]->setEnabled(true);
     actLoadState[0]->setEnabled(true);
     actUndoStateLoad->setEnabled(false);
+    actMovieRecord->setEnabled(true);
+    actMoviePlay->setEnabled(true);
 
     actPause->setEnabled(true);
     actPause->setChecked(false);
@@ -2044,11 +2188,22 @@ void MainWindow::onEmuStart()
     actPowerManagement->setEnabled(true);
 
     actTitleManager->setEnabled(false);
+#ifdef JIT_PERF_MAP_ENABLED
+    actLogHotJITBlocks->setEnabled(true);
+#endif
 }
 
 void MainWindow::onEmuStop()
 {
     emuThread->emuPause();
+    emuThread->clearMacro();
+
+    bool recording = emuThread->Movie.IsRecording();
+    if (emuThread->Movie.Stop() && recording)
+        osdAddMessage(0, "Input movie saved");
+
+    if (LatencyTrace::IsEnabled() && LatencyTrace::DumpCSV("latency.csv"))
+        osdAddMessage(0, "Latency trace saved to latency.csv");
 
     for (int i = 0; i < 9; i++)
     {
@@ -2056,6 +2211,9 @@ void MainWindow::onEmuStop()
         actLoadState[i]->setEnabled(false);
     }
     actUndoStateLoad->setEnabled(false);
+    actMovieRecord->setEnabled(false);
+    actMoviePlay->setEnabled(false);
+    actMovieStop->setEnabled(false);
 
     actPause->setEnabled(false);
     actReset->setEnabled(false);
@@ -2066,6 +2224,9 @@ void MainWindow::onEmuStop()
     actPowerManagement->setEnabled(false);
 
     actTitleManager->setEnabled(!Config::DSiNANDPath.empty());
+#ifdef JIT_PERF_MAP_ENABLED
+    actLogHotJITBlocks->setEnabled(false);
+#endif
 }
 
 void MainWindow::onUpdateVideoSettings(bool glchange)
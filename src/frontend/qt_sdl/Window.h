@@ -115,6 +115,7 @@ public:
     void onAppStateChanged(Qt::ApplicationState state);
 
     void osdAddMessage(unsigned int color, const char* fmt, ...);
+    void osdSetPanel(unsigned int color, const std::vector<std::string>& lines);
 
 protected:
     void resizeEvent(QResizeEvent* event) override;
@@ -145,6 +146,9 @@ private slots:
     void onSaveState();
     void onLoadState();
     void onUndoStateLoad();
+    void onMovieRecord();
+    void onMoviePlay();
+    void onMovieStop();
     void onImportSavefile();
     void onQuit();
 
@@ -160,6 +164,9 @@ private slots:
     void onROMInfo();
     void onRAMInfo();
     void onOpenTitleManager();
+#ifdef JIT_PERF_MAP_ENABLED
+    void onLogHotJITBlocks();
+#endif
     void onMPNewInstance();
 
     void onOpenEmuSettings();
@@ -184,6 +191,7 @@ private slots:
     void onInterfaceSettingsFinished(int res);
     void onUpdateMouseTimer();
     void onChangeSavestateSRAMReloc(bool checked);
+    void onChangeRewindEnabled(bool checked);
     void onChangeScreenSize();
     void onChangeScreenRotation(QAction* act);
     void onChangeScreenGap(QAction* act);
@@ -194,6 +202,7 @@ private slots:
     void onChangeIntegerScaling(bool checked);
     void onChangeScreenFiltering(bool checked);
     void onChangeShowOSD(bool checked);
+    void onChangeShowPerfStats(bool checked);
     void onChangeLimitFramerate(bool checked);
     void onChangeAudioSync(bool checked);
 
@@ -247,6 +256,9 @@ public:
     QAction* actSaveState[9];
     QAction* actLoadState[9];
     QAction* actUndoStateLoad;
+    QAction* actMovieRecord;
+    QAction* actMoviePlay;
+    QAction* actMovieStop;
     QAction* actQuit;
 
     QAction* actPause;
@@ -260,6 +272,9 @@ public:
     QAction* actROMInfo;
     QAction* actRAMInfo;
     QAction* actTitleManager;
+#ifdef JIT_PERF_MAP_ENABLED
+    QAction* actLogHotJITBlocks;
+#endif
     QAction* actMPNewInstance;
 
     QAction* actEmuSettings;
@@ -276,6 +291,7 @@ public:
     QAction* actPathSettings;
     QAction* actInterfaceSettings;
     QAction* actSavestateSRAMReloc;
+    QAction* actRewindEnabled;
     QAction* actScreenSize[4];
     QActionGroup* grpScreenRotation;
     QAction* actScreenRotation[Frontend::screenRot_MAX];
@@ -293,6 +309,7 @@ public:
     QAction** actScreenAspectBot;
     QAction* actScreenFiltering;
     QAction* actShowOSD;
+    QAction* actShowPerfStats;
     QAction* actLimitFramerate;
     QAction* actAudioSync;
 };
@@ -149,6 +149,8 @@ void raw_open(int idx, void* tag);
 void raw_close(void* tag);
 
 void raw_poll();
+/* Blocks until input is available or timeout_ms elapses (linux only for now) */
+void raw_wait(int timeout_ms);
 
 const char* raw_key_str(Raw_Key key);
 const char* raw_axis_str(Raw_Axis axis);
@@ -4,6 +4,7 @@
 #include <sys/poll.h>
 #include <sys/stat.h>
 #include <sys/inotify.h>
+#include <sys/ioctl.h>
 #include <unistd.h>
 #include <fcntl.h>
 #include <dirent.h>
@@ -251,6 +252,25 @@ void raw_poll() {
     handle_plug();
 }
 
+void raw_wait(int timeout_ms) {
+    struct pollfd fds[MAX_DEVICES + 1];
+    memcpy(&fds[0], &pfds[0], sizeof(pfds[0]) * device_count);
+    fds[device_count] = inotify_pfd;
+
+    poll(&fds[0], device_count + 1, timeout_ms);
+}
+
+// Only devices which report relative X motion are mice, the others
+// (keyboards, touchpads in absolute mode, power buttons...) aren't opened
+static bool has_rel_x(int fd) {
+    unsigned long bits[(REL_MAX + 8 * sizeof(long)) / (8 * sizeof(long))] = {0};
+    if (ioctl(fd, EVIOCGBIT(EV_REL, sizeof(bits)), bits) < 0) {
+        return false;
+    }
+
+    return (bits[REL_X / (8 * sizeof(long))] >> (REL_X % (8 * sizeof(long)))) & 1;
+}
+
 static int scan_devices(Device *devices) {
     // We scan the devices by listing the contents of /dev/input
     DIR *dirp = opendir("/dev/input/");
@@ -277,6 +297,11 @@ static int scan_devices(Device *devices) {
                 continue;
             }
 
+            if (!has_rel_x(fd)) {
+                close(fd);
+                continue;
+            }
+
             // Get the number * in /dev/input/event*
             int handle = strtol(d->d_name + strlen("event"), NULL, 10);
             //dbg("opened path:%s fd:%d handle:%d\n", path, fd, handle);
@@ -316,6 +341,8 @@ static void handle_plug() {
 				struct inotify_event *e = (struct inotify_event*) ptr;
 
                 if (strncmp(e->name, "event", strlen("event")) != 0) {
+                    // eg. /dev/input/mouseN, created along with the eventN of a mouse
+                    ptr += sizeof(*e) + e->len;
                     continue;
                 }
 
@@ -354,7 +381,8 @@ static void handle_plug() {
 
         // Get the number * in /dev/input/event*
         int handle = strtol(path + strlen("/dev/input/event"), NULL, 10);
-        if (find_device_by_handle(handle) >= 0) {
+        if (find_device_by_handle(handle) >= 0 || !has_rel_x(fd)) {
+            close(fd);
             queue_cnt--;
             return;
         }